@@ -0,0 +1,639 @@
+/**
+ * aot.cc - compile a program to C++ and load it as a shared object
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#include <dlfcn.h>
+#include <stdio.h>  // for snprintf
+#include <stdlib.h> // for getenv, system
+#include <string.h> // for memcpy, strchr
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include "aot.hh"
+#include "operator.hh"
+
+namespace ttl {
+
+    const int Aot::ABI_VERSION;
+
+    static std::string Bits(double value) {
+        unsigned long long bits;
+        memcpy(&bits, &value, sizeof(bits));
+        char buffer[32];
+        snprintf(buffer, sizeof(buffer), "0x%016llxULL", bits);
+        return buffer;
+    }
+
+    // a C++ literal of exactly 'value'
+    static std::string Literal(double value) {
+        if (value != value || value - value != 0) {
+            return "D(" + Bits(value) + ")"; // nan, inf
+        }
+
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), "%.17g", value);
+        std::string literal = buffer;
+        if (strchr(buffer, '.') == NULL && strchr(buffer, 'e') == NULL) {
+            literal += ".0";
+        }
+        return value < 0 || (value == 0 && 1 / value < 0) ? "(" + literal + ")" : literal;
+    }
+
+    static std::string Slot(int slot) {
+        std::ostringstream os;
+        os << "s[" << slot << "]";
+        return os.str();
+    }
+
+    /**
+     * translate the ast into statements, one temporary per node, in the
+     * order of the tree walker.
+     */
+    class AotTranslator {
+    public:
+        AotTranslator(const Program& program, std::ostream& out)
+            : program_(program), out_(out), functions_(), body_(NULL), temps_(0), models_(0), calls_() {}
+
+        void Translate() {
+            out_ << "// generated by ttlc --aot, do not edit." << std::endl
+                 << "#include <math.h>" << std::endl
+                 << "#include <string.h>" << std::endl
+                 << "#include <iostream>" << std::endl
+                 << std::endl
+                 << "static inline double D(unsigned long long bits) {" << std::endl
+                 << "    double d;" << std::endl
+                 << "    memcpy(&d, &bits, sizeof(d));" << std::endl
+                 << "    return d;" << std::endl
+                 << "}" << std::endl
+                 << std::endl
+                 << "// the native functions, set by SharedProgram::Load" << std::endl
+                 << "extern \"C\" double (* ttl_functions[])(const double * args);" << std::endl
+                 << "// Context::Resolve, set by SharedProgram::Load" << std::endl
+                 << "extern \"C\" void (* ttl_resolve)(void * context, int index);" << std::endl
+                 << std::endl
+                 << "static inline void DivZero(double value) {" << std::endl
+                 << "    std::cerr << \"Divided by zero. Return default value \"" << std::endl
+                 << "              << value << \".\" << std::endl;" << std::endl
+                 << "}" << std::endl
+                 << std::endl
+                 << "// the lanes of Kernels::dot, then the sigmoid" << std::endl
+                 << "static inline double Lr(const double * s, const int * slots, const double * w," << std::endl
+                 << "                        unsigned long n, double bias) {" << std::endl
+                 << "    double lanes[4] = { 0.0, 0.0, 0.0, 0.0 };" << std::endl
+                 << "    for (unsigned long i = 0; i < n; ++i) {" << std::endl
+                 << "        lanes[i % 4] += w[i] * s[slots[i]];" << std::endl
+                 << "    }" << std::endl
+                 << "    double z = ((lanes[0] + lanes[1]) + (lanes[2] + lanes[3])) + bias;" << std::endl
+                 << "    return 1.0 / (1.0 + exp(-z));" << std::endl
+                 << "}" << std::endl
+                 << std::endl
+                 << "// the layout of TreeEnsemble, a leaf steps to itself" << std::endl
+                 << "struct TreeNode {" << std::endl
+                 << "    double threshold;" << std::endl
+                 << "    int feature;" << std::endl
+                 << "    int left;" << std::endl
+                 << "};" << std::endl
+                 << std::endl
+                 << "static inline double Trees(const double * s, const int * slots, const TreeNode * nodes," << std::endl
+                 << "                           const double * leaves, const int * roots, const int * depths," << std::endl
+                 << "                           unsigned long trees) {" << std::endl
+                 << "    double sum = 0.0;" << std::endl
+                 << "    for (unsigned long t = 0; t < trees; ++t) {" << std::endl
+                 << "        int index = roots[t];" << std::endl
+                 << "        for (int step = depths[t]; step > 0; --step) {" << std::endl
+                 << "            const TreeNode& node = nodes[index];" << std::endl
+                 << "            index = node.left + !(s[slots[node.feature]] < node.threshold);" << std::endl
+                 << "        }" << std::endl
+                 << "        sum += leaves[index];" << std::endl
+                 << "    }" << std::endl
+                 << "    return sum;" << std::endl
+                 << "}" << std::endl;
+
+            std::string root = TranslateModule(program_.Root());
+            for (std::size_t i = 0; i < functions_.size(); ++i) {
+                out_ << std::endl << functions_[i];
+            }
+
+            const std::vector<double>& initial = program_.InitialValues();
+            const std::map<std::string, int>& inputs = program_.Inputs();
+
+            out_ << std::endl
+                 << "extern \"C\" const int ttl_abi_version = " << Aot::ABI_VERSION << ";" << std::endl
+                 << "extern \"C\" const unsigned long ttl_slot_count = " << initial.size() << ";" << std::endl
+                 << "extern \"C\" const unsigned long long ttl_initial_values[] = {" << std::endl;
+            for (std::size_t i = 0; i < initial.size(); ++i) {
+                out_ << "    " << Bits(initial[i]) << "," << std::endl;
+            }
+            out_ << "};" << std::endl
+                 << "extern \"C\" const unsigned long ttl_input_count = " << inputs.size() << ";" << std::endl
+                 << "extern \"C\" const char * const ttl_input_names[] = {";
+            for (std::map<std::string, int>::const_iterator it = inputs.begin(); it != inputs.end(); ++it) {
+                out_ << " \"" << it->first << "\",";
+            }
+            out_ << " 0 };" << std::endl
+                 << "extern \"C\" const int ttl_input_slots[] = {";
+            for (std::map<std::string, int>::const_iterator it = inputs.begin(); it != inputs.end(); ++it) {
+                out_ << " " << it->second << ",";
+            }
+            out_ << " -1 };" << std::endl
+                 << "extern \"C\" const unsigned long ttl_function_count = " << calls_.size() << ";" << std::endl
+                 << "extern \"C\" const char * const ttl_function_names[] = {";
+            for (std::size_t i = 0; i < calls_.size(); ++i) {
+                out_ << " \"" << calls_[i]->name << "\",";
+            }
+            out_ << " 0 };" << std::endl
+                 << "extern \"C\" const int ttl_function_arities[] = {";
+            for (std::size_t i = 0; i < calls_.size(); ++i) {
+                out_ << " " << calls_[i]->arity << ",";
+            }
+            out_ << " -1 };" << std::endl
+                 << "extern \"C\" { double (* ttl_functions[])(const double * args) = {";
+            for (std::size_t i = 0; i < calls_.size(); ++i) {
+                out_ << " 0,";
+            }
+            out_ << " 0 }; }" << std::endl;
+
+            const std::vector<Extern>& externs = program_.Externs();
+            out_ << "extern \"C\" const unsigned long ttl_extern_count = " << externs.size() << ";" << std::endl
+                 << "extern \"C\" const char * const ttl_extern_names[] = {";
+            for (std::size_t i = 0; i < externs.size(); ++i) {
+                out_ << " \"" << externs[i].name << "\",";
+            }
+            out_ << " 0 };" << std::endl
+                 << "extern \"C\" const int ttl_extern_slots[] = {";
+            for (std::size_t i = 0; i < externs.size(); ++i) {
+                out_ << " " << externs[i].slot << ",";
+            }
+            out_ << " -1 };" << std::endl
+                 << "extern \"C\" const int ttl_extern_resolved_slots[] = {";
+            for (std::size_t i = 0; i < externs.size(); ++i) {
+                out_ << " " << externs[i].resolved_slot << ",";
+            }
+            out_ << " -1 };" << std::endl
+                 << "extern \"C\" { void (* ttl_resolve)(void * context, int index) = 0; }" << std::endl
+                 << std::endl
+                 << "extern \"C\" double ttl_evaluate(double * s, void * c) {" << std::endl
+                 << "    return " << root << "(s, c);" << std::endl
+                 << "}" << std::endl;
+        }
+
+    private:
+        // define a function for 'module', return its name.
+        std::string TranslateModule(const Module * module) {
+            std::ostringstream name;
+            name << "m" << module->DefaultSlot(); // unique per module
+
+            std::ostringstream body;
+            std::ostringstream * origin_body = body_;
+            int origin_temps = temps_;
+            body_ = &body;
+            temps_ = 0;
+
+            body << "static double " << name.str() << "(double * s, void * c) {" << std::endl;
+            Line(1, "double v = " + Slot(module->DefaultSlot()) + ";");
+            const OperatorList& sentences = module->Children();
+            bool returned = false;
+            for (std::size_t i = 0; i < sentences.size() && returned == false; ++i) {
+                const Operator * sentence = sentences[i];
+                std::string value = Expression(sentence, 1);
+                // the rest is never evaluated after "return"
+                returned = sentence->Type() == Operator::OP_REFERENCE &&
+                    static_cast<const Reference *>(sentence)->IsReturn();
+                if (returned == false) {
+                    Line(1, "v = " + value + ";");
+                }
+            }
+            if (returned == false) {
+                Line(1, "return v;");
+            }
+            body << "}" << std::endl;
+
+            body_ = origin_body;
+            temps_ = origin_temps;
+            functions_.push_back(body.str()); // after the modules it calls
+            return name.str();
+        }
+
+        // emit the statements of 'node', return the expression of its value.
+        std::string Expression(const Operator * node, int indent) {
+            const OperatorList& children = node->Children();
+            switch (node->Type()) {
+            case Operator::OP_NUM:
+                return Literal(static_cast<const Num *>(node)->Value());
+            case Operator::OP_VARIABLE:
+                return Slot(static_cast<const Variable *>(node)->Slot());
+            case Operator::OP_EXTERNAL:
+                {
+                    // never assigned, so the slot is read in place.
+                    const External * external = static_cast<const External *>(node);
+                    std::ostringstream index;
+                    index << external->Index();
+                    Line(indent, "if (" + Slot(external->ResolvedSlot()) + " == 0) {");
+                    Line(indent + 1, "ttl_resolve(c, " + index.str() + ");");
+                    Line(indent, "}");
+                    return Slot(external->Slot());
+                }
+            case Operator::OP_MODULE:
+                {
+                    std::string function = TranslateModule(static_cast<const Module *>(node));
+                    return Temp(indent, function + "(s, c)");
+                }
+            case Operator::OP_REFERENCE:
+                return TranslateReference(static_cast<const Reference *>(node), indent);
+            case Operator::OP_ADD:
+                {
+                    std::string sum = Temp(indent, "0.0");
+                    for (std::size_t i = 0; i < children.size(); ++i) {
+                        Line(indent, sum + " += " + Expression(children[i], indent) + ";");
+                    }
+                    return sum;
+                }
+            case Operator::OP_NEGATIVE:
+                return Temp(indent, "-" + Expression(children[0], indent));
+            case Operator::OP_NOT:
+                return Temp(indent, "!" + Expression(children[0], indent));
+            case Operator::OP_IF:
+                return TranslateIf(children, indent);
+            case Operator::OP_AND:
+                return TranslateLogical(children, indent, true);
+            case Operator::OP_OR:
+                return TranslateLogical(children, indent, false);
+            case Operator::OP_LESS: return Binary(children, " < ", indent);
+            case Operator::OP_LESS_EQUAL: return Binary(children, " <= ", indent);
+            case Operator::OP_GREATER: return Binary(children, " > ", indent);
+            case Operator::OP_GREATER_EQUAL: return Binary(children, " >= ", indent);
+            case Operator::OP_EQUAL: return Binary(children, " == ", indent);
+            case Operator::OP_NOT_EQUAL: return Binary(children, " != ", indent);
+            case Operator::OP_MUL: return Binary(children, " * ", indent);
+            case Operator::OP_MOD:
+                {
+                    std::string lhs = Expression(children[0], indent);
+                    std::string rhs = Expression(children[1], indent);
+                    return Temp(indent, "(long long)" + lhs + " % (long long)" + rhs);
+                }
+            case Operator::OP_DIV:
+                {
+                    // the divisor is evaluated first, the dividend is skipped if it is 0.
+                    std::string divisor = Expression(children[1], indent);
+                    std::string def = Literal(static_cast<const Div *>(node)->DefaultValue());
+                    std::string result = Temp(indent, def);
+                    Line(indent, "if (" + divisor + " == 0) {");
+                    Line(indent + 1, "DivZero(" + def + ");");
+                    Line(indent, "} else {");
+                    std::string dividend = Expression(children[0], indent + 1);
+                    Line(indent + 1, result + " = " + dividend + " / " + divisor + ";");
+                    Line(indent, "}");
+                    return result;
+                }
+            case Operator::OP_LOGISTIC:
+            case Operator::OP_ENSEMBLE:
+                for (std::size_t i = 0; i < children.size(); ++i) {
+                    Expression(children[i], indent); // the externs it reads
+                }
+                return node->Type() == Operator::OP_LOGISTIC ?
+                    TranslateLogistic(static_cast<const Logistic *>(node), indent) :
+                    TranslateEnsemble(static_cast<const Ensemble *>(node), indent);
+            case Operator::OP_CALL:
+                return TranslateCall(static_cast<const Call *>(node), indent);
+            }
+            return "0.0"; // unknown node
+        }
+
+        // the slots and weights are arrays before the function of the module.
+        std::string TranslateLogistic(const Logistic * node, int indent) {
+            const LinearModel * model = node->Model();
+            std::ostringstream name;
+            name << "lr" << models_++;
+
+            std::ostringstream arrays;
+            arrays << "// " << model->Path() << std::endl
+                   << "static const int " << name.str() << "_slots[] = {";
+            for (std::size_t i = 0; i < model->Size(); ++i) {
+                arrays << (i % 16 == 0 ? "\n    " : " ") << node->Slots()[i] << ",";
+            }
+            arrays << " 0 };" << std::endl
+                   << "static const double " << name.str() << "_weights[] = {";
+            for (std::size_t i = 0; i < model->Size(); ++i) {
+                arrays << "\n    " << Literal(model->Weights()[i]) << ",";
+            }
+            arrays << " 0.0 };" << std::endl;
+            functions_.push_back(arrays.str());
+
+            std::ostringstream call;
+            call << "Lr(s, " << name.str() << "_slots, " << name.str() << "_weights, "
+                 << model->Size() << "UL, " << Literal(model->Bias()) << ")";
+            return Temp(indent, call.str());
+        }
+
+        std::string TranslateEnsemble(const Ensemble * node, int indent) {
+            const TreeEnsemble * model = node->Model();
+            if (model->Trees() == 0) {
+                return Temp(indent, "0.0"); // no empty arrays
+            }
+            std::ostringstream name;
+            name << "lambdamart" << models_++;
+
+            std::ostringstream arrays;
+            arrays << "// " << model->Path() << std::endl
+                   << "static const int " << name.str() << "_slots[] = {";
+            for (std::size_t i = 0; i < model->Features().size(); ++i) {
+                arrays << (i % 16 == 0 ? "\n    " : " ") << node->Slots()[i] << ",";
+            }
+            arrays << " 0 };" << std::endl
+                   << "static const TreeNode " << name.str() << "_nodes[] = {";
+            const TreeEnsemble::Node * nodes = model->Nodes();
+            for (std::size_t i = 0; i < model->Size(); ++i) {
+                // the thresholds of the leaves are NaN, any NaN is
+                std::string threshold = nodes[i].threshold != nodes[i].threshold ?
+                    "NAN" : Literal(nodes[i].threshold);
+                arrays << "\n    { " << threshold << ", " << nodes[i].feature << ", " << nodes[i].left << " },";
+            }
+            arrays << "\n};" << std::endl
+                   << "static const double " << name.str() << "_leaves[] = {";
+            for (std::size_t i = 0; i < model->Size(); ++i) {
+                arrays << "\n    " << Literal(model->Leaves()[i]) << ",";
+            }
+            arrays << "\n};" << std::endl
+                   << "static const int " << name.str() << "_roots[] = {";
+            for (std::size_t i = 0; i < model->Trees(); ++i) {
+                arrays << (i % 16 == 0 ? "\n    " : " ") << model->Roots()[i] << ",";
+            }
+            arrays << " 0 };" << std::endl
+                   << "static const int " << name.str() << "_depths[] = {";
+            for (std::size_t i = 0; i < model->Trees(); ++i) {
+                arrays << (i % 16 == 0 ? "\n    " : " ") << model->Depths()[i] << ",";
+            }
+            arrays << " 0 };" << std::endl;
+            functions_.push_back(arrays.str());
+
+            std::ostringstream call;
+            call << "Trees(s, " << name.str() << "_slots, " << name.str() << "_nodes, "
+                 << name.str() << "_leaves, " << name.str() << "_roots, " << name.str() << "_depths, "
+                 << model->Trees() << "UL)";
+            return Temp(indent, call.str());
+        }
+
+        // the arguments are an array, in order; the function is called
+        // through the table the loader fills.
+        std::string TranslateCall(const Call * node, int indent) {
+            const Function * function = node->GetFunction();
+            std::size_t index = std::find(calls_.begin(), calls_.end(), function) - calls_.begin();
+            if (index == calls_.size()) {
+                calls_.push_back(function);
+            }
+
+            const OperatorList& children = node->Children();
+            std::string args = "0";
+            if (children.empty() == false) {
+                std::vector<std::string> values;
+                for (std::size_t i = 0; i < children.size(); ++i) {
+                    values.push_back(Expression(children[i], indent));
+                }
+                std::ostringstream array;
+                array << "a" << temps_++;
+                std::string line = "const double " + array.str() + "[] = {";
+                for (std::size_t i = 0; i < values.size(); ++i) {
+                    line += (i == 0 ? " " : ", ") + values[i];
+                }
+                Line(indent, line + " };");
+                args = array.str();
+            }
+
+            std::ostringstream call;
+            call << "ttl_functions[" << index << "](" << args << ")";
+            return Temp(indent, call.str());
+        }
+
+        std::string TranslateReference(const Reference * ref, int indent) {
+            std::string value = Expression(ref->Children()[0], indent);
+            std::string slot = Slot(ref->Slot());
+            if (ref->IsReturn()) {
+                Line(indent, slot + " = " + value + ";");
+                Line(indent, "return " + slot + ";");
+                return slot;
+            }
+
+            std::string def = Slot(ref->DefaultSlot());
+            switch (ref->AssignType()) {
+            case Reference::ASSIGN:
+                Line(indent, slot + " = " + value + ";");
+                break;
+            case Reference::ADD_ASSIGN:
+                Line(indent, slot + " = " + slot + " + " + value + ";");
+                break;
+            case Reference::SUB_ASSIGN:
+                Line(indent, slot + " = " + slot + " - " + value + ";");
+                break;
+            case Reference::MUL_ASSIGN:
+                Line(indent, slot + " = " + slot + " * " + value + ";");
+                break;
+            case Reference::DIV_ASSIGN:
+                Line(indent, slot + " = " + value + " == 0 ? " + def + " : " + slot + " / " + value + ";");
+                break;
+            case Reference::MOD_ASSIGN:
+                Line(indent, slot + " = " + value + " == 0 ? " + def + " : (double)((long long)"
+                     + slot + " % (long long)" + value + ");");
+                break;
+            }
+            return slot;
+        }
+
+        std::string TranslateIf(const OperatorList& children, int indent) {
+            std::string result = Temp(indent, "0.0");
+            int depth = 0;
+            std::size_t i = 0;
+            for (; i + 1 < children.size(); i += 2) {
+                std::string condition = Expression(children[i], indent + depth);
+                Line(indent + depth, "if (" + condition + " != 0) {");
+                Line(indent + depth + 1, result + " = " + Expression(children[i + 1], indent + depth + 1) + ";");
+                Line(indent + depth, "} else {");
+                ++depth;
+            }
+            if (i + 1 == children.size()) {
+                Line(indent + depth, result + " = " + Expression(children[i], indent + depth) + ";");
+            }
+            Close(indent, depth);
+            return result;
+        }
+
+        // "&&" is 1 if every condition is true, "||" is 0 if every one is false.
+        std::string TranslateLogical(const OperatorList& children, int indent, bool is_and) {
+            std::string result = Temp(indent, is_and ? "0.0" : "1.0");
+            int depth = 0;
+            for (std::size_t i = 0; i < children.size(); ++i, ++depth) {
+                std::string condition = Expression(children[i], indent + depth);
+                Line(indent + depth, "if (" + condition + (is_and ? " != 0) {" : " == 0) {"));
+            }
+            Line(indent + depth, result + (is_and ? " = 1.0;" : " = 0.0;"));
+            Close(indent, depth);
+            return result;
+        }
+
+        std::string Binary(const OperatorList& children, const char * op, int indent) {
+            std::string lhs = Expression(children[0], indent);
+            std::string rhs = Expression(children[1], indent);
+            return Temp(indent, lhs + op + rhs);
+        }
+
+        // declare a temporary initialized by 'value'
+        std::string Temp(int indent, const std::string& value) {
+            std::ostringstream name;
+            name << "t" << temps_++;
+            Line(indent, "double " + name.str() + " = " + value + ";");
+            return name.str();
+        }
+
+        void Close(int indent, int depth) {
+            while (depth-- > 0) {
+                Line(indent + depth, "}");
+            }
+        }
+
+        void Line(int indent, const std::string& text) {
+            *body_ << std::string(indent * 4, ' ') << text << std::endl;
+        }
+
+    private:
+        const Program& program_;
+        std::ostream& out_;
+        std::vector<std::string> functions_;
+        std::ostringstream * body_; // of the current module
+        int temps_;
+        int models_; // the arrays of "lr" and "lambdamart" emitted
+        std::vector<const Function *> calls_; // by the index in ttl_functions
+    };
+
+    void Aot::Translate(const Program& program, std::ostream& out) {
+        AotTranslator translator(program, out);
+        translator.Translate();
+    }
+
+    bool Aot::Compile(const Program& program, const std::string& path, std::string * error) {
+        std::string source = path + ".cc";
+        {
+            std::ofstream out(source.c_str());
+            Translate(program, out);
+            if (out.good() == false) {
+                *error = "can not write " + source;
+                return false;
+            }
+        }
+
+        const char * cxx = getenv("CXX");
+        const char * flags = getenv("CXXFLAGS");
+        std::string command = std::string(cxx != NULL ? cxx : "c++") + " "
+            + (flags != NULL ? flags : "-O2")
+            + " -shared -fPIC -o '" + path + "' '" + source + "'";
+        if (system(command.c_str()) != 0) {
+            *error = "failed: " + command;
+            return false;
+        }
+        return true;
+    }
+
+    // ttl_resolve of the shared objects
+    static void ResolveExtern(void * context, int index) {
+        static_cast<Context *>(context)->Resolve(index);
+    }
+
+    SharedProgram::SharedProgram(void * handle, Function evaluate)
+        : program_(), handle_(handle), evaluate_(evaluate) {}
+
+    SharedProgram::~SharedProgram() {
+        dlclose(handle_);
+    }
+
+    SharedProgram * SharedProgram::Load(const std::string& path, std::string * error) {
+        // dlopen searches the library path for names without "/"
+        std::string name = path.find('/') == std::string::npos ? "./" + path : path;
+        void * handle = dlopen(name.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (handle == NULL) {
+            *error = dlerror();
+            return NULL;
+        }
+
+        const int * version = (const int *)dlsym(handle, "ttl_abi_version");
+        const unsigned long * slot_count = (const unsigned long *)dlsym(handle, "ttl_slot_count");
+        const unsigned long long * initial = (const unsigned long long *)dlsym(handle, "ttl_initial_values");
+        const unsigned long * input_count = (const unsigned long *)dlsym(handle, "ttl_input_count");
+        const char * const * input_names = (const char * const *)dlsym(handle, "ttl_input_names");
+        const int * input_slots = (const int *)dlsym(handle, "ttl_input_slots");
+        Function evaluate = (Function)dlsym(handle, "ttl_evaluate");
+        if (version == NULL || slot_count == NULL || initial == NULL || input_count == NULL ||
+            input_names == NULL || input_slots == NULL || evaluate == NULL) {
+            *error = path + ": not a ttl shared object";
+            dlclose(handle);
+            return NULL;
+        }
+        if (*version != Aot::ABI_VERSION) {
+            *error = path + ": abi version mismatch";
+            dlclose(handle);
+            return NULL;
+        }
+
+        const unsigned long * function_count = (const unsigned long *)dlsym(handle, "ttl_function_count");
+        const char * const * function_names = (const char * const *)dlsym(handle, "ttl_function_names");
+        const int * function_arities = (const int *)dlsym(handle, "ttl_function_arities");
+        double (** functions)(const double *) = (double (**)(const double *))dlsym(handle, "ttl_functions");
+        if (function_count == NULL || function_names == NULL || function_arities == NULL || functions == NULL) {
+            *error = path + ": not a ttl shared object";
+            dlclose(handle);
+            return NULL;
+        }
+        for (unsigned long i = 0; i < *function_count; ++i) {
+            const ttl::Function * function = FindFunction(function_names[i]);
+            if (function == NULL || function->arity != function_arities[i]) {
+                *error = path + ": function " + function_names[i] + " is not registered";
+                dlclose(handle);
+                return NULL;
+            }
+            functions[i] = function->scalar;
+        }
+
+        const unsigned long * extern_count = (const unsigned long *)dlsym(handle, "ttl_extern_count");
+        const char * const * extern_names = (const char * const *)dlsym(handle, "ttl_extern_names");
+        const int * extern_slots = (const int *)dlsym(handle, "ttl_extern_slots");
+        const int * extern_resolved_slots = (const int *)dlsym(handle, "ttl_extern_resolved_slots");
+        void (** resolve)(void *, int) = (void (**)(void *, int))dlsym(handle, "ttl_resolve");
+        if (extern_count == NULL || extern_names == NULL || extern_slots == NULL ||
+            extern_resolved_slots == NULL || resolve == NULL) {
+            *error = path + ": not a ttl shared object";
+            dlclose(handle);
+            return NULL;
+        }
+        *resolve = &ResolveExtern;
+
+        std::map<int, std::string> inputs;
+        for (unsigned long i = 0; i < *input_count; ++i) {
+            inputs.insert(std::make_pair(input_slots[i], std::string(input_names[i])));
+        }
+
+        // the slots in the same order, inputs included.
+        SharedProgram * shared = new SharedProgram(handle, evaluate);
+        for (unsigned long slot = 0; slot < *slot_count; ++slot) {
+            double value;
+            memcpy(&value, &initial[slot], sizeof(value));
+            std::map<int, std::string>::iterator input = inputs.find(slot);
+            if (input != inputs.end()) {
+                shared->program_.AddInput(input->second, value);
+            } else {
+                shared->program_.AllocateSlot(value);
+            }
+        }
+        for (unsigned long i = 0; i < *extern_count; ++i) {
+            Extern e;
+            e.name = extern_names[i];
+            e.slot = extern_slots[i];
+            e.resolved_slot = extern_resolved_slots[i];
+            shared->program_.externs_.push_back(e);
+        }
+        return shared;
+    }
+
+} // ttl
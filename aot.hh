@@ -0,0 +1,98 @@
+/**
+ * aot.hh - compile a program to C++ and load it as a shared object
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#ifndef TTL_AOT_H
+#define TTL_AOT_H
+
+#include <ostream>
+#include <string>
+#include "program.hh"
+
+namespace ttl {
+
+    /**
+     * ahead-of-time compilation of a program.
+     *
+     * NOTE:
+     *     0. every module, including the modules of "include" and the
+     *        blocks of "if", becomes a C++ function, "return" is a C++
+     *        return; the nodes are evaluated in the same order as the tree
+     *        walker, so the results and messages are the same;
+     *     1. the shared object exports, with C linkage:
+     *            int ttl_abi_version;
+     *            unsigned long ttl_slot_count;
+     *            unsigned long long ttl_initial_values[]; // bits of double
+     *            unsigned long ttl_input_count;
+     *            const char * ttl_input_names[];
+     *            int ttl_input_slots[];
+     *            unsigned long ttl_function_count;
+     *            const char * ttl_function_names[];
+     *            int ttl_function_arities[];
+     *            double (* ttl_functions[])(const double * args);
+     *            unsigned long ttl_extern_count;
+     *            const char * ttl_extern_names[];
+     *            int ttl_extern_slots[];
+     *            int ttl_extern_resolved_slots[];
+     *            void (* ttl_resolve)(void * context, int index);
+     *            double ttl_evaluate(double * slots, void * context);
+     *        ttl_evaluate takes the slots of a Context, so SharedProgram can
+     *        evaluate it without the ast;
+     *     2. a native function is called through ttl_functions, which
+     *        SharedProgram::Load fills with the registered functions of the
+     *        same names, see RegisterFunction();
+     *     3. an extern not resolved yet is resolved by ttl_resolve, which
+     *        calls Context::Resolve() of 'context'.
+     */
+    class Aot {
+    public:
+        const static int ABI_VERSION = 3;
+
+        // write the C++ source of 'program'.
+        static void Translate(const Program& program, std::ostream& out);
+
+        // translate 'program' into 'path'.cc and build the shared object
+        // 'path' with $CXX (default "c++") and $CXXFLAGS (default "-O2").
+        // return false and set 'error' on failure.
+        static bool Compile(const Program& program, const std::string& path, std::string * error);
+    };
+
+    /**
+     * a program loaded from a shared object built by Aot::Compile.
+     *
+     * the program returned by GetProgram() has the slots, the inputs and
+     * the externs, but no ast, use it to create contexts only.
+     */
+    class SharedProgram {
+    public:
+        // return NULL and set 'error' if it can not be loaded.
+        static SharedProgram * Load(const std::string& path, std::string * error);
+
+        ~SharedProgram();
+
+        const Program& GetProgram() const { return program_; }
+
+        double Evaluate(Context& context) const {
+            return evaluate_(context.Registers(program_.SlotCount()), &context);
+        }
+
+    private:
+        typedef double (*Function)(double * slots, void * context);
+
+        SharedProgram(void * handle, Function evaluate);
+        SharedProgram(const SharedProgram&);
+        SharedProgram& operator=(const SharedProgram&);
+
+        Program program_;
+        void * handle_;
+        Function evaluate_;
+    };
+
+} // ttl
+
+#endif
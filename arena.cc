@@ -0,0 +1,59 @@
+/**
+ * arena.cc - bump allocator for the nodes of a program
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#include <stdlib.h> // for malloc
+#include "arena.hh"
+
+namespace ttl {
+
+    const std::size_t Arena::ALIGNMENT;
+    const std::size_t Arena::MIN_BLOCK_SIZE;
+    const std::size_t Arena::MAX_BLOCK_SIZE;
+
+    Arena::Arena()
+        : blocks_(NULL),
+          base_(NULL),
+          top_(NULL),
+          end_(NULL),
+          next_size_(MIN_BLOCK_SIZE),
+          used_(0),
+          reserved_(0) {}
+
+    Arena::~Arena() {
+        while (blocks_ != NULL) {
+            Block * next = blocks_->next;
+            free(blocks_);
+            blocks_ = next;
+        }
+    }
+
+    void * Arena::AllocateBlock(std::size_t size) {
+        // the header is padded, so the first object is aligned too.
+        const std::size_t header = (sizeof(Block) + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+        std::size_t capacity = next_size_ < size ? size : next_size_;
+        if (next_size_ < MAX_BLOCK_SIZE) {
+            next_size_ *= 2;
+        }
+
+        Block * block = static_cast<Block *>(malloc(header + capacity));
+        if (block == NULL) {
+            throw std::bad_alloc();
+        }
+        block->next = blocks_;
+        blocks_ = block;
+        reserved_ += header + capacity;
+
+        used_ += top_ - base_;
+        base_ = reinterpret_cast<char *>(block) + header;
+        top_ = base_ + size;
+        end_ = base_ + capacity;
+        return base_;
+    }
+
+} // ttl
@@ -0,0 +1,84 @@
+/**
+ * arena.hh - bump allocator for the nodes of a program
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#ifndef TTL_ARENA_H
+#define TTL_ARENA_H
+
+#include <cstddef>
+#include <new>
+
+namespace ttl {
+
+    /**
+     * memory handed out by bumping a pointer, released all at once.
+     *
+     * NOTE:
+     *     0. there is no per-object free, the destructor releases every
+     *        block; objects in an arena are never destructed, so they must
+     *        not own anything outside of it;
+     *     1. objects are laid out in allocation order, a block is twice as
+     *        big as the previous one, up to MAX_BLOCK_SIZE;
+     *     2. not thread safe, an arena belongs to the parser while parsing
+     *        and is read only after that.
+     */
+    class Arena {
+    public:
+        const static std::size_t ALIGNMENT = 16;
+        const static std::size_t MIN_BLOCK_SIZE = 4096;
+        const static std::size_t MAX_BLOCK_SIZE = 1 << 20;
+
+        Arena();
+        ~Arena();
+
+        // return 'size' bytes aligned to ALIGNMENT, never NULL.
+        void * Allocate(std::size_t size) {
+            size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+            if (static_cast<std::size_t>(end_ - top_) < size) {
+                return AllocateBlock(size);
+            }
+            void * p = top_;
+            top_ += size;
+            return p;
+        }
+
+        // bytes handed out, and bytes taken from malloc.
+        std::size_t Used() const { return used_ + (top_ - base_); }
+        std::size_t Reserved() const { return reserved_; }
+
+    private:
+        void * AllocateBlock(std::size_t size);
+
+    private:
+        Arena(const Arena&);
+        Arena& operator=(const Arena&);
+
+        struct Block {
+            Block * next;
+        };
+
+        Block * blocks_;
+        char * base_;          // the current block
+        char * top_;
+        char * end_;
+        std::size_t next_size_;
+        std::size_t used_;     // by the previous blocks
+        std::size_t reserved_;
+    };
+
+} // ttl
+
+// new (arena) T(...)
+inline void * operator new(std::size_t size, ttl::Arena& arena) {
+    return arena.Allocate(size);
+}
+
+// only called if the constructor throws, the memory stays in the arena.
+inline void operator delete(void *, ttl::Arena&) {}
+
+#endif
@@ -0,0 +1,622 @@
+/**
+ * batch.cc - columnar evaluation over many documents
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#include <stdlib.h> // for posix_memalign
+#include <string.h> // for memcpy
+#include <algorithm>
+#include <iostream>
+#include "batch.hh"
+#include "operator.hh"
+#include "types.hh"
+
+namespace ttl {
+
+    const std::size_t BatchEvaluator::BLOCK_SIZE;
+
+    static double * AllocateColumns(std::size_t count) {
+        void * memory = NULL;
+        if (posix_memalign(&memory, 64, std::max<std::size_t>(count, 1) * BatchEvaluator::BLOCK_SIZE * sizeof(double)) != 0) {
+            throw std::bad_alloc();
+        }
+        return static_cast<double *>(memory);
+    }
+
+    BatchEvaluator::BatchEvaluator(const Program& program, const Kernels& kernels)
+        : program_(program),
+          kernels_(kernels),
+          types_(new TypeInference(program)),
+          inputs_(program.SlotCount(), (const double *)NULL),
+          slots_(AllocateColumns(program.SlotCount())),
+          scratch_(),
+          columns_(),
+          resolver_(NULL),
+          top_(0),
+          first_(0),
+          rows_(0) {}
+
+    BatchEvaluator::~BatchEvaluator() {
+        delete types_;
+        free(slots_);
+        for (std::size_t i = 0; i < scratch_.size(); ++i) {
+            free(scratch_[i]);
+        }
+    }
+
+    bool BatchEvaluator::Bind(const std::string& name, const double * column) {
+        int slot = program_.Input(name);
+        if (slot < 0) {
+            return false;
+        }
+        Bind(slot, column);
+        return true;
+    }
+
+    void BatchEvaluator::Bind(int slot, const double * column) {
+        inputs_[slot] = column;
+    }
+
+    double * BatchEvaluator::Slot(int slot) {
+        if (inputs_[slot] != NULL) {
+            // inputs are never assigned, so the bound column is used in place.
+            return const_cast<double *>(inputs_[slot]) + first_;
+        }
+        return slots_ + slot * BLOCK_SIZE;
+    }
+
+    double * BatchEvaluator::Push() {
+        if (top_ == scratch_.size()) {
+            scratch_.push_back(AllocateColumns(1));
+        }
+        return scratch_[top_++];
+    }
+
+    Mask * BatchEvaluator::PushMask() {
+        return reinterpret_cast<Mask *>(Push());
+    }
+
+    long long * BatchEvaluator::PushIntegers() {
+        return reinterpret_cast<long long *>(Push());
+    }
+
+    bool BatchEvaluator::Any(const Mask * mask) const {
+        Mask any = 0;
+        for (std::size_t i = 0; i < rows_; ++i) {
+            any |= mask[i];
+        }
+        return any != 0;
+    }
+
+    void BatchEvaluator::Evaluate(std::size_t begin, std::size_t end, double * out) {
+        const std::vector<double>& initial = program_.InitialValues();
+        for (first_ = begin; first_ < end; first_ += BLOCK_SIZE) {
+            rows_ = std::min(BLOCK_SIZE, end - first_);
+            top_ = 0;
+
+            if (program_.ZeroInitialized()) {
+                memset(slots_, 0, initial.size() * BLOCK_SIZE * sizeof(double));
+            } else {
+                for (std::size_t i = 0; i < initial.size(); ++i) {
+                    kernels_.fill(slots_ + i * BLOCK_SIZE, initial[i], rows_);
+                }
+            }
+
+            Mask * all = PushMask();
+            for (std::size_t i = 0; i < rows_; ++i) {
+                all[i] = ~0ULL;
+            }
+
+            const double * result = Evaluate(program_.Root(), all);
+            memcpy(out + first_, result, rows_ * sizeof(double));
+        }
+    }
+
+    // the value of 'node' for the rows in 'mask', other rows are undefined.
+    const double * BatchEvaluator::Evaluate(const Operator * node, const Mask * mask) {
+        if (types_->OnIntegers(node)) {
+            return EvaluateInteger(node, mask);
+        }
+        const OperatorList& children = node->Children();
+        switch (node->Type()) {
+        case Operator::OP_MODULE:
+            return EvaluateModule(static_cast<const Module *>(node), mask);
+        case Operator::OP_NUM:
+            {
+                double * out = Push();
+                kernels_.fill(out, static_cast<const Num *>(node)->Value(), rows_);
+                return out;
+            }
+        case Operator::OP_VARIABLE:
+            return Slot(static_cast<const Variable *>(node)->Slot());
+        case Operator::OP_EXTERNAL:
+            return EvaluateExternal(static_cast<const External *>(node), mask);
+        case Operator::OP_REFERENCE:
+            return EvaluateReference(static_cast<const Reference *>(node), mask);
+        case Operator::OP_ADD:
+            {
+                // a + (-b) is exactly a - b
+                double * out = Push();
+                std::size_t mark = top_;
+                const double * acc = Evaluate(children[0], mask);
+                if (NeverNegativeZero(children[0]) == false) {
+                    // the sum starts from +0.0 like Add, -0 becomes +0
+                    double * zero = Push();
+                    kernels_.fill(zero, 0.0, rows_);
+                    kernels_.add(out, zero, acc, rows_);
+                    acc = out;
+                }
+                for (std::size_t i = 1; i < children.size(); ++i) {
+                    const Operator * addend = children[i];
+                    if (addend->Type() == Operator::OP_NEGATIVE) {
+                        kernels_.sub(out, acc, Evaluate(addend->Children()[0], mask), rows_);
+                    } else {
+                        kernels_.add(out, acc, Evaluate(addend, mask), rows_);
+                    }
+                    acc = out;
+                    top_ = mark;
+                }
+                if (acc != out) {
+                    memcpy(out, acc, rows_ * sizeof(double));
+                }
+                top_ = mark;
+                return out;
+            }
+        case Operator::OP_NEGATIVE:
+        case Operator::OP_NOT:
+            {
+                double * out = Push();
+                std::size_t mark = top_;
+                const double * value = Evaluate(children[0], mask);
+                if (node->Type() == Operator::OP_NEGATIVE) {
+                    kernels_.neg(out, value, rows_);
+                } else {
+                    kernels_.lnot(out, value, rows_);
+                }
+                top_ = mark;
+                return out;
+            }
+        case Operator::OP_IF:
+            return EvaluateIf(node, mask);
+        case Operator::OP_AND:
+            return EvaluateAnd(node, mask);
+        case Operator::OP_OR:
+            return EvaluateOr(node, mask);
+        case Operator::OP_LESS:
+            return EvaluateBinary(kernels_.lt, node, mask);
+        case Operator::OP_LESS_EQUAL:
+            return EvaluateBinary(kernels_.le, node, mask);
+        case Operator::OP_GREATER:
+            return EvaluateBinary(kernels_.gt, node, mask);
+        case Operator::OP_GREATER_EQUAL:
+            return EvaluateBinary(kernels_.ge, node, mask);
+        case Operator::OP_EQUAL:
+            return EvaluateBinary(kernels_.eq, node, mask);
+        case Operator::OP_NOT_EQUAL:
+            return EvaluateBinary(kernels_.ne, node, mask);
+        case Operator::OP_MUL:
+            return EvaluateBinary(kernels_.mul, node, mask);
+        case Operator::OP_MOD:
+            {
+                // no vector integer division, but only the active rows are
+                // computed: a row masked out by "if" may have a zero divisor.
+                double * out = Push();
+                std::size_t mark = top_;
+                const double * lhs = Evaluate(children[0], mask);
+                const double * rhs = Evaluate(children[1], mask);
+                for (std::size_t i = 0; i < rows_; ++i) {
+                    out[i] = mask[i] ? mod(lhs[i], rhs[i]) : 0;
+                }
+                top_ = mark;
+                return out;
+            }
+        case Operator::OP_DIV:
+            return EvaluateDiv(node, mask);
+        case Operator::OP_LOGISTIC:
+            return EvaluateLogistic(static_cast<const Logistic *>(node), mask);
+        case Operator::OP_ENSEMBLE:
+            return EvaluateEnsemble(static_cast<const Ensemble *>(node), mask);
+        case Operator::OP_CALL:
+            return EvaluateCall(static_cast<const Call *>(node), mask);
+        default:
+            std::cerr << "batch: unknown operator " << node->Type() << std::endl;
+            {
+                double * out = Push();
+                kernels_.fill(out, Constants::DEFAULT_RETURN_VALUE, rows_);
+                return out;
+            }
+        }
+    }
+
+    const double * BatchEvaluator::EvaluateBinary(void (*kernel)(double *, const double *, const double *, std::size_t),
+                                                  const Operator * node, const Mask * mask) {
+        double * out = Push();
+        std::size_t mark = top_;
+        const double * lhs = Evaluate(node->Children()[0], mask);
+        const double * rhs = Evaluate(node->Children()[1], mask);
+        kernel(out, lhs, rhs, rows_);
+        top_ = mark;
+        return out;
+    }
+
+    // out = a % divisor. if every |a| <= MAX_INTEGER, the quotient of
+    // |a| is (|a| * m) >> (53 + l), with l = ceil(log2 |divisor|) and
+    // m = 2^(53 + l) / |divisor| + 1: a multiplication instead of idiv.
+    static void ModNumber(long long * out, const long long * a, long long divisor, std::size_t n) {
+#if defined(__SIZEOF_INT128__)
+        const unsigned long long max = TypeInference::MAX_INTEGER;
+        bool small = true;
+        for (std::size_t i = 0; i < n; ++i) {
+            small &= (unsigned long long)a[i] + max <= 2 * max;
+        }
+        if (small) {
+            unsigned long long d = divisor < 0 ? 0 - (unsigned long long)divisor : divisor;
+            int shift = 53;
+            while ((1ULL << (shift - 53)) < d) {
+                ++shift;
+            }
+            unsigned long long m = (unsigned long long)(((unsigned __int128)1 << shift) / d) + 1;
+            for (std::size_t i = 0; i < n; ++i) {
+                unsigned long long x = a[i] < 0 ? 0 - (unsigned long long)a[i] : a[i];
+                unsigned long long q = (unsigned long long)(((unsigned __int128)x * m) >> shift);
+                long long r = (long long)(x - q * d);
+                out[i] = a[i] < 0 ? - r : r;
+            }
+            return;
+        }
+#endif
+        for (std::size_t i = 0; i < n; ++i) {
+            out[i] = a[i] % divisor;
+        }
+    }
+
+    const double * BatchEvaluator::EvaluateInteger(const Operator * node, const Mask * mask) {
+        double * out = Push();
+        std::size_t mark = top_;
+        if (IsComparison(node)) {
+            Integers lhs = Integer(TypeInference::Operand(node, 0), mask);
+            Integers rhs = Integer(TypeInference::Operand(node, 1), mask);
+            switch (node->Type()) {
+            case Operator::OP_LESS:
+                for (std::size_t i = 0; i < rows_; ++i) { out[i] = lhs[i] < rhs[i]; }
+                break;
+            case Operator::OP_LESS_EQUAL:
+                for (std::size_t i = 0; i < rows_; ++i) { out[i] = lhs[i] <= rhs[i]; }
+                break;
+            case Operator::OP_GREATER:
+                for (std::size_t i = 0; i < rows_; ++i) { out[i] = lhs[i] > rhs[i]; }
+                break;
+            case Operator::OP_GREATER_EQUAL:
+                for (std::size_t i = 0; i < rows_; ++i) { out[i] = lhs[i] >= rhs[i]; }
+                break;
+            case Operator::OP_EQUAL:
+                for (std::size_t i = 0; i < rows_; ++i) { out[i] = lhs[i] == rhs[i]; }
+                break;
+            default:
+                for (std::size_t i = 0; i < rows_; ++i) { out[i] = lhs[i] != rhs[i]; }
+                break;
+            }
+        } else {
+            Integers value = Integer(node, mask);
+            for (std::size_t i = 0; i < rows_; ++i) {
+                out[i] = (double)value[i];
+            }
+        }
+        top_ = mark;
+        return out;
+    }
+
+    // the rows out of 'mask' are 0, or the result of the operations on
+    // 0 and numbers: bounded like the rows in it, so they do not overflow.
+    BatchEvaluator::Integers BatchEvaluator::Integer(const Operator * node, const Mask * mask) {
+        Integers result = { NULL, 0 };
+        if (TypeInference::Constant(node, &result.number)) {
+            return result;
+        }
+
+        long long * out = PushIntegers();
+        result.column = out;
+        std::size_t mark = top_;
+        if (types_->Interior(node) == false) {
+            const double * value = Evaluate(node, mask);
+            for (std::size_t i = 0; i < rows_; ++i) {
+                out[i] = mask[i] ? (long long)value[i] : 0;
+            }
+        } else if (node->Type() == Operator::OP_ADD) {
+            const OperatorList& children = node->Children();
+            for (std::size_t k = 0; k < children.size(); ++k) {
+                Integers addend = Integer(TypeInference::Operand(node, k), mask);
+                bool negative = children[k]->Type() == Operator::OP_NEGATIVE;
+                if (k == 0) {
+                    for (std::size_t i = 0; i < rows_; ++i) { out[i] = negative ? - addend[i] : addend[i]; }
+                } else if (negative) {
+                    for (std::size_t i = 0; i < rows_; ++i) { out[i] -= addend[i]; }
+                } else {
+                    for (std::size_t i = 0; i < rows_; ++i) { out[i] += addend[i]; }
+                }
+                top_ = mark;
+            }
+        } else {
+            Integers lhs = Integer(node->Children()[0], mask);
+            Integers rhs = Integer(node->Children()[1], mask);
+            if (node->Type() == Operator::OP_MUL) {
+                for (std::size_t i = 0; i < rows_; ++i) { out[i] = lhs[i] * rhs[i]; }
+            } else if (rhs.column == NULL && rhs.number != 0 && lhs.column != NULL) {
+                ModNumber(out, lhs.column, rhs.number, rows_);
+            } else {
+                // a row masked out by "if" may have a zero divisor.
+                for (std::size_t i = 0; i < rows_; ++i) { out[i] = mask[i] ? lhs[i] % rhs[i] : 0; }
+            }
+        }
+        top_ = mark;
+        return result;
+    }
+
+    const double * BatchEvaluator::EvaluateDiv(const Operator * node, const Mask * mask) {
+        // the divisor is evaluated first, the dividend only for the rows
+        // whose divisor is not 0.
+        double * out = Push();
+        Mask * zero = PushMask();
+        Mask * nonzero = PushMask();
+        std::size_t mark = top_;
+
+        const double * divisor = Evaluate(node->Children()[1], mask);
+        kernels_.falsity(zero, mask, divisor, rows_);
+        kernels_.truth(nonzero, mask, divisor, rows_);
+
+        if (Any(nonzero)) {
+            const double * dividend = Evaluate(node->Children()[0], nonzero);
+            kernels_.div(out, dividend, divisor, rows_);
+        }
+
+        double default_value = static_cast<const Div *>(node)->DefaultValue();
+        for (std::size_t i = 0; i < rows_; ++i) {
+            if (zero[i]) {
+                std::cerr << "Divided by zero. Return default value "
+                          << default_value << "." << std::endl;
+                out[i] = default_value;
+            }
+        }
+        top_ = mark;
+        return out;
+    }
+
+    const double * BatchEvaluator::EvaluateIf(const Operator * node, const Mask * mask) {
+        const OperatorList& children = node->Children();
+        double * out = Push();
+        Mask * remaining = PushMask();
+        Mask * taken = PushMask();
+        memcpy(remaining, mask, rows_ * sizeof(Mask));
+        std::size_t mark = top_;
+
+        std::size_t i = 0;
+        for (i = 0; i + 1 < children.size() && Any(remaining); i += 2) {
+            const double * condition = Evaluate(children[i], remaining);
+            kernels_.truth(taken, remaining, condition, rows_);
+            kernels_.falsity(remaining, remaining, condition, rows_);
+            if (Any(taken)) {
+                kernels_.select(out, taken, Evaluate(children[i + 1], taken), rows_);
+            }
+            top_ = mark;
+        }
+
+        if (i + 1 == children.size()) {
+            // the last "else"
+            if (Any(remaining)) {
+                kernels_.select(out, remaining, Evaluate(children[i], remaining), rows_);
+            }
+        } else {
+            // take no effect when: if (false) { ... }
+            for (std::size_t j = 0; j < rows_; ++j) {
+                out[j] = remaining[j] ? 0 : out[j];
+            }
+        }
+        top_ = mark;
+        return out;
+    }
+
+    const double * BatchEvaluator::EvaluateAnd(const Operator * node, const Mask * mask) {
+        const OperatorList& children = node->Children();
+        double * out = Push();
+        Mask * alive = PushMask();
+        memcpy(alive, mask, rows_ * sizeof(Mask));
+        std::size_t mark = top_;
+
+        for (std::size_t i = 0; i < children.size() && Any(alive); ++i) {
+            kernels_.truth(alive, alive, Evaluate(children[i], alive), rows_);
+            top_ = mark;
+        }
+
+        kernels_.boolean(out, alive, rows_);
+        top_ = mark;
+        return out;
+    }
+
+    const double * BatchEvaluator::EvaluateOr(const Operator * node, const Mask * mask) {
+        const OperatorList& children = node->Children();
+        double * out = Push();
+        Mask * alive = PushMask();
+        Mask * decided = PushMask();
+        memcpy(alive, mask, rows_ * sizeof(Mask));
+        memset(decided, 0, rows_ * sizeof(Mask));
+        std::size_t mark = top_;
+
+        for (std::size_t i = 0; i < children.size() && Any(alive); ++i) {
+            const double * value = Evaluate(children[i], alive);
+            for (std::size_t j = 0; j < rows_; ++j) {
+                decided[j] |= (value[j] != 0) ? alive[j] : 0;
+            }
+            kernels_.falsity(alive, alive, value, rows_);
+            top_ = mark;
+        }
+
+        kernels_.boolean(out, decided, rows_);
+        top_ = mark;
+        return out;
+    }
+
+    const double * BatchEvaluator::EvaluateExternal(const External * node, const Mask * mask) {
+        double * value = Slot(node->Slot());
+        if (inputs_[node->Slot()] != NULL) {
+            return value;
+        }
+
+        // the rows which did not read it yet, one by one.
+        double * resolved = Slot(node->ResolvedSlot());
+        for (std::size_t i = 0; i < rows_; ++i) {
+            if (mask[i] && resolved[i] == 0) {
+                if (resolver_ != NULL) {
+                    value[i] = resolver_->Resolve(node->Index(), first_ + i);
+                }
+                resolved[i] = 1;
+            }
+        }
+        return value;
+    }
+
+    const double * BatchEvaluator::EvaluateLogistic(const Logistic * node, const Mask * mask) {
+        // a column per lane of Kernels::dot, summed in the same order; all
+        // the rows, it has no side effects.
+        for (std::size_t i = 0; i < node->Children().size(); ++i) {
+            EvaluateExternal(static_cast<const External *>(node->Children()[i]), mask);
+        }
+        double * out = Push();
+        std::size_t mark = top_;
+        double * lanes[DOT_LANES];
+        for (std::size_t k = 0; k < DOT_LANES; ++k) {
+            lanes[k] = Push();
+            kernels_.fill(lanes[k], 0.0, rows_);
+        }
+
+        const LinearModel * model = node->Model();
+        const double * weights = model->Weights();
+        const int * slots = node->Slots();
+        for (std::size_t i = 0; i < model->Size(); ++i) {
+            kernels_.axpy(lanes[i % DOT_LANES], weights[i], Slot(slots[i]), rows_);
+        }
+        kernels_.add(lanes[0], lanes[0], lanes[1], rows_);
+        kernels_.add(lanes[2], lanes[2], lanes[3], rows_);
+        kernels_.add(out, lanes[0], lanes[2], rows_);
+
+        double bias = model->Bias();
+        for (std::size_t i = 0; i < rows_; ++i) {
+            out[i] = sigmoid(out[i] + bias);
+        }
+        top_ = mark;
+        return out;
+    }
+
+    const double * BatchEvaluator::EvaluateEnsemble(const Ensemble * node, const Mask * mask) {
+        for (std::size_t i = 0; i < node->Children().size(); ++i) {
+            EvaluateExternal(static_cast<const External *>(node->Children()[i]), mask);
+        }
+        const TreeEnsemble * model = node->Model();
+        columns_.resize(model->Features().size());
+        for (std::size_t i = 0; i < columns_.size(); ++i) {
+            columns_[i] = Slot(node->Slots()[i]);
+        }
+        double * out = Push();
+        model->Evaluate(columns_.data(), rows_, out);
+        return out;
+    }
+
+    const double * BatchEvaluator::EvaluateCall(const Call * node, const Mask * mask) {
+        const Function * function = node->GetFunction();
+        const OperatorList& children = node->Children();
+        double * out = Push();
+        std::size_t mark = top_;
+        const double * args[Function::MAX_ARITY];
+        for (std::size_t i = 0; i < children.size(); ++i) {
+            args[i] = Evaluate(children[i], mask);
+        }
+
+        if (function->pure && function->batch != NULL) {
+            function->batch(out, args, rows_);
+        } else {
+            // the active rows only, an impure function may count its calls.
+            double values[Function::MAX_ARITY];
+            for (std::size_t i = 0; i < rows_; ++i) {
+                if (mask[i]) {
+                    for (std::size_t k = 0; k < children.size(); ++k) {
+                        values[k] = args[k][i];
+                    }
+                    out[i] = function->scalar(values);
+                }
+            }
+        }
+        top_ = mark;
+        return out;
+    }
+
+    const double * BatchEvaluator::EvaluateModule(const Module * module, const Mask * mask) {
+        const OperatorList& sentences = module->Children();
+        double * value = Push();
+        Mask * alive = PushMask();
+        std::size_t mark = top_;
+
+        const double * returned = Slot(module->ReturnedSlot());
+        memcpy(value, Slot(module->DefaultSlot()), rows_ * sizeof(double));
+        kernels_.falsity(alive, mask, returned, rows_);
+
+        // a row stops at its own "return"
+        for (std::size_t i = 0; i < sentences.size() && Any(alive); ++i) {
+            kernels_.select(value, alive, Evaluate(sentences[i], alive), rows_);
+            kernels_.falsity(alive, alive, returned, rows_);
+            top_ = mark;
+        }
+
+        Mask * has_returned = PushMask();
+        kernels_.truth(has_returned, mask, returned, rows_);
+        kernels_.select(value, has_returned, Slot(module->ReturnSlot()), rows_);
+        top_ = mark;
+        return value;
+    }
+
+    const double * BatchEvaluator::EvaluateReference(const Reference * ref, const Mask * mask) {
+        const double * value = Evaluate(ref->Children()[0], mask);
+        double * slot = Slot(ref->Slot());
+
+        if (ref->IsReturn()) {
+            double * returned = Slot(ref->ReturnedSlot());
+            kernels_.select(slot, mask, value, rows_);
+            for (std::size_t i = 0; i < rows_; ++i) {
+                returned[i] = mask[i] ? 1 : returned[i];
+            }
+            return slot;
+        }
+
+        if (ref->AssignType() == Reference::ASSIGN) {
+            kernels_.select(slot, mask, value, rows_);
+            return slot;
+        }
+
+        double * result = Push();
+        switch (ref->AssignType()) {
+        case Reference::ADD_ASSIGN: kernels_.add(result, slot, value, rows_); break;
+        case Reference::SUB_ASSIGN: kernels_.sub(result, slot, value, rows_); break;
+        case Reference::MUL_ASSIGN: kernels_.mul(result, slot, value, rows_); break;
+        case Reference::DIV_ASSIGN:
+        case Reference::MOD_ASSIGN:
+            {
+                // "/=" and "%=" take the "default" variable if rhs is 0
+                const double * default_value = Slot(ref->DefaultSlot());
+                bool is_div = ref->AssignType() == Reference::DIV_ASSIGN;
+                for (std::size_t i = 0; i < rows_; ++i) {
+                    if (value[i] == 0 || mask[i] == 0) {
+                        result[i] = default_value[i];
+                    } else {
+                        result[i] = is_div ? slot[i] / value[i] : mod(slot[i], value[i]);
+                    }
+                }
+            }
+            break;
+        }
+        kernels_.select(slot, mask, result, rows_);
+        return slot;
+    }
+
+} // ttl
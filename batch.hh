@@ -0,0 +1,126 @@
+/**
+ * batch.hh - columnar evaluation over many documents
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#ifndef TTL_BATCH_H
+#define TTL_BATCH_H
+
+#include <string>
+#include <vector>
+#include "kernels.hh"
+#include "program.hh"
+
+namespace ttl {
+
+    class Operator;
+    class Module;
+    class Reference;
+    class Logistic;
+    class Ensemble;
+    class Call;
+    class External;
+    class TypeInference;
+
+    /**
+     * evaluate a program over columns of inputs, one row per document.
+     *
+     * NOTE:
+     *     0. rows are processed in blocks of BLOCK_SIZE: every node is
+     *        evaluated for the whole block with one kernel call, every slot
+     *        is a column of the block;
+     *     1. "if", "&&", "||" and "return" narrow a mask of active rows,
+     *        a subtree is skipped when no row of the block reaches it;
+     *     2. the result of each row is the same as Program::Evaluate with
+     *        the inputs of that row;
+     *     3. one evaluator per thread, like Context;
+     *     4. an extern bound to a column is read from it, else the
+     *        resolver is called for the active rows which read it first,
+     *        with the row number given to Evaluate();
+     *     5. the nodes of TypeInference::OnIntegers() are computed on int64
+     *        columns, converted at the bounds of their regions.
+     */
+    class BatchEvaluator {
+    public:
+        const static std::size_t BLOCK_SIZE = 256;
+
+        explicit BatchEvaluator(const Program& program,
+                                const Kernels& kernels = BestKernels());
+        ~BatchEvaluator();
+
+        // bind input (or extern) 'name' to a column, the column must hold
+        // all rows evaluated. return false if 'name' is not an input.
+        bool Bind(const std::string& name, const double * column);
+        void Bind(int slot, const double * column);
+
+        // the resolver of the externs not bound, NULL keeps them 0.
+        void SetResolver(Resolver * resolver) { resolver_ = resolver; }
+
+        // evaluate rows [begin, end) of the bound columns, the result of
+        // row i is stored in out[i].
+        void Evaluate(std::size_t begin, std::size_t end, double * out);
+
+        void Evaluate(std::size_t rows, double * out) {
+            Evaluate(0, rows, out);
+        }
+
+    private:
+        const double * Evaluate(const Operator * node, const Mask * mask);
+        const double * EvaluateModule(const Module * module, const Mask * mask);
+        const double * EvaluateReference(const Reference * ref, const Mask * mask);
+        const double * EvaluateDiv(const Operator * node, const Mask * mask);
+        const double * EvaluateIf(const Operator * node, const Mask * mask);
+        const double * EvaluateAnd(const Operator * node, const Mask * mask);
+        const double * EvaluateOr(const Operator * node, const Mask * mask);
+        const double * EvaluateExternal(const External * node, const Mask * mask);
+        const double * EvaluateLogistic(const Logistic * node, const Mask * mask);
+        const double * EvaluateEnsemble(const Ensemble * node, const Mask * mask);
+        const double * EvaluateCall(const Call * node, const Mask * mask);
+        const double * EvaluateBinary(void (*kernel)(double *, const double *, const double *, std::size_t),
+                                      const Operator * node, const Mask * mask);
+        // 'node' is the top of a region of int64 nodes.
+        const double * EvaluateInteger(const Operator * node, const Mask * mask);
+        // an int64 operand: a column, or a number for every row.
+        struct Integers {
+            const long long * column;
+            long long number;
+            long long operator[](std::size_t i) const { return column != NULL ? column[i] : number; }
+        };
+        // the int64 value of a node of the region, or of its operand.
+        Integers Integer(const Operator * node, const Mask * mask);
+
+        // the column of a slot in the current block
+        double * Slot(int slot);
+
+        // following are the scratch columns, allocated and released as a stack.
+        double * Push();
+        Mask * PushMask();
+        long long * PushIntegers();
+        bool Any(const Mask * mask) const;
+
+    private:
+        BatchEvaluator(const BatchEvaluator&);
+        BatchEvaluator& operator=(const BatchEvaluator&);
+
+        const Program& program_;
+        const Kernels& kernels_;
+        TypeInference * types_;
+        std::vector<const double *> inputs_; // bound column of each slot, or NULL
+        double * slots_;                     // SlotCount() columns
+        std::vector<double *> scratch_;
+        std::vector<const double *> columns_; // of the features of a model
+        Resolver * resolver_;
+        std::size_t top_;
+
+        // the current block
+        std::size_t first_;
+        std::size_t rows_;
+    };
+
+} // ttl
+
+#endif
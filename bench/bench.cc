@@ -0,0 +1,598 @@
+/**
+ * bench.cc - benchmarks of the tokenizer, the parser, the optimizer and
+ *            the engines
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#include <dirent.h>
+#include <errno.h>
+#include <getopt.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "batch.hh"
+#include "bytecode.hh"
+#include "cache.hh"
+#include "common.hh"
+#include "cse.hh"
+#include "jit.hh"
+#include "optimizer.hh"
+#include "parser.hh"
+#include "tokenizer.hh"
+
+#ifndef TTL_BENCH_CORPUS
+#define TTL_BENCH_CORPUS "bench/corpus"
+#endif
+
+using namespace ttl;
+
+/**
+ * a script of the benchmark, and the values of its inputs.
+ *
+ * every script may read the inputs x, y and z, a case overrides the
+ * values it needs.
+ */
+struct Case {
+    std::string name;
+    std::string source;
+    std::vector<std::pair<std::string, double> > inputs;
+};
+
+// the timings of one stage of a case, in ns per operation.
+struct Stage {
+    std::string name;
+    std::string unit;
+    std::size_t iterations; // operations per sample
+    std::vector<double> samples;
+};
+
+struct Options {
+    int warmup;
+    int repeat;
+    double min_sample; // ns
+    std::string filter;
+    std::string corpus;
+    double size;       // MB of the generated script
+    bool json;
+};
+
+const static std::size_t BATCH_ROWS = 1024;
+
+static void Usage(const char * name) {
+    std::cerr << "usage: " << name << " [options]" << std::endl
+              << "  -w, --warmup=N        samples run before measuring, default 3" << std::endl
+              << "  -r, --repeat=N        samples measured, default 20" << std::endl
+              << "  -t, --min-time=US     run each sample at least US microseconds, default 2000" << std::endl
+              << "  -f, --filter=TEXT     run the cases whose names contain TEXT" << std::endl
+              << "  -c, --corpus=DIR      the scripts *.ttl of DIR are cases, default " TTL_BENCH_CORPUS << std::endl
+              << "  -s, --size=MB         the size of the generated large script, default 2" << std::endl
+              << "  -j, --json            print the results as json" << std::endl;
+}
+
+static double Now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static bool Same(double a, double b) {
+    return memcmp(&a, &b, sizeof(a)) == 0 || (isnan(a) && isnan(b));
+}
+
+// the cases of corpus/*.ttl, by name.
+static bool LoadCorpus(const std::string& dir, std::vector<Case> * cases) {
+    DIR * d = opendir(dir.c_str());
+    if (d == NULL) {
+        std::cerr << dir << ": directory not readable" << std::endl;
+        return false;
+    }
+
+    std::vector<std::string> names;
+    struct dirent * entry;
+    while ((entry = readdir(d)) != NULL) {
+        std::string name = entry->d_name;
+        if (name.size() > 4 && name.compare(name.size() - 4, 4, ".ttl") == 0) {
+            names.push_back(name);
+        }
+    }
+    closedir(d);
+    std::sort(names.begin(), names.end());
+
+    for (std::size_t i = 0; i < names.size(); ++i) {
+        MappedFile content;
+        if (content.Open(dir + "/" + names[i]) == false) {
+            std::cerr << dir << "/" << names[i] << ": file not readable" << std::endl;
+            return false;
+        }
+        Case c;
+        c.name = names[i].substr(0, names[i].size() - 4);
+        c.source.assign(content.Data(), content.Size());
+        cases->push_back(c);
+    }
+    return true;
+}
+
+// "if (x == 0) { ... } else if (x == 1) { ... } ...", x selects the last arm.
+static Case IfChain(int arms) {
+    std::ostringstream os;
+    for (int i = 0; i < arms; ++i) {
+        if (i > 0) {
+            os << " else ";
+        }
+        os << "if (x == " << i << ") {\n    return y * " << i + 1 << " + z;\n}";
+    }
+    os << " else {\n    return -1;\n}\n";
+
+    Case c;
+    c.name = "if_chain";
+    c.source = os.str();
+    c.inputs.push_back(std::make_pair("x", arms - 1));
+    return c;
+}
+
+// "return x * 1 + y * 2 + ...", one flat sum.
+static Case WideSum(int addends) {
+    const char * const inputs[] = { "x", "y", "z" };
+    std::ostringstream os;
+    os << "return ";
+    for (int i = 0; i < addends; ++i) {
+        os << (i > 0 ? " + " : "") << inputs[i % 3] << " * " << i % 97 + 1;
+        if (i % 8 == 7) {
+            os << "\n";
+        }
+    }
+    os << ";\n";
+
+    Case c;
+    c.name = "wide_sum";
+    c.source = os.str();
+    return c;
+}
+
+// a chain of assignments of about 'size' bytes.
+static Case Large(std::size_t size) {
+    std::ostringstream os;
+    os << "v0 = x;\n";
+    int i = 1;
+    for (; (std::size_t)os.tellp() < size; ++i) {
+        os << "v" << i << " = (v" << i - 1 << " * 0.5 + x) % 97 - y / " << i % 13 + 1
+           << " + (z > " << i % 10 << " && v" << i / 2 << " < 50);\n";
+    }
+    os << "return v" << i - 1 << ";\n";
+
+    Case c;
+    c.name = "large";
+    c.source = os.str();
+    return c;
+}
+
+/**
+ * files included 'depth' levels deep, 'fanout' includes per file.
+ *
+ * the files are written to a new directory, its path is returned in
+ * 'dir' and the files in 'files', to be removed by the caller.
+ */
+static bool IncludeTree(int depth, int fanout, std::string * dir, std::vector<std::string> * files, Case * c) {
+    char path[] = "/tmp/ttl_bench.XXXXXX";
+    if (mkdtemp(path) == NULL) {
+        std::cerr << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    *dir = path;
+
+    // file i includes files i * fanout + 1 ... i * fanout + fanout, level
+    // by level, so file 0 is the root.
+    int count = 0;
+    for (int level = 0, width = 1; level <= depth; ++level, width *= fanout) {
+        count += width;
+    }
+    int parents = (count - 1) / fanout;
+
+    for (int i = count - 1; i >= 0; --i) {
+        std::ostringstream os;
+        if (i < parents) {
+            for (int k = 1; k <= fanout; ++k) {
+                os << "include(" << *dir << "/n" << i * fanout + k << ".ttl);\n";
+            }
+        } else {
+            for (int k = 0; k < 32; ++k) {
+                os << "a" << k << " = x * " << k + i << " + y / " << k + 1 << " - (z < " << k << ");\n";
+            }
+        }
+        os << "a = x * " << i + 1 << " + y;\nb = a / 3 - z;\nreturn a + b * 0.5;\n";
+
+        std::string file = *dir + "/n" + std::to_string(i) + ".ttl";
+        FILE * f = fopen(file.c_str(), "w");
+        if (f == NULL) {
+            std::cerr << file << ": " << strerror(errno) << std::endl;
+            return false;
+        }
+        files->push_back(file);
+        fputs(os.str().c_str(), f);
+        fclose(f);
+
+        if (i == 0) {
+            c->name = "include_tree";
+            c->source = os.str();
+        }
+    }
+    return true;
+}
+
+static Program * Parse(const Case& c, bool optimize, std::string * error) {
+    Parser p;
+    p.SetOptimize(optimize);
+    p.AddInput("x");
+    p.AddInput("y");
+    p.AddInput("z");
+    if (p.Create(c.source.data(), c.source.size()) == false) {
+        std::string context;
+        p.ErrorContext(context);
+        *error = c.name + ": " + p.ErrorMsg() + "\n" + context;
+        return NULL;
+    }
+    return p.Release();
+}
+
+static void SetInputs(const Case& c, Context& context) {
+    context.Set("x", 0.37);
+    context.Set("y", 12);
+    context.Set("z", -3);
+    for (std::size_t i = 0; i < c.inputs.size(); ++i) {
+        context.Set(c.inputs[i].first, c.inputs[i].second);
+    }
+}
+
+/**
+ * time 'run', which performs 'n' operations and returns the ns they took.
+ *
+ * NOTE:
+ *     0. a sample runs enough operations to last 'min_sample' ns, so
+ *        short operations are not below the resolution of the clock. the
+ *        count is found by running more and more operations;
+ *     1. 'warmup' samples are dropped, then 'repeat' samples are kept,
+ *        as the ns per operation, or per row if an operation evaluates
+ *        'rows' rows.
+ */
+template <typename Run>
+static Stage Measure(const std::string& name, const Options& options, Run run, std::size_t rows = 1) {
+    Stage stage;
+    stage.name = name;
+    stage.unit = rows > 1 ? "ns/row" : "ns/op";
+
+    stage.iterations = 1;
+    for (double elapsed = run(1); elapsed < options.min_sample && stage.iterations < 10000000; ) {
+        double scale = std::min(options.min_sample / std::max(elapsed, 1.0) * 1.2, 10.0);
+        stage.iterations = (std::size_t)std::max(stage.iterations * scale, stage.iterations + 1.0);
+        elapsed = run(stage.iterations);
+    }
+
+    for (int i = 0; i < options.warmup; ++i) {
+        run(stage.iterations);
+    }
+    for (int i = 0; i < options.repeat; ++i) {
+        stage.samples.push_back(run(stage.iterations) / stage.iterations / rows);
+    }
+    return stage;
+}
+
+template <typename Engine>
+static Stage MeasureEngine(const std::string& name, const Engine& engine, const Program& program,
+                           const Case& c, const Options& options, double * result) {
+    Context context(program);
+    context.Reset();
+    SetInputs(c, context);
+    *result = engine.Evaluate(context);
+
+    return Measure(name, options, [&](std::size_t n) {
+        double start = Now();
+        for (std::size_t i = 0; i < n; ++i) {
+            context.Reset();
+            SetInputs(c, context);
+            engine.Evaluate(context);
+        }
+        return Now() - start;
+    });
+}
+
+// run every stage of 'c', return false if it does not parse, or if the
+// engines disagree.
+static bool RunCase(const Case& c, const Options& options, std::vector<Stage> * stages,
+                    std::size_t * tokens, std::size_t * slots) {
+    std::string error;
+    Program * program = Parse(c, true, &error);
+    if (program == NULL) {
+        std::cerr << error << std::endl;
+        return false;
+    }
+    *slots = program->SlotCount();
+
+    Tokenizer tokenizer(c.source.data(), c.source.size());
+    Token token;
+    *tokens = 0;
+    do {
+        tokenizer.NextToken(token);
+        ++*tokens;
+    } while (token.token_type != Tokenizer::TOKEN_EOL);
+
+    stages->push_back(Measure("tokenize", options, [&](std::size_t n) {
+        double start = Now();
+        for (std::size_t i = 0; i < n; ++i) {
+            tokenizer.Reset(c.source.data(), c.source.size());
+            do {
+                tokenizer.NextToken(token);
+            } while (token.token_type != Tokenizer::TOKEN_EOL);
+        }
+        return Now() - start;
+    }));
+
+    // the included files are parsed every time, not copied from the cache.
+    stages->push_back(Measure("parse", options, [&](std::size_t n) {
+        std::vector<Program *> programs;
+        double start = Now();
+        for (std::size_t i = 0; i < n; ++i) {
+            ModuleCache::Instance().Clear();
+            programs.push_back(Parse(c, false, &error));
+        }
+        double elapsed = Now() - start;
+        for (std::size_t i = 0; i < programs.size(); ++i) {
+            delete programs[i];
+        }
+        return elapsed;
+    }));
+
+    stages->push_back(Measure("optimize", options, [&](std::size_t n) {
+        std::vector<Program *> programs;
+        for (std::size_t i = 0; i < n; ++i) {
+            programs.push_back(Parse(c, false, &error));
+        }
+        double start = Now();
+        for (std::size_t i = 0; i < n; ++i) {
+            Optimizer optimizer(programs[i]);
+            optimizer.Run();
+            SubexpressionEliminator eliminator(programs[i]);
+            eliminator.Run();
+        }
+        double elapsed = Now() - start;
+        for (std::size_t i = 0; i < programs.size(); ++i) {
+            delete programs[i];
+        }
+        return elapsed;
+    }));
+
+    double results[4];
+    Bytecode bytecode(*program);
+    Jit jit(*program);
+    stages->push_back(MeasureEngine("evaluate.tree", *program, *program, c, options, &results[0]));
+    stages->push_back(MeasureEngine("evaluate.bytecode", bytecode, *program, c, options, &results[1]));
+    stages->push_back(MeasureEngine("evaluate.jit", jit, *program, c, options, &results[2]));
+
+    // every row has the same inputs, so every row takes the same path.
+    Context context(*program);
+    context.Reset();
+    SetInputs(c, context);
+    std::vector<double> columns(3 * BATCH_ROWS);
+    const char * const inputs[] = { "x", "y", "z" };
+    BatchEvaluator batch(*program);
+    for (int i = 0; i < 3; ++i) {
+        double * column = &columns[i * BATCH_ROWS];
+        std::fill(column, column + BATCH_ROWS, context.Get(program->Input(inputs[i])));
+        batch.Bind(inputs[i], column);
+    }
+    std::vector<double> out(BATCH_ROWS);
+    batch.Evaluate(BATCH_ROWS, &out[0]);
+    results[3] = out.back();
+
+    stages->push_back(Measure("evaluate.batch", options, [&](std::size_t n) {
+        double start = Now();
+        for (std::size_t i = 0; i < n; ++i) {
+            batch.Evaluate(BATCH_ROWS, &out[0]);
+        }
+        return Now() - start;
+    }, BATCH_ROWS));
+
+    delete program;
+
+    const char * const engines[] = { "tree", "bytecode", "jit", "batch" };
+    for (int i = 1; i < 4; ++i) {
+        if (Same(results[0], results[i]) == false) {
+            std::cerr << c.name << ": " << engines[i] << " returns " << results[i]
+                      << ", tree returns " << results[0] << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// the nearest rank percentile of sorted 'samples'.
+static double Percentile(const std::vector<double>& samples, double percent) {
+    std::size_t rank = (std::size_t)ceil(percent / 100 * samples.size());
+    return samples[rank > 0 ? rank - 1 : 0];
+}
+
+struct Summary {
+    double min, p50, p90, p99, max, mean;
+
+    explicit Summary(std::vector<double> samples) {
+        std::sort(samples.begin(), samples.end());
+        min = samples.front();
+        p50 = Percentile(samples, 50);
+        p90 = Percentile(samples, 90);
+        p99 = Percentile(samples, 99);
+        max = samples.back();
+        mean = 0;
+        for (std::size_t i = 0; i < samples.size(); ++i) {
+            mean += samples[i];
+        }
+        mean /= samples.size();
+    }
+};
+
+static std::string Quote(const std::string& s) {
+    std::string quoted = "\"";
+    for (std::size_t i = 0; i < s.size(); ++i) {
+        if (s[i] == '"' || s[i] == '\\') {
+            quoted += '\\';
+        }
+        quoted += s[i];
+    }
+    return quoted + "\"";
+}
+
+struct Result {
+    Case c;
+    std::size_t tokens;
+    std::size_t slots;
+    std::vector<Stage> stages;
+};
+
+static void PrintTable(const std::vector<Result>& results) {
+    printf("%-14s %-18s %12s %12s %12s %12s %8s\n", "case", "stage", "min", "p50", "p90", "p99", "unit");
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        for (std::size_t j = 0; j < results[i].stages.size(); ++j) {
+            const Stage& stage = results[i].stages[j];
+            Summary s(stage.samples);
+            printf("%-14s %-18s %12.1f %12.1f %12.1f %12.1f %8s\n", results[i].c.name.c_str(),
+                   stage.name.c_str(), s.min, s.p50, s.p90, s.p99, stage.unit.c_str());
+        }
+    }
+}
+
+static void PrintJson(const std::vector<Result>& results, const Options& options) {
+    printf("{\n");
+    printf("  \"scanner\": %s,\n", Quote(BestScanner().name).c_str());
+    printf("  \"kernels\": %s,\n", Quote(BestKernels().name).c_str());
+    printf("  \"warmup\": %d,\n", options.warmup);
+    printf("  \"repeat\": %d,\n", options.repeat);
+    printf("  \"min_sample_ns\": %.0f,\n", options.min_sample);
+    printf("  \"cases\": [");
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        printf("%s\n    {\n", i > 0 ? "," : "");
+        printf("      \"name\": %s,\n", Quote(r.c.name).c_str());
+        printf("      \"bytes\": %zu,\n", r.c.source.size());
+        printf("      \"tokens\": %zu,\n", r.tokens);
+        printf("      \"slots\": %zu,\n", r.slots);
+        printf("      \"stages\": [");
+        for (std::size_t j = 0; j < r.stages.size(); ++j) {
+            const Stage& stage = r.stages[j];
+            Summary s(stage.samples);
+            printf("%s\n        { \"stage\": %s, \"unit\": %s, \"iterations\": %zu, \"samples\": %zu,"
+                   " \"min\": %.1f, \"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, \"max\": %.1f, \"mean\": %.1f }",
+                   j > 0 ? "," : "", Quote(stage.name).c_str(), Quote(stage.unit).c_str(),
+                   stage.iterations, stage.samples.size(), s.min, s.p50, s.p90, s.p99, s.max, s.mean);
+        }
+        printf("\n      ]\n    }");
+    }
+    printf("\n  ]\n}\n");
+}
+
+int main(int argc, char ** argv) {
+    Options options;
+    options.warmup = 3;
+    options.repeat = 20;
+    options.min_sample = 2000 * 1e3;
+    options.corpus = TTL_BENCH_CORPUS;
+    options.size = 2;
+    options.json = false;
+
+    static struct option long_options[] = {
+        { "warmup", required_argument, NULL, 'w' },
+        { "repeat", required_argument, NULL, 'r' },
+        { "min-time", required_argument, NULL, 't' },
+        { "filter", required_argument, NULL, 'f' },
+        { "corpus", required_argument, NULL, 'c' },
+        { "size", required_argument, NULL, 's' },
+        { "json", no_argument, NULL, 'j' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "w:r:t:f:c:s:jh", long_options, NULL)) != -1) {
+        switch (c) {
+        case 'w': options.warmup = atoi(optarg); break;
+        case 'r': options.repeat = atoi(optarg); break;
+        case 't': options.min_sample = atof(optarg) * 1e3; break;
+        case 'f': options.filter = optarg; break;
+        case 'c': options.corpus = optarg; break;
+        case 's': options.size = atof(optarg); break;
+        case 'j': options.json = true; break;
+        default:
+            Usage(argv[0]);
+            return c == 'h' ? 0 : 1;
+        }
+    }
+    if (optind != argc) {
+        Usage(argv[0]);
+        return 1;
+    }
+    if (options.warmup < 0) {
+        options.warmup = 0;
+    }
+    if (options.repeat < 1) {
+        options.repeat = 1;
+    }
+
+    Parser::Init();
+
+    std::vector<Case> cases;
+    if (LoadCorpus(options.corpus, &cases) == false) {
+        return 1;
+    }
+    cases.push_back(IfChain(500));
+    cases.push_back(WideSum(4000));
+    cases.push_back(Large((std::size_t)(options.size * (1 << 20))));
+
+    std::string dir;
+    std::vector<std::string> files;
+    Case tree;
+    bool ok = IncludeTree(3, 5, &dir, &files, &tree);
+    if (ok) {
+        cases.push_back(tree);
+    }
+
+    std::vector<Result> results;
+    for (std::size_t i = 0; ok && i < cases.size(); ++i) {
+        if (cases[i].name.find(options.filter) == std::string::npos) {
+            continue;
+        }
+        Result result;
+        result.c = cases[i];
+        ok = RunCase(cases[i], options, &result.stages, &result.tokens, &result.slots);
+        results.push_back(result);
+        if (options.json == false && ok) {
+            std::cerr << cases[i].name << " done" << std::endl;
+        }
+    }
+
+    for (std::size_t i = 0; i < files.size(); ++i) {
+        unlink(files[i].c_str());
+    }
+    if (dir.empty() == false) {
+        rmdir(dir.c_str());
+    }
+
+    if (ok == false) {
+        return 1;
+    }
+    if (options.json) {
+        PrintJson(results, options);
+    } else {
+        PrintTable(results);
+    }
+    return 0;
+}
@@ -0,0 +1,680 @@
+/**
+ * bytecode.cc - compile the ast to bytecode, and run it
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#include <string.h> // for memcpy
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include "bytecode.hh"
+#include "operator.hh"
+#include "types.hh"
+
+namespace ttl {
+
+    class BytecodeCompiler {
+    public:
+        BytecodeCompiler(Bytecode * code)
+            : code_(code), types_(code->program_), temp_top_(0), max_temp_(0), last_target_(0) {}
+
+        void Compile() {
+            const Module * root = code_->program_.Root();
+            code_->constant_base_ = code_->program_.SlotCount();
+            CollectConstants(root);
+            code_->temp_base_ = code_->constant_base_ + code_->constants_.size();
+
+            int result = Compile(root, -1);
+            Emit(Bytecode::OP_RET, result);
+
+            code_->register_count_ = code_->temp_base_ + max_temp_;
+        }
+
+    private:
+        struct Frame {
+            int result;                    // register of the module value
+            std::vector<std::size_t> exits; // "return" jumps to patch
+        };
+
+        void CollectConstants(const Operator * node) {
+            if (types_.OnIntegers(node)) {
+                CollectIntegers(node);
+                return;
+            }
+            if (node->Type() == Operator::OP_NUM) {
+                Constant(static_cast<const Num *>(node)->Value());
+            } else if (node->Type() == Operator::OP_DIV) {
+                Constant(static_cast<const Div *>(node)->DefaultValue());
+            } else if (node->Type() == Operator::OP_ADD &&
+                       NeverNegativeZero(node->Children()[0]) == false) {
+                Constant(0.0);
+            }
+
+            const OperatorList& children = node->Children();
+            for (std::size_t i = 0; i < children.size(); ++i) {
+                CollectConstants(children[i]);
+            }
+        }
+
+        // the constants of a region of int64 nodes, see Integer().
+        void CollectIntegers(const Operator * node) {
+            const OperatorList& children = node->Children();
+            if (node->Type() == Operator::OP_ADD && children[0]->Type() == Operator::OP_NEGATIVE) {
+                IntegerConstant(0);
+            }
+            for (std::size_t i = 0; i < children.size(); ++i) {
+                const Operator * operand = TypeInference::Operand(node, i);
+                long long value = 0;
+                if (types_.Interior(operand)) {
+                    CollectIntegers(operand);
+                } else if (TypeInference::Constant(operand, &value)) {
+                    IntegerConstant(value);
+                } else {
+                    CollectConstants(operand);
+                }
+            }
+        }
+
+        int IntegerConstant(long long value) {
+            double bits;
+            memcpy(&bits, &value, sizeof(bits));
+            int reg = Constant(bits);
+            code_->integers_[reg - code_->constant_base_] = true;
+            return reg;
+        }
+
+        int Constant(double value) {
+            unsigned long long bits;
+            memcpy(&bits, &value, sizeof(bits));
+            std::map<unsigned long long, int>::iterator it = constants_.find(bits);
+            if (it != constants_.end()) {
+                return it->second;
+            }
+
+            int reg = code_->constant_base_ + code_->constants_.size();
+            code_->constants_.push_back(value);
+            code_->integers_.push_back(false);
+            constants_.insert(std::make_pair(bits, reg));
+            return reg;
+        }
+
+        int NewTemp() {
+            int reg = code_->temp_base_ + temp_top_++;
+            max_temp_ = std::max(max_temp_, temp_top_);
+            return reg;
+        }
+
+        bool IsTemp(int reg) const {
+            return reg >= (int)code_->temp_base_;
+        }
+
+        std::size_t Emit(int op, int a, int b = 0, int c = 0) {
+            Instruction i = { op, a, b, c };
+            code_->code_.push_back(i);
+            return code_->code_.size() - 1;
+        }
+
+        // point the jump at 'pc' to the next instruction.
+        void Patch(std::size_t pc) {
+            code_->code_[pc].a = code_->code_.size();
+            last_target_ = code_->code_.size();
+        }
+
+        // compile 'node', put its value in 'dst' if dst >= 0, return the
+        // register holding the value.
+        //
+        // 'dst' is never a variable slot, so a node may write it before
+        // all of its operands are read.
+        int Compile(const Operator * node, int dst) {
+            if (types_.OnIntegers(node)) {
+                return CompileInteger(node, dst);
+            }
+            const OperatorList& children = node->Children();
+            switch (node->Type()) {
+            case Operator::OP_MODULE:
+                return CompileModule(static_cast<const Module *>(node), dst);
+            case Operator::OP_NUM:
+                return Move(dst, Constant(static_cast<const Num *>(node)->Value()));
+            case Operator::OP_VARIABLE:
+                return Move(dst, static_cast<const Variable *>(node)->Slot());
+            case Operator::OP_EXTERNAL:
+                {
+                    const External * external = static_cast<const External *>(node);
+                    Emit(Bytecode::OP_RESOLVE, external->Slot(), external->ResolvedSlot(), external->Index());
+                    return Move(dst, external->Slot());
+                }
+            case Operator::OP_REFERENCE:
+                return Move(dst, CompileReference(static_cast<const Reference *>(node)));
+            case Operator::OP_ADD:
+                return CompileAdd(children, dst);
+            case Operator::OP_NEGATIVE:
+                return Unary(Bytecode::OP_NEG, children[0], dst);
+            case Operator::OP_NOT:
+                return Unary(Bytecode::OP_NOT, children[0], dst);
+            case Operator::OP_IF:
+                return CompileIf(children, dst);
+            case Operator::OP_AND:
+                return CompileLogical(children, dst, Bytecode::OP_JZ, 0);
+            case Operator::OP_OR:
+                return CompileLogical(children, dst, Bytecode::OP_JNZ, 1);
+            case Operator::OP_LESS:
+                return Binary(Bytecode::OP_LT, children, dst);
+            case Operator::OP_LESS_EQUAL:
+                return Binary(Bytecode::OP_LE, children, dst);
+            case Operator::OP_GREATER:
+                return Binary(Bytecode::OP_GT, children, dst);
+            case Operator::OP_GREATER_EQUAL:
+                return Binary(Bytecode::OP_GE, children, dst);
+            case Operator::OP_EQUAL:
+                return Binary(Bytecode::OP_EQ, children, dst);
+            case Operator::OP_NOT_EQUAL:
+                return Binary(Bytecode::OP_NE, children, dst);
+            case Operator::OP_MUL:
+                return Binary(Bytecode::OP_MUL, children, dst);
+            case Operator::OP_MOD:
+                return Binary(Bytecode::OP_MOD, children, dst);
+            case Operator::OP_DIV:
+                return CompileDiv(static_cast<const Div *>(node), dst);
+            case Operator::OP_LOGISTIC:
+            case Operator::OP_ENSEMBLE:
+                {
+                    for (std::size_t i = 0; i < children.size(); ++i) {
+                        Compile(children[i], -1); // the externs it reads
+                    }
+                    int out = dst >= 0 ? dst : NewTemp();
+                    Emit(Bytecode::OP_MODEL, out, static_cast<int>(code_->models_.size()));
+                    code_->models_.push_back(static_cast<const ModelOperator *>(node));
+                    return out;
+                }
+            case Operator::OP_CALL:
+                return CompileCall(static_cast<const Call *>(node), dst);
+            default:
+                std::cerr << "bytecode: unknown operator " << node->Type() << std::endl;
+                return Move(dst, Constant(Constants::DEFAULT_RETURN_VALUE));
+            }
+        }
+
+        // 'node' is the top of a region of int64 nodes, its value is
+        // converted to double, a comparison gives double itself.
+        int CompileInteger(const Operator * node, int dst) {
+            int mark = temp_top_;
+            if (IsComparison(node)) {
+                int op = Bytecode::OP_ILT;
+                switch (node->Type()) {
+                case Operator::OP_LESS: op = Bytecode::OP_ILT; break;
+                case Operator::OP_LESS_EQUAL: op = Bytecode::OP_ILE; break;
+                case Operator::OP_GREATER: op = Bytecode::OP_IGT; break;
+                case Operator::OP_GREATER_EQUAL: op = Bytecode::OP_IGE; break;
+                case Operator::OP_EQUAL: op = Bytecode::OP_IEQ; break;
+                default: op = Bytecode::OP_INE; break;
+                }
+                int lhs = Integer(TypeInference::Operand(node, 0));
+                int rhs = Integer(TypeInference::Operand(node, 1));
+                temp_top_ = mark;
+                int out = dst >= 0 ? dst : NewTemp();
+                Emit(op, out, lhs, rhs);
+                return out;
+            }
+
+            int value = Integer(node);
+            temp_top_ = mark;
+            int out = dst >= 0 ? dst : NewTemp();
+            Emit(Bytecode::OP_ITOD, out, value);
+            return out;
+        }
+
+        // the register of the int64 value of 'node', of a region or its
+        // operand.
+        int Integer(const Operator * node) {
+            long long number = 0;
+            if (TypeInference::Constant(node, &number)) {
+                return IntegerConstant(number);
+            }
+            if (types_.Interior(node) == false) {
+                int value = Compile(node, -1);
+                int out = NewTemp();
+                Emit(Bytecode::OP_DTOI, out, value);
+                return out;
+            }
+
+            const OperatorList& children = node->Children();
+            int out = NewTemp();
+            int mark = temp_top_;
+            if (node->Type() == Operator::OP_ADD) {
+                int acc = Integer(TypeInference::Operand(node, 0));
+                if (children[0]->Type() == Operator::OP_NEGATIVE) {
+                    Emit(Bytecode::OP_ISUB, out, IntegerConstant(0), acc);
+                    acc = out;
+                }
+                for (std::size_t i = 1; i < children.size(); ++i) {
+                    int op = children[i]->Type() == Operator::OP_NEGATIVE ? Bytecode::OP_ISUB : Bytecode::OP_IADD;
+                    int rhs = Integer(TypeInference::Operand(node, i));
+                    Emit(op, out, acc, rhs);
+                    acc = out;
+                    temp_top_ = mark;
+                }
+                temp_top_ = mark;
+                return acc;
+            }
+
+            int lhs = Integer(children[0]);
+            int rhs = Integer(children[1]);
+            temp_top_ = mark;
+            Emit(node->Type() == Operator::OP_MUL ? Bytecode::OP_IMUL : Bytecode::OP_IMOD, out, lhs, rhs);
+            return out;
+        }
+
+        int Move(int dst, int src) {
+            if (dst >= 0 && dst != src) {
+                Emit(Bytecode::OP_MOV, dst, src);
+                return dst;
+            }
+            return src;
+        }
+
+        int Unary(int op, const Operator * child, int dst) {
+            int mark = temp_top_;
+            int src = Compile(child, -1);
+            temp_top_ = mark;
+            int out = dst >= 0 ? dst : NewTemp();
+            Emit(op, out, src);
+            return out;
+        }
+
+        int Binary(int op, const OperatorList& children, int dst) {
+            int mark = temp_top_;
+            int lhs = Compile(children[0], -1);
+            int rhs = Compile(children[1], -1);
+            temp_top_ = mark;
+            int out = dst >= 0 ? dst : NewTemp();
+            Emit(op, out, lhs, rhs);
+            return out;
+        }
+
+        // a + (-b) is exactly a - b, so negative addends become "sub".
+        int CompileAdd(const OperatorList& children, int dst) {
+            int out = dst >= 0 ? dst : NewTemp();
+            int mark = temp_top_;
+            int acc = Compile(children[0], -1);
+            if (NeverNegativeZero(children[0]) == false) {
+                // the sum starts from +0.0 like Add, -0 becomes +0
+                Emit(Bytecode::OP_ADD, out, Constant(0.0), acc);
+                acc = out;
+            }
+            for (std::size_t i = 1; i < children.size(); ++i) {
+                int op = Bytecode::OP_ADD;
+                const Operator * addend = children[i];
+                if (addend->Type() == Operator::OP_NEGATIVE) {
+                    op = Bytecode::OP_SUB;
+                    addend = addend->Children()[0];
+                }
+                int rhs = Compile(addend, -1);
+                Emit(op, out, acc, rhs);
+                acc = out;
+                temp_top_ = mark;
+            }
+            temp_top_ = mark;
+            return Move(out, acc);
+        }
+
+        int CompileDiv(const Div * node, int dst) {
+            // the divisor is evaluated first, the dividend is skipped if it is 0.
+            int out = dst >= 0 ? dst : NewTemp();
+            int mark = temp_top_;
+            int divisor = Compile(node->Children()[1], -1);
+            std::size_t nonzero = Emit(Bytecode::OP_JNZ, -1, divisor);
+            Emit(Bytecode::OP_DIVZERO, out, Constant(node->DefaultValue()));
+            std::size_t end = Emit(Bytecode::OP_JMP, -1);
+            Patch(nonzero);
+            int dividend = Compile(node->Children()[0], -1);
+            Emit(Bytecode::OP_DIV, out, dividend, divisor);
+            Patch(end);
+            temp_top_ = mark;
+            return out;
+        }
+
+        // the arguments go to consecutive temporaries, in order.
+        int CompileCall(const Call * node, int dst) {
+            const OperatorList& args = node->Children();
+            int mark = temp_top_;
+            int first = code_->temp_base_ + temp_top_;
+            for (std::size_t i = 0; i < args.size(); ++i) {
+                int arg = NewTemp();
+                int top = temp_top_;
+                Move(arg, Compile(args[i], arg));
+                temp_top_ = top;
+            }
+            temp_top_ = mark;
+
+            // the function reads all of its arguments before 'out' is set.
+            int out = dst >= 0 ? dst : NewTemp();
+            Emit(Bytecode::OP_CALL, out, first, static_cast<int>(code_->functions_.size()));
+            code_->functions_.push_back(node->GetFunction());
+            return out;
+        }
+
+        int CompileLogical(const OperatorList& children, int dst, int jump, int decided) {
+            int out = dst >= 0 ? dst : NewTemp();
+            int mark = temp_top_;
+            std::vector<std::size_t> shortcuts;
+            for (std::size_t i = 0; i < children.size(); ++i) {
+                int cond = Compile(children[i], -1);
+                shortcuts.push_back(Emit(jump, -1, cond));
+                temp_top_ = mark;
+            }
+            Emit(Bytecode::OP_LOADI, out, !decided);
+            std::size_t end = Emit(Bytecode::OP_JMP, -1);
+            for (std::size_t i = 0; i < shortcuts.size(); ++i) {
+                Patch(shortcuts[i]);
+            }
+            Emit(Bytecode::OP_LOADI, out, decided);
+            Patch(end);
+            return out;
+        }
+
+        int CompileIf(const OperatorList& children, int dst) {
+            int out = dst >= 0 ? dst : NewTemp();
+            int mark = temp_top_;
+            std::vector<std::size_t> ends;
+            std::size_t i = 0;
+            for (i = 0; i + 1 < children.size(); i += 2) {
+                int cond = Compile(children[i], -1);
+                temp_top_ = mark;
+                std::size_t next = Emit(Bytecode::OP_JZ, -1, cond);
+                Compile(children[i + 1], out);
+                temp_top_ = mark;
+                ends.push_back(Emit(Bytecode::OP_JMP, -1));
+                Patch(next);
+            }
+
+            if (i + 1 == children.size()) {
+                Compile(children[i], out); // the last "else"
+            } else {
+                Emit(Bytecode::OP_LOADI, out, 0);
+            }
+            temp_top_ = mark;
+
+            for (std::size_t j = 0; j < ends.size(); ++j) {
+                Patch(ends[j]);
+            }
+            return out;
+        }
+
+        int CompileModule(const Module * module, int dst) {
+            int out = dst >= 0 ? dst : NewTemp();
+            int mark = temp_top_;
+
+            Frame frame;
+            frame.result = out;
+            frames_.push_back(frame);
+
+            const OperatorList& sentences = module->Children();
+            if (sentences.empty()) {
+                Emit(Bytecode::OP_MOV, out, module->DefaultSlot());
+            }
+
+            // only the last sentence gives the module value, unless "return".
+            for (std::size_t i = 0; i < sentences.size(); ++i) {
+                if (i + 1 == sentences.size()) {
+                    Move(out, Compile(sentences[i], out));
+                } else {
+                    Compile(sentences[i], -1);
+                }
+                temp_top_ = mark;
+            }
+
+            std::vector<std::size_t>& exits = frames_.back().exits;
+            for (std::size_t i = 0; i < exits.size(); ++i) {
+                Patch(exits[i]);
+            }
+            frames_.pop_back();
+            return out;
+        }
+
+        int CompileReference(const Reference * ref) {
+            int value = Compile(ref->Children()[0], -1);
+            int slot = ref->Slot();
+
+            if (ref->IsReturn()) {
+                Frame& frame = frames_.back();
+                Emit(Bytecode::OP_MOV, slot, value);
+                Emit(Bytecode::OP_MOV, frame.result, value);
+                frame.exits.push_back(Emit(Bytecode::OP_JMP, -1));
+                return frame.result;
+            }
+
+            switch (ref->AssignType()) {
+            case Reference::ASSIGN:
+                Retarget(value, slot);
+                break;
+            case Reference::ADD_ASSIGN:
+                Emit(Bytecode::OP_ADD, slot, slot, value);
+                break;
+            case Reference::SUB_ASSIGN:
+                Emit(Bytecode::OP_SUB, slot, slot, value);
+                break;
+            case Reference::MUL_ASSIGN:
+                Emit(Bytecode::OP_MUL, slot, slot, value);
+                break;
+            case Reference::DIV_ASSIGN:
+            case Reference::MOD_ASSIGN:
+                {
+                    // "/=" and "%=" take the "default" variable if rhs is 0
+                    std::size_t nonzero = Emit(Bytecode::OP_JNZ, -1, value);
+                    Emit(Bytecode::OP_MOV, slot, ref->DefaultSlot());
+                    std::size_t end = Emit(Bytecode::OP_JMP, -1);
+                    Patch(nonzero);
+                    int op = ref->AssignType() == Reference::DIV_ASSIGN ?
+                        Bytecode::OP_DIV : Bytecode::OP_MOD;
+                    Emit(op, slot, slot, value);
+                    Patch(end);
+                }
+                break;
+            }
+            return slot;
+        }
+
+        // store 'value' into 'slot': if the last instruction computed it
+        // into a temporary, let that instruction write the slot directly.
+        void Retarget(int value, int slot) {
+            std::vector<Instruction>& code = code_->code_;
+            if (IsTemp(value) && code.empty() == false && code.back().a == value) {
+                int op = code.back().op;
+                bool straight = op != Bytecode::OP_JMP && op != Bytecode::OP_JZ &&
+                    op != Bytecode::OP_JNZ && op != Bytecode::OP_LOADI &&
+                    op != Bytecode::OP_DIV && op != Bytecode::OP_DIVZERO;
+                if (straight && LastIsJumpTarget() == false) {
+                    code.back().a = slot;
+                    return;
+                }
+            }
+            Emit(Bytecode::OP_MOV, slot, value);
+        }
+
+        // jumps only go forward, and are patched to the end of the code, so
+        // the last instruction is not straight line code if some jump
+        // lands on it or right after it.
+        bool LastIsJumpTarget() const {
+            return last_target_ + 1 >= code_->code_.size();
+        }
+
+    private:
+        Bytecode * code_;
+        TypeInference types_;
+        int temp_top_;
+        int max_temp_;
+        std::size_t last_target_;
+        std::map<unsigned long long, int> constants_;
+        std::vector<Frame> frames_;
+    };
+
+    // the int64 of the OP_I* instructions, in the bits of a register.
+    static inline long long Int(double reg) {
+        long long value;
+        memcpy(&value, &reg, sizeof(value));
+        return value;
+    }
+
+    static inline double Bits(long long value) {
+        double reg;
+        memcpy(&reg, &value, sizeof(reg));
+        return reg;
+    }
+
+    Bytecode::Bytecode(const Program& program)
+        : program_(program),
+          code_(),
+          constants_(),
+          integers_(),
+          models_(),
+          functions_(),
+          constant_base_(0),
+          temp_base_(0),
+          register_count_(0) {
+        BytecodeCompiler compiler(this);
+        compiler.Compile();
+    }
+
+    double Bytecode::Evaluate(Context& context) const {
+        double * r = context.Registers(register_count_);
+        if (constants_.empty() == false) {
+            memcpy(r + constant_base_, &constants_[0], constants_.size() * sizeof(double));
+        }
+
+        const Instruction * const code = &code_[0];
+        const Instruction * pc = code;
+
+#if defined(__GNUC__)
+        // computed goto, the order must be the same as OP_*
+        static const void * const labels[] = {
+            &&L_MOV, &&L_LOADI, &&L_ADD, &&L_SUB, &&L_MUL, &&L_DIV, &&L_MOD,
+            &&L_NEG, &&L_NOT, &&L_LT, &&L_LE, &&L_GT, &&L_GE, &&L_EQ, &&L_NE,
+            &&L_JMP, &&L_JZ, &&L_JNZ, &&L_DIVZERO, &&L_RET, &&L_MODEL, &&L_CALL,
+            &&L_RESOLVE, &&L_DTOI, &&L_ITOD, &&L_IADD, &&L_ISUB, &&L_IMUL, &&L_IMOD,
+            &&L_ILT, &&L_ILE, &&L_IGT, &&L_IGE, &&L_IEQ, &&L_INE
+        };
+#define TTL_DISPATCH() goto *labels[pc->op]
+#define TTL_CASE(name) L_##name:
+#define TTL_NEXT() ++pc; TTL_DISPATCH()
+#define TTL_JUMP(target) pc = code + (target); TTL_DISPATCH()
+        TTL_DISPATCH();
+#else
+#define TTL_CASE(name) case OP_##name:
+#define TTL_NEXT() ++pc; continue
+#define TTL_JUMP(target) pc = code + (target); continue
+        while (true) {
+            switch (pc->op) {
+#endif
+        TTL_CASE(MOV)     r[pc->a] = r[pc->b]; TTL_NEXT();
+        TTL_CASE(LOADI)   r[pc->a] = pc->b; TTL_NEXT();
+        TTL_CASE(ADD)     r[pc->a] = r[pc->b] + r[pc->c]; TTL_NEXT();
+        TTL_CASE(SUB)     r[pc->a] = r[pc->b] - r[pc->c]; TTL_NEXT();
+        TTL_CASE(MUL)     r[pc->a] = r[pc->b] * r[pc->c]; TTL_NEXT();
+        TTL_CASE(DIV)     r[pc->a] = r[pc->b] / r[pc->c]; TTL_NEXT();
+        TTL_CASE(MOD)     r[pc->a] = mod(r[pc->b], r[pc->c]); TTL_NEXT();
+        TTL_CASE(NEG)     r[pc->a] = - r[pc->b]; TTL_NEXT();
+        TTL_CASE(NOT)     r[pc->a] = !r[pc->b]; TTL_NEXT();
+        TTL_CASE(LT)      r[pc->a] = r[pc->b] < r[pc->c]; TTL_NEXT();
+        TTL_CASE(LE)      r[pc->a] = r[pc->b] <= r[pc->c]; TTL_NEXT();
+        TTL_CASE(GT)      r[pc->a] = r[pc->b] > r[pc->c]; TTL_NEXT();
+        TTL_CASE(GE)      r[pc->a] = r[pc->b] >= r[pc->c]; TTL_NEXT();
+        TTL_CASE(EQ)      r[pc->a] = r[pc->b] == r[pc->c]; TTL_NEXT();
+        TTL_CASE(NE)      r[pc->a] = r[pc->b] != r[pc->c]; TTL_NEXT();
+        TTL_CASE(JMP)     TTL_JUMP(pc->a);
+        TTL_CASE(JZ)      if (r[pc->b] == 0) { TTL_JUMP(pc->a); } TTL_NEXT();
+        TTL_CASE(JNZ)     if (r[pc->b] != 0) { TTL_JUMP(pc->a); } TTL_NEXT();
+        TTL_CASE(DIVZERO)
+            std::cerr << "Divided by zero. Return default value "
+                      << r[pc->b] << "." << std::endl;
+            r[pc->a] = r[pc->b];
+            TTL_NEXT();
+        TTL_CASE(RET)     return r[pc->a];
+        TTL_CASE(MODEL)   r[pc->a] = models_[pc->b]->Score(r); TTL_NEXT();
+        TTL_CASE(CALL)    r[pc->a] = functions_[pc->c]->scalar(r + pc->b); TTL_NEXT();
+        TTL_CASE(RESOLVE) if (r[pc->b] == 0) { context.Resolve(pc->c); } TTL_NEXT();
+        TTL_CASE(DTOI)    r[pc->a] = Bits((long long)r[pc->b]); TTL_NEXT();
+        TTL_CASE(ITOD)    r[pc->a] = (double)Int(r[pc->b]); TTL_NEXT();
+        TTL_CASE(IADD)    r[pc->a] = Bits(Int(r[pc->b]) + Int(r[pc->c])); TTL_NEXT();
+        TTL_CASE(ISUB)    r[pc->a] = Bits(Int(r[pc->b]) - Int(r[pc->c])); TTL_NEXT();
+        TTL_CASE(IMUL)    r[pc->a] = Bits(Int(r[pc->b]) * Int(r[pc->c])); TTL_NEXT();
+        TTL_CASE(IMOD)    r[pc->a] = Bits(Int(r[pc->b]) % Int(r[pc->c])); TTL_NEXT();
+        TTL_CASE(ILT)     r[pc->a] = Int(r[pc->b]) < Int(r[pc->c]); TTL_NEXT();
+        TTL_CASE(ILE)     r[pc->a] = Int(r[pc->b]) <= Int(r[pc->c]); TTL_NEXT();
+        TTL_CASE(IGT)     r[pc->a] = Int(r[pc->b]) > Int(r[pc->c]); TTL_NEXT();
+        TTL_CASE(IGE)     r[pc->a] = Int(r[pc->b]) >= Int(r[pc->c]); TTL_NEXT();
+        TTL_CASE(IEQ)     r[pc->a] = Int(r[pc->b]) == Int(r[pc->c]); TTL_NEXT();
+        TTL_CASE(INE)     r[pc->a] = Int(r[pc->b]) != Int(r[pc->c]); TTL_NEXT();
+#if !defined(__GNUC__)
+            }
+        }
+#endif
+#undef TTL_DISPATCH
+#undef TTL_CASE
+#undef TTL_NEXT
+#undef TTL_JUMP
+    }
+
+    void Bytecode::Dump(std::ostream& os) const {
+        static const char * const names[] = {
+            "mov", "loadi", "add", "sub", "mul", "div", "mod", "neg", "not",
+            "lt", "le", "gt", "ge", "eq", "ne", "jmp", "jz", "jnz", "divzero", "ret", "model", "call", "resolve",
+            "dtoi", "itod", "iadd", "isub", "imul", "imod", "ilt", "ile", "igt", "ige", "ieq", "ine"
+        };
+        static const int operands[] = {
+            2, 1, 3, 3, 3, 3, 3, 2, 2, 3, 3, 3, 3, 3, 3, 1, 2, 2, 2, 1, 1, 1, 2,
+            2, 2, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3
+        };
+
+        os << "; " << code_.size() << " instructions, "
+           << program_.SlotCount() << " slots, "
+           << constants_.size() << " constants, "
+           << register_count_ - temp_base_ << " temporaries" << std::endl;
+
+        for (std::size_t pc = 0; pc < code_.size(); ++pc) {
+            const Instruction& i = code_[pc];
+            os << pc << "\t" << names[i.op];
+            int regs[] = { i.a, i.b, i.c };
+            int first = 0;
+            if (i.op == OP_JMP || i.op == OP_JZ || i.op == OP_JNZ) {
+                os << "\t@" << i.a;
+                first = 1;
+            } else if (i.op == OP_LOADI) {
+                os << "\tr" << i.a << ", #" << i.b;
+                first = 3;
+            } else if (i.op == OP_MODEL) {
+                os << "\tr" << i.a << ", " << models_[i.b]->Path();
+                first = 3;
+            } else if (i.op == OP_RESOLVE) {
+                os << "\tr" << i.a << ", r" << i.b << ", " << program_.Externs()[i.c].name;
+                first = 3;
+            } else if (i.op == OP_CALL) {
+                const Function * function = functions_[i.c];
+                os << "\tr" << i.a << ", " << function->name << "(";
+                for (int j = 0; j < function->arity; ++j) {
+                    os << (j == 0 ? "r" : ", r") << i.b + j;
+                }
+                os << ")";
+                first = 3;
+            }
+            for (int j = first; j < operands[i.op]; ++j) {
+                os << (j == 0 ? "\t" : ", ");
+                int reg = regs[j];
+                if (reg >= (int)constant_base_ && reg < (int)temp_base_ && integers_[reg - constant_base_]) {
+                    long long value;
+                    memcpy(&value, &constants_[reg - constant_base_], sizeof(value));
+                    os << "#" << value;
+                } else if (reg >= (int)constant_base_ && reg < (int)temp_base_) {
+                    os << constants_[reg - constant_base_];
+                } else {
+                    os << "r" << reg;
+                }
+            }
+            os << std::endl;
+        }
+    }
+
+} // ttl
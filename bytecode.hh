@@ -0,0 +1,122 @@
+/**
+ * bytecode.hh - register based bytecode and its virtual machine
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#ifndef TTL_BYTECODE_H
+#define TTL_BYTECODE_H
+
+#include <ostream>
+#include <vector>
+#include "program.hh"
+
+namespace ttl {
+
+    class ModelOperator;
+    struct Function;
+
+    // 'a' is the destination register (or jump target), 'b' and 'c' are
+    // source registers.
+    struct Instruction {
+        int op;
+        int a;
+        int b;
+        int c;
+    };
+
+    /**
+     * the ast of a program compiled into linear code.
+     *
+     * NOTE:
+     *     0. registers are laid out as [slots | constants | temporaries],
+     *        the slots are the variables of the program, so the machine
+     *        reads and writes variables in place;
+     *     1. "return", "if", "&&" and "||" are compiled into jumps;
+     *     2. the same Context type as the tree walker is used, the result
+     *        is the same as Program::Evaluate;
+     *     3. an extern is read from its slot, after an OP_RESOLVE which
+     *        calls the resolver of the context if it is not resolved yet;
+     *     4. the nodes of TypeInference::OnIntegers() are computed by the
+     *        OP_I* instructions, on the bits of the registers as int64.
+     *        OP_DTOI and OP_ITOD convert at the bounds of the regions, the
+     *        int64 comparisons give 1.0 or 0.0. so do the constants of
+     *        IsInteger(), the slots are always double.
+     */
+    class Bytecode {
+    public:
+        explicit Bytecode(const Program& program);
+
+        double Evaluate(Context& context) const;
+
+        void Dump(std::ostream& os) const;
+
+        std::size_t RegisterCount() const { return register_count_; }
+        const std::vector<Instruction>& Code() const { return code_; }
+        // the registers [ConstantBase(), ConstantBase() + Constants().size())
+        std::size_t ConstantBase() const { return constant_base_; }
+        const std::vector<double>& Constants() const { return constants_; }
+        // true for the constants which are the bits of an int64
+        const std::vector<bool>& IntegerConstants() const { return integers_; }
+        // the nodes of "lr" and "lambdamart", by the operand b of OP_MODEL
+        const std::vector<const ModelOperator *>& Models() const { return models_; }
+        // the native functions, by the operand c of OP_CALL
+        const std::vector<const Function *>& Functions() const { return functions_; }
+
+    public:
+        const static int OP_MOV = 0;      // a = b
+        const static int OP_LOADI = 1;    // a = (double)b
+        const static int OP_ADD = 2;      // a = b + c
+        const static int OP_SUB = 3;      // a = b - c
+        const static int OP_MUL = 4;      // a = b * c
+        const static int OP_DIV = 5;      // a = b / c
+        const static int OP_MOD = 6;      // a = (long long)b % (long long)c
+        const static int OP_NEG = 7;      // a = -b
+        const static int OP_NOT = 8;      // a = !b
+        const static int OP_LT = 9;       // a = b < c
+        const static int OP_LE = 10;      // a = b <= c
+        const static int OP_GT = 11;      // a = b > c
+        const static int OP_GE = 12;      // a = b >= c
+        const static int OP_EQ = 13;      // a = b == c
+        const static int OP_NE = 14;      // a = b != c
+        const static int OP_JMP = 15;     // goto a
+        const static int OP_JZ = 16;      // if (b == 0) goto a
+        const static int OP_JNZ = 17;     // if (b != 0) goto a
+        const static int OP_DIVZERO = 18; // a = b, and warn "divided by zero"
+        const static int OP_RET = 19;     // return a
+        const static int OP_MODEL = 20;   // a = model #b, of the slots
+        const static int OP_CALL = 21;    // a = function #c of b, b + 1, ...
+        const static int OP_RESOLVE = 22; // if (b == 0) resolve extern #c into a
+        const static int OP_DTOI = 23;    // a = (long long)b
+        const static int OP_ITOD = 24;    // a = (double)b
+        const static int OP_IADD = 25;    // a = b + c
+        const static int OP_ISUB = 26;    // a = b - c
+        const static int OP_IMUL = 27;    // a = b * c
+        const static int OP_IMOD = 28;    // a = b % c
+        const static int OP_ILT = 29;     // a = b < c, double
+        const static int OP_ILE = 30;     // a = b <= c, double
+        const static int OP_IGT = 31;     // a = b > c, double
+        const static int OP_IGE = 32;     // a = b >= c, double
+        const static int OP_IEQ = 33;     // a = b == c, double
+        const static int OP_INE = 34;     // a = b != c, double
+
+    private:
+        friend class BytecodeCompiler;
+
+        const Program& program_;
+        std::vector<Instruction> code_;
+        std::vector<double> constants_;
+        std::vector<bool> integers_;
+        std::vector<const ModelOperator *> models_;
+        std::vector<const Function *> functions_;
+        std::size_t constant_base_;
+        std::size_t temp_base_;
+        std::size_t register_count_;
+    };
+
+} // ttl
+
+#endif
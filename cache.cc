@@ -0,0 +1,81 @@
+/**
+ * cache.cc - process wide cache of included modules
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#include <sys/stat.h>
+#include "cache.hh"
+
+namespace ttl {
+
+    bool FileStamp::Stat(const std::string& filename) {
+        struct stat buf;
+        if (stat(filename.c_str(), &buf) != 0) {
+            return false;
+        }
+
+        path = filename;
+        mtime = (long long)buf.st_mtim.tv_sec * 1000000000LL + buf.st_mtim.tv_nsec;
+        size = buf.st_size;
+        inode = buf.st_ino;
+        return true;
+    }
+
+    ModuleCache& ModuleCache::Instance() {
+        static ModuleCache cache;
+        return cache;
+    }
+
+    std::string ModuleCache::Key(const std::string& path, const Program& program) {
+        std::string key = path;
+        const std::map<std::string, int>& inputs = program.Inputs();
+        for (std::map<std::string, int>::const_iterator it = inputs.begin(); it != inputs.end(); ++it) {
+            key += '\0';
+            key += it->first;
+        }
+        // the externs are visible in the included file too
+        const std::vector<Extern>& externs = program.Externs();
+        for (std::size_t i = 0; i < externs.size(); ++i) {
+            key += '\1';
+            key += externs[i].name;
+        }
+        return key;
+    }
+
+    std::shared_ptr<const CachedModule> ModuleCache::Find(const std::string& key) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::map<std::string, std::shared_ptr<const CachedModule> >::iterator it = modules_.find(key);
+        if (it == modules_.end()) {
+            ++misses_;
+            return std::shared_ptr<const CachedModule>();
+        }
+
+        const std::vector<FileStamp>& dependencies = it->second->dependencies;
+        for (std::size_t i = 0; i < dependencies.size(); ++i) {
+            FileStamp stamp;
+            if (stamp.Stat(dependencies[i].path) == false || (stamp == dependencies[i]) == false) {
+                modules_.erase(it);
+                ++misses_;
+                return std::shared_ptr<const CachedModule>();
+            }
+        }
+
+        ++hits_;
+        return it->second;
+    }
+
+    void ModuleCache::Insert(const std::string& key, const std::shared_ptr<const CachedModule>& module) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        modules_[key] = module;
+    }
+
+    void ModuleCache::Clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        modules_.clear();
+    }
+
+} // ttl
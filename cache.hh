@@ -0,0 +1,84 @@
+/**
+ * cache.hh - process wide cache of included modules
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#ifndef TTL_CACHE_H
+#define TTL_CACHE_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "program.hh"
+
+namespace ttl {
+
+    // identify the version of a file without reading it.
+    struct FileStamp {
+        std::string path;
+        long long mtime; // nanoseconds
+        long long size;
+        unsigned long long inode;
+
+        // stat 'path', return false if it does not exist.
+        bool Stat(const std::string& path);
+        bool operator==(const FileStamp& other) const {
+            return path == other.path && mtime == other.mtime &&
+                   size == other.size && inode == other.inode;
+        }
+    };
+
+    // the result of parsing an included file once.
+    struct CachedModule {
+        // the root module of 'program' is the included file, its inputs
+        // (and externs) are those of the parser which included it.
+        std::shared_ptr<const Program> program;
+        // the file and everything it includes, directly or not.
+        std::vector<FileStamp> dependencies;
+    };
+
+    /**
+     * included files, parsed once per process and shared by all parsers.
+     *
+     * NOTE:
+     *     0. the key is the path and the names of the inputs and externs,
+     *        as they are resolved while parsing;
+     *     1. an entry is dropped when any file it depends on is changed,
+     *        removed or replaced, it is checked by stat on every Find();
+     *     2. thread safe, an entry found stays valid for its holder even if
+     *        it is replaced meanwhile.
+     */
+    class ModuleCache {
+    public:
+        static ModuleCache& Instance();
+
+        static std::string Key(const std::string& path, const Program& program);
+
+        // return NULL if 'key' is not cached or is out of date.
+        std::shared_ptr<const CachedModule> Find(const std::string& key);
+        void Insert(const std::string& key, const std::shared_ptr<const CachedModule>& module);
+        void Clear();
+
+        std::size_t Hits() const { return hits_; }
+        std::size_t Misses() const { return misses_; }
+
+    private:
+        ModuleCache() : mutex_(), modules_(), hits_(0), misses_(0) {}
+        ModuleCache(const ModuleCache&);
+        ModuleCache& operator=(const ModuleCache&);
+
+        std::mutex mutex_;
+        std::map<std::string, std::shared_ptr<const CachedModule> > modules_;
+        std::size_t hits_;
+        std::size_t misses_;
+    };
+
+} // ttl
+
+#endif
@@ -7,11 +7,13 @@
  * Copyright © 2017, Bao Hexing. All Rights Reserved.
  */
 
+#include <sys/mman.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <string>
 #include <fcntl.h>
+#include "common.hh"
 
 namespace ttl {
     bool FileExists(const std::string& filename) {
@@ -20,31 +22,54 @@ namespace ttl {
         return ret == 0 && (buf.st_mode & S_IFMT) == S_IFREG && (buf.st_mode & S_IRUSR);
     }
 
-    const char * ReadFile(const std::string& filename) {
+    MappedFile::MappedFile() : data_(""), size_(0), mapped_(false) {}
+
+    MappedFile::~MappedFile() {
+        Close();
+    }
+
+    bool MappedFile::Open(const std::string& filename) {
+        Close();
         if (FileExists(filename) == false) {
-            return NULL;
+            return false;
+        }
+
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
         }
 
         struct stat buf;
-        int ret = stat(filename.c_str(), &buf);
+        if (fstat(fd, &buf) != 0) {
+            close(fd);
+            return false;
+        }
 
-        // TODO: use mmap
-        char * buffer = new char[buf.st_size + 1];
-        size_t size = 0;
+        if (buf.st_size == 0) {
+            // mmap refuses empty ranges
+            close(fd);
+            return true;
+        }
 
-        int fd = open(filename.c_str(), O_RDONLY);
-        while (true) {
-            ssize_t bytes = read(fd, buffer + size, buf.st_size - size);
-            if (bytes > 0) {
-                size += bytes;
-            }
-
-            if (bytes == 0) {
-                break;
-            }
+        void * data = mmap(NULL, buf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd); // the mapping holds its own reference to the file
+        if (data == MAP_FAILED) {
+            return false;
         }
-        buffer[buf.st_size] = '\0';
+        madvise(data, buf.st_size, MADV_SEQUENTIAL);
 
-        return buffer;
+        data_ = static_cast<const char *>(data);
+        size_ = buf.st_size;
+        mapped_ = true;
+        return true;
+    }
+
+    void MappedFile::Close() {
+        if (mapped_) {
+            munmap(const_cast<char *>(data_), size_);
+        }
+        data_ = "";
+        size_ = 0;
+        mapped_ = false;
     }
 }
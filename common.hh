@@ -10,11 +10,42 @@
 #ifndef TTL_COMMON_H
 #define TTL_COMMON_H
 
+#include <cmath>
+#include <cstddef>
 #include <string>
 
 namespace ttl {
     bool FileExists(const std::string& filename);
-    const char * ReadFile(const std::string& filename);
+
+    /**
+     * a read only view of a whole file, mapped into memory.
+     *
+     * NOTE:
+     *     0. the content is not copied, nor terminated by '\0', use it with
+     *        Size(); it is valid until the MappedFile is destroyed;
+     *     1. the file should not be truncated while it is mapped, reading a
+     *        page past the new end raises SIGBUS.
+     */
+    class MappedFile {
+    public:
+        MappedFile();
+        ~MappedFile();
+
+        // map 'filename', return false if it is not a readable regular file.
+        bool Open(const std::string& filename);
+        void Close();
+
+        const char * Data() const { return data_; }
+        std::size_t Size() const { return size_; }
+
+    private:
+        MappedFile(const MappedFile&);
+        MappedFile& operator=(const MappedFile&);
+
+        const char * data_;
+        std::size_t size_;
+        bool mapped_; // false for empty files
+    };
 
     class Constants {
     private:
@@ -46,6 +77,11 @@ namespace ttl {
     static inline double mod(double lhs, double rhs) {
         return (long long) lhs % (long long) rhs;
     }
+
+    // of "lr", every engine calls it, so they agree on exp().
+    static inline double sigmoid(double z) {
+        return 1.0 / (1.0 + std::exp(-z));
+    }
 }
 
 #endif
@@ -0,0 +1,343 @@
+/**
+ * cse.cc - common subexpression elimination
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#include <string.h> // for memcpy
+#include "cse.hh"
+
+namespace ttl {
+
+    static unsigned long long Bits(double value) {
+        unsigned long long bits;
+        memcpy(&bits, &value, sizeof(bits));
+        return bits;
+    }
+
+    static std::size_t Combine(std::size_t hash, unsigned long long value) {
+        hash = (hash ^ value) * 0x9e3779b97f4a7c15ULL;
+        return hash ^ (hash >> 32);
+    }
+
+    std::size_t SubexpressionEliminator::Hash(const Value& value) const {
+        std::size_t hash = Combine(value.type, value.bits);
+        hash = Combine(hash, value.version);
+        for (std::size_t i = 0; i < value.count; ++i) {
+            hash = Combine(hash, operands_[value.first + i]);
+        }
+        return hash;
+    }
+
+    bool SubexpressionEliminator::Equal(const Value& x, const Value& y) const {
+        if (x.type != y.type || x.bits != y.bits || x.version != y.version || x.count != y.count) {
+            return false;
+        }
+        const int * operands = operands_.data();
+        return memcmp(operands + x.first, operands + y.first, x.count * sizeof(int)) == 0;
+    }
+
+    SubexpressionEliminator::SubexpressionEliminator(Program * program)
+        : program_(program),
+          values_(),
+          operands_(),
+          stack_(),
+          hashes_(),
+          table_(),
+          interned_(0),
+          versions_(),
+          preorder_(),
+          sizes_(),
+          entries_(),
+          available_(),
+          scopes_(),
+          canonical_(),
+          changes_(0),
+          shared_(0) {}
+
+    void SubexpressionEliminator::Run() {
+        Operator * root = program_->root_;
+        if (root == NULL) {
+            return;
+        }
+
+        versions_.assign(program_->SlotCount(), 0);
+        Number(root);
+        available_.assign(values_.size(), -1);
+        Eliminate(&root, 0, NULL);
+
+        // the numbers are of the subtrees before, some are changed now.
+        // the versions are not needed to share the nodes, they stay 0.
+        values_.clear();
+        operands_.clear();
+        hashes_.clear();
+        table_.clear();
+        interned_ = 0;
+        versions_.assign(program_->SlotCount(), 0);
+        int id;
+        Share(root, &id);
+    }
+
+    int SubexpressionEliminator::Intern(Value value, bool unique) {
+        value.first = operands_.size();
+        operands_.insert(operands_.end(), stack_.end() - value.count, stack_.end());
+        stack_.resize(stack_.size() - value.count);
+
+        int id = static_cast<int>(values_.size());
+        std::size_t hash = unique ? 0 : Hash(value);
+        values_.push_back(value);
+        hashes_.push_back(hash);
+        if (unique) {
+            return id;
+        }
+
+        if (2 * (interned_ + 1) > table_.size()) {
+            // grow to keep it half empty at most
+            std::vector<int> table(table_.empty() ? 1024 : 2 * table_.size(), -1);
+            for (std::size_t i = 0; i < table_.size(); ++i) {
+                if (table_[i] >= 0) {
+                    std::size_t j = hashes_[table_[i]] & (table.size() - 1);
+                    while (table[j] >= 0) {
+                        j = (j + 1) & (table.size() - 1);
+                    }
+                    table[j] = table_[i];
+                }
+            }
+            table_.swap(table);
+        }
+
+        std::size_t mask = table_.size() - 1;
+        for (std::size_t i = hash & mask; ; i = (i + 1) & mask) {
+            int other = table_[i];
+            if (other < 0) {
+                table_[i] = id;
+                ++interned_;
+                return id;
+            }
+            if (hashes_[other] == hash && Equal(values_[other], value)) {
+                values_.pop_back();
+                hashes_.pop_back();
+                operands_.resize(value.first);
+                return other;
+            }
+        }
+    }
+
+    // the value of 'node' but its operands, 'unique' if it equals no node.
+    static void Describe(const Operator * node, const std::vector<unsigned long long>& versions,
+                         int * type, unsigned long long * bits, unsigned long long * version,
+                         bool * pure, bool * unique) {
+        *type = node->Type();
+        *bits = 0;
+        *version = 0;
+        *unique = false;
+        switch (node->Type()) {
+        case Operator::OP_MODULE:
+        case Operator::OP_IF:
+        case Operator::OP_REFERENCE:
+            *pure = false;
+            *unique = true;
+            break;
+        case Operator::OP_LOGISTIC:
+        case Operator::OP_ENSEMBLE:
+            // pure, but the slots it reads are not operands to version
+            *unique = true;
+            break;
+        case Operator::OP_CALL:
+            {
+                const Function * function = static_cast<const Call *>(node)->GetFunction();
+                *bits = reinterpret_cast<unsigned long long>(function);
+                if (function->pure == false) {
+                    *pure = false;
+                    *unique = true;
+                }
+            }
+            break;
+        case Operator::OP_NUM:
+            *bits = Bits(static_cast<const Num *>(node)->Value());
+            break;
+        case Operator::OP_VARIABLE:
+            *bits = static_cast<const Variable *>(node)->Slot();
+            *version = versions[*bits];
+            break;
+        case Operator::OP_EXTERNAL:
+            // never assigned, the same value after the first read
+            *bits = static_cast<const External *>(node)->Slot();
+            break;
+        case Operator::OP_DIV:
+            {
+                // by 0 prints "Divided by zero"
+                *bits = Bits(static_cast<const Div *>(node)->DefaultValue());
+                const Operator * divisor = node->Children()[1];
+                *pure = *pure && divisor->Type() == Operator::OP_NUM &&
+                    static_cast<const Num *>(divisor)->Value() != 0;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    int SubexpressionEliminator::Number(const Operator * node) {
+        std::size_t index = preorder_.size();
+        preorder_.push_back(-1);
+        sizes_.push_back(0);
+
+        const OperatorList& children = node->Children();
+        bool pure = true;
+        for (std::size_t i = 0; i < children.size(); ++i) {
+            int child = Number(children[i]);
+            pure = pure && values_[child].pure;
+            stack_.push_back(child);
+        }
+
+        Value value;
+        bool unique;
+        Describe(node, versions_, &value.type, &value.bits, &value.version, &pure, &unique);
+        value.count = children.size();
+        value.pure = pure;
+        if (node->Type() == Operator::OP_REFERENCE) {
+            // the variables after it read the new value.
+            ++versions_[static_cast<const Reference *>(node)->Slot()];
+        }
+
+        int id = Intern(value, unique);
+        preorder_[index] = id;
+        sizes_[index] = preorder_.size() - index;
+        return id;
+    }
+
+    void SubexpressionEliminator::Enter() {
+        scopes_.push_back(entries_.size());
+    }
+
+    void SubexpressionEliminator::Leave() {
+        // the occurrences of a scope are not evaluated after it, always.
+        std::size_t size = scopes_.back();
+        scopes_.pop_back();
+        while (entries_.size() > size) {
+            available_[entries_.back().id] = entries_.back().previous;
+            entries_.pop_back();
+        }
+    }
+
+    void SubexpressionEliminator::Children(Operator * node, std::size_t first, std::size_t last,
+                                           std::size_t * index, Module * module) {
+        OperatorList& children = node->children_;
+        for (std::size_t i = first; i < last; ++i) {
+            Eliminate(&children[i], *index, module);
+            *index += sizes_[*index];
+        }
+    }
+
+    void SubexpressionEliminator::Eliminate(Operator ** location, std::size_t index, Module * module) {
+        Operator * node = *location;
+        int id = preorder_[index];
+        int type = node->Type();
+        bool candidate = values_[id].pure && type != Operator::OP_NUM && type != Operator::OP_VARIABLE &&
+            type != Operator::OP_EXTERNAL;
+
+        if (candidate && available_[id] >= 0) {
+            Entry& first = entries_[available_[id]];
+            Arena& arena = program_->GetArena();
+            if (first.slot < 0) {
+                first.slot = program_->AllocateSlot(0);
+                Reference * ref = new (arena) Reference(first.module, first.slot);
+                ref->AddChild(arena, *first.location);
+                *first.location = ref;
+            }
+            *location = new (arena) Variable(first.slot);
+            ++changes_;
+            return;
+        }
+
+        std::size_t size = node->Children().size();
+        std::size_t child = index + 1; // the preorder index of the first child
+        switch (type) {
+        case Operator::OP_MODULE:
+            Enter();
+            Children(node, 0, size, &child, static_cast<Module *>(node));
+            Leave();
+            break;
+        case Operator::OP_AND:
+        case Operator::OP_OR:
+            Children(node, 0, 1, &child, module);
+            Enter();
+            Children(node, 1, size, &child, module);
+            Leave();
+            break;
+        case Operator::OP_IF:
+            // a condition is evaluated if the ones before are false, so the
+            // conditions are one scope, every branch is one of its own.
+            Children(node, 0, 1, &child, module);
+            Enter();
+            for (std::size_t i = 1; i < size; ++i) {
+                if (i % 2 == 1 || i + 1 == size) {
+                    Enter();
+                    Children(node, i, i + 1, &child, module);
+                    Leave();
+                } else {
+                    Children(node, i, i + 1, &child, module);
+                }
+            }
+            Leave();
+            break;
+        case Operator::OP_DIV:
+            {
+                // the divisor first, the dividend if it is not 0
+                std::size_t divisor = child + sizes_[child];
+                Children(node, 1, 2, &divisor, module);
+                Enter();
+                Children(node, 0, 1, &child, module);
+                Leave();
+            }
+            break;
+        default:
+            Children(node, 0, size, &child, module);
+        }
+
+        if (candidate) {
+            Entry entry = { id, available_[id], location, module, -1 };
+            available_[id] = static_cast<int>(entries_.size());
+            entries_.push_back(entry);
+        }
+    }
+
+    Operator * SubexpressionEliminator::Share(Operator * node, int * id) {
+        OperatorList& children = node->children_;
+        bool pure = true;
+        for (std::size_t i = 0; i < children.size(); ++i) {
+            int child;
+            children[i] = Share(children[i], &child);
+            pure = pure && values_[child].pure;
+            stack_.push_back(child);
+        }
+
+        // the children are shared already, so equal subtrees have the same.
+        Value value;
+        bool unique;
+        Describe(node, versions_, &value.type, &value.bits, &value.version, &pure, &unique);
+        value.count = children.size();
+        value.pure = pure;
+        *id = Intern(value, unique);
+        if (pure == false) {
+            return node;
+        }
+
+        if (canonical_.size() <= static_cast<std::size_t>(*id)) {
+            canonical_.resize(*id + 1, NULL);
+        }
+        if (canonical_[*id] == NULL) {
+            canonical_[*id] = node;
+            return node;
+        }
+        if (canonical_[*id] != node) {
+            ++shared_;
+        }
+        return canonical_[*id];
+    }
+
+} // ttl
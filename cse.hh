@@ -0,0 +1,125 @@
+/**
+ * cse.hh - common subexpression elimination
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#ifndef TTL_CSE_H
+#define TTL_CSE_H
+
+#include <vector>
+#include "operator.hh"
+#include "program.hh"
+
+namespace ttl {
+
+    /**
+     * compute every repeated pure subexpression once per evaluation, and
+     * share the nodes of equal subtrees, in place.
+     *
+     * NOTE:
+     *     0. the subtrees are hash-consed: two subtrees are equal if they
+     *        have the same operator, number (bit for bit), slot or default
+     *        value, and equal children. for step 2 a variable is also
+     *        numbered by the assignments to its slot before it, so equal
+     *        occurrences read the same values;
+     *     1. a subexpression is pure if it assigns nothing and can not
+     *        print "Divided by zero", i.e. every "/" in it is by a number
+     *        other than 0, and calls pure functions only. "%" is pure: if
+     *        the same "%" traps, it traps the first time;
+     *     2. if an occurrence is always evaluated before another one, and
+     *        no variable it reads is assigned in between, the first one
+     *        becomes "$t = expr" to a new slot and the later ones read $t.
+     *        the operands of "&&" and "||" but the first, the dividend of
+     *        "/" (evaluated if the divisor is not 0), and the branches of
+     *        "if" but the first condition, are evaluated sometimes only;
+     *     3. then the equal subtrees which assign nothing are one node:
+     *        the ast becomes a DAG, the engines walk it like a tree;
+     *     4. run it after Optimizer, the result of every evaluation is the
+     *        same bit for bit, and so are the messages.
+     */
+    class SubexpressionEliminator {
+    public:
+        explicit SubexpressionEliminator(Program * program);
+
+        void Run();
+
+        // the occurrences replaced by a read of a slot.
+        std::size_t Changes() const { return changes_; }
+        // the nodes replaced by an equal node.
+        std::size_t Shared() const { return shared_; }
+
+    private:
+        // the value of a node: equal for equal subtrees, which read the
+        // same versions of their variables.
+        struct Value {
+            int type;
+            unsigned long long bits;    // of the number, slot or default value
+            unsigned long long version; // of the slot, the assignments to it before
+            std::size_t first;          // of the operands, in 'operands_'
+            std::size_t count;
+            bool pure;
+        };
+
+        std::size_t Hash(const Value& value) const;
+        bool Equal(const Value& x, const Value& y) const;
+
+        // the number of 'value', whose operands are the last 'value.count'
+        // numbers of 'stack_'. an impure node (but a "/") is 'unique'.
+        int Intern(Value value, bool unique);
+
+        // number 'node' and its subtree, in preorder, with the versions of
+        // the variables as they are evaluated.
+        int Number(const Operator * node);
+
+        // an occurrence which may be read instead of computed again.
+        struct Entry {
+            int id;
+            int previous;         // the entry of 'id' before, or -1
+            Operator ** location; // in the children of its parent
+            Module * module;
+            int slot;             // -1 until it is read
+        };
+
+        // 'index' is the preorder index of '*location'.
+        void Eliminate(Operator ** location, std::size_t index, Module * module);
+        void Children(Operator * node, std::size_t first, std::size_t last, std::size_t * index, Module * module);
+        void Enter();
+        void Leave();
+
+        // share the equal subtrees of 'node', return it or its equal.
+        Operator * Share(Operator * node, int * id);
+
+    private:
+        SubexpressionEliminator(const SubexpressionEliminator&);
+        SubexpressionEliminator& operator=(const SubexpressionEliminator&);
+
+        Program * program_;
+
+        std::vector<Value> values_;  // by number
+        std::vector<int> operands_;
+        std::vector<int> stack_;
+        std::vector<std::size_t> hashes_; // by number
+        std::vector<int> table_;          // open addressing, -1 is empty
+        std::size_t interned_;            // the numbers in 'table_'
+
+        std::vector<unsigned long long> versions_; // by slot
+        std::vector<int> preorder_;                // the number of every node
+        std::vector<std::size_t> sizes_;           // of every subtree, in preorder
+
+        std::vector<Entry> entries_;      // the occurrences available, in order
+        std::vector<int> available_;      // the last entry, by number
+        std::vector<std::size_t> scopes_; // the size of 'entries_' at Enter()
+
+        std::vector<Operator *> canonical_; // the node of a pure number
+
+        std::size_t changes_;
+        std::size_t shared_;
+    };
+
+} // ttl
+
+#endif
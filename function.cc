@@ -0,0 +1,165 @@
+/**
+ * function.cc - native functions called by scripts
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#include <cmath>
+#include <map>
+#include <mutex>
+#include "function.hh"
+
+namespace ttl {
+
+    const int Function::MAX_ARITY;
+
+    // the same expressions row by row and for columns, so the results are
+    // the same bit for bit; the loops of min, max and clamp vectorize.
+    static inline double Min(double a, double b) { return b < a ? b : a; }
+    static inline double Max(double a, double b) { return a < b ? b : a; }
+
+    static double LogScalar(const double * args) { return std::log(args[0]); }
+    static double ExpScalar(const double * args) { return std::exp(args[0]); }
+    static double MinScalar(const double * args) { return Min(args[0], args[1]); }
+    static double MaxScalar(const double * args) { return Max(args[0], args[1]); }
+    static double ClampScalar(const double * args) { return Min(Max(args[0], args[1]), args[2]); }
+
+    static void LogBatch(double * out, const double * const * args, std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            out[i] = std::log(args[0][i]);
+        }
+    }
+
+    static void ExpBatch(double * out, const double * const * args, std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            out[i] = std::exp(args[0][i]);
+        }
+    }
+
+    static void MinBatch(double * out, const double * const * args, std::size_t n) {
+        const double * a = args[0];
+        const double * b = args[1];
+        for (std::size_t i = 0; i < n; ++i) {
+            out[i] = Min(a[i], b[i]);
+        }
+    }
+
+    static void MaxBatch(double * out, const double * const * args, std::size_t n) {
+        const double * a = args[0];
+        const double * b = args[1];
+        for (std::size_t i = 0; i < n; ++i) {
+            out[i] = Max(a[i], b[i]);
+        }
+    }
+
+    static void ClampBatch(double * out, const double * const * args, std::size_t n) {
+        const double * x = args[0];
+        const double * low = args[1];
+        const double * high = args[2];
+        for (std::size_t i = 0; i < n; ++i) {
+            out[i] = Min(Max(x[i], low[i]), high[i]);
+        }
+    }
+
+    class FunctionTable {
+    public:
+        static FunctionTable& Instance() {
+            static FunctionTable table;
+            return table;
+        }
+
+        bool Add(const Function& function, std::string * error) {
+            if (IsName(function.name) == false) {
+                *error = "bad function name \"" + function.name + "\"";
+                return false;
+            }
+            if (function.arity < 0 || function.arity > Function::MAX_ARITY || function.scalar == NULL) {
+                *error = function.name + ": bad arity or no scalar function";
+                return false;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (functions_.count(function.name) != 0) {
+                *error = function.name + ": function defined already";
+                return false;
+            }
+            functions_[function.name] = new Function(function);
+            return true;
+        }
+
+        const Function * Find(const std::string& name) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::map<std::string, const Function *>::const_iterator it = functions_.find(name);
+            return it == functions_.end() ? NULL : it->second;
+        }
+
+        std::vector<const Function *> All() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::vector<const Function *> functions;
+            for (std::map<std::string, const Function *>::const_iterator it = functions_.begin();
+                 it != functions_.end(); ++it) {
+                functions.push_back(it->second);
+            }
+            return functions;
+        }
+
+    private:
+        FunctionTable() : mutex_(), functions_() {
+            const Function builtins[] = {
+                { "log", 1, true, LogScalar, LogBatch },
+                { "exp", 1, true, ExpScalar, ExpBatch },
+                { "min", 2, true, MinScalar, MinBatch },
+                { "max", 2, true, MaxScalar, MaxBatch },
+                { "clamp", 3, true, ClampScalar, ClampBatch }
+            };
+            for (std::size_t i = 0; i < sizeof(builtins) / sizeof(builtins[0]); ++i) {
+                functions_[builtins[i].name] = new Function(builtins[i]);
+            }
+        }
+
+        FunctionTable(const FunctionTable&);
+        FunctionTable& operator=(const FunctionTable&);
+
+        // letters, digits and '_', not a digit first; no keyword or name
+        // the parser handles itself.
+        static bool IsName(const std::string& name) {
+            static const char * const RESERVED[] = {
+                "if", "else", "return", "default", "extern", "include", "now", "lr", "lambdamart"
+            };
+            if (name.empty() || (name[0] >= '0' && name[0] <= '9')) {
+                return false;
+            }
+            for (std::size_t i = 0; i < name.size(); ++i) {
+                char c = name[i];
+                if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_')) {
+                    return false;
+                }
+            }
+            for (std::size_t i = 0; i < sizeof(RESERVED) / sizeof(RESERVED[0]); ++i) {
+                if (name == RESERVED[i]) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        std::mutex mutex_;
+        std::map<std::string, const Function *> functions_; // never deleted
+    };
+
+    bool RegisterFunction(const Function& function, std::string * error) {
+        return FunctionTable::Instance().Add(function, error);
+    }
+
+    const Function * FindFunction(const std::string& name) {
+        return FunctionTable::Instance().Find(name);
+    }
+
+    std::vector<const Function *> RegisteredFunctions() {
+        return FunctionTable::Instance().All();
+    }
+
+} // ttl
@@ -0,0 +1,63 @@
+/**
+ * function.hh - native functions called by scripts
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#ifndef TTL_FUNCTION_H
+#define TTL_FUNCTION_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace ttl {
+
+    /**
+     * a C++ function which scripts call as "name(a, b, ...)".
+     *
+     * NOTE:
+     *     0. the arguments are evaluated in order, then 'scalar' is called
+     *        with all of them;
+     *     1. a pure function returns the same value for the same arguments,
+     *        bit for bit, and has no side effects: a call of numbers is
+     *        folded by the Optimizer, equal calls are computed once, and
+     *        the Reorderer may move it;
+     *     2. 'batch', which may be NULL, sets out[i] to the value of
+     *        'scalar' for row i of the argument columns. the batch evaluator
+     *        calls it for every row of a block, also the rows no branch
+     *        reaches, so it is used for pure functions only, the others are
+     *        called row by row;
+     *     3. builtins: log(x), exp(x), min(a, b), max(a, b) and
+     *        clamp(x, low, high), as std::log, std::exp, std::min,
+     *        std::max and min(max(x, low), high).
+     */
+    struct Function {
+        const static int MAX_ARITY = 8;
+
+        std::string name;
+        int arity;
+        bool pure;
+        double (*scalar)(const double * args);
+        void (*batch)(double * out, const double * const * args, std::size_t n);
+    };
+
+    // add 'function' for the parsers created after that. return false and
+    // set 'error' if the name is taken, or is not a name, a keyword or a
+    // name of the parser ("include", "now", "lr", "lambdamart"), or the
+    // arity is not in [0, MAX_ARITY].
+    bool RegisterFunction(const Function& function, std::string * error);
+
+    // the function of 'name', NULL if it is not registered. a function is
+    // never removed, the pointer is valid until the process exits.
+    const Function * FindFunction(const std::string& name);
+
+    // all the functions, by name.
+    std::vector<const Function *> RegisteredFunctions();
+
+} // ttl
+
+#endif
@@ -0,0 +1,446 @@
+/**
+ * incremental.cc - re-evaluate only what depends on the inputs changed
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#include <string.h> // for memcpy
+#include <iostream>
+#include "incremental.hh"
+
+namespace ttl {
+
+    IncrementalEvaluator::IncrementalEvaluator(const Program& program)
+        : program_(program),
+          nodes_(),
+          children_(),
+          words_(0),
+          volatile_(0),
+          slots_(),
+          dependents_(),
+          source_slots_(),
+          resolved_slots_(),
+          last_(),
+          known_(),
+          values_(),
+          valid_(),
+          computed_(0),
+          reused_(0) {
+        const std::map<std::string, int>& inputs = program_.Inputs();
+        for (std::map<std::string, int>::const_iterator it = inputs.begin(); it != inputs.end(); ++it) {
+            source_slots_.push_back(it->second);
+            resolved_slots_.push_back(-1);
+        }
+        const std::vector<Extern>& externs = program_.Externs();
+        for (std::size_t i = 0; i < externs.size(); ++i) {
+            source_slots_.push_back(externs[i].slot);
+            resolved_slots_.push_back(externs[i].resolved_slot);
+        }
+        volatile_ = source_slots_.size();
+        words_ = (volatile_ + 1 + 63) / 64;
+        last_.resize(volatile_, 0);
+        known_.resize(volatile_, false);
+        dependents_.resize(volatile_ + 1);
+
+        slots_.resize(program_.SlotCount(), Sources(words_, 0));
+        for (std::size_t k = 0; k < source_slots_.size(); ++k) {
+            slots_[source_slots_[k]] = Source(k);
+        }
+
+        if (program_.Root() == NULL) {
+            return;
+        }
+        Add(program_.Root());
+
+        // the sources of a slot grow with every assignment to it, and the
+        // variables read it, so until nothing grows: a few passes.
+        std::vector<Sources> sources(nodes_.size());
+        bool grown = true;
+        while (grown) {
+            grown = false;
+            Depend(0, Sources(words_, 0), &grown, &sources);
+        }
+
+        for (std::size_t i = 0; i < nodes_.size(); ++i) {
+            if (nodes_[i].kept == false) {
+                continue;
+            }
+            for (std::size_t k = 0; k <= (std::size_t)volatile_; ++k) {
+                if (sources[i][k / 64] & (1ULL << (k % 64))) {
+                    dependents_[k].push_back(i);
+                }
+            }
+        }
+        values_.resize(nodes_.size(), 0);
+        valid_.resize(nodes_.size(), false);
+    }
+
+    int IncrementalEvaluator::Add(const Operator * op) {
+        int index = nodes_.size();
+        Node node;
+        node.op = op;
+        node.type = op->Type();
+        nodes_.push_back(node);
+
+        // the children are numbered after all of them are added, so the
+        // indices of the children of a node are contiguous.
+        const OperatorList& children = op->Children();
+        std::vector<int> indices(children.size());
+        bool pure = true;
+        bool returns = false;
+        for (std::size_t i = 0; i < children.size(); ++i) {
+            indices[i] = Add(children[i]);
+            pure = pure && nodes_[indices[i]].pure;
+            returns = returns || nodes_[indices[i]].returns;
+        }
+
+        switch (node.type) {
+        case Operator::OP_MODULE:
+            pure = false;
+            break;
+        case Operator::OP_REFERENCE:
+            pure = false;
+            returns = returns || static_cast<const Reference *>(op)->IsReturn();
+            break;
+        case Operator::OP_CALL:
+            pure = pure && static_cast<const Call *>(op)->GetFunction()->pure;
+            break;
+        case Operator::OP_DIV:
+            // by 0 prints "Divided by zero"
+            pure = pure && children[1]->Type() == Operator::OP_NUM &&
+                static_cast<const Num *>(children[1])->Value() != 0;
+            break;
+        }
+
+        Node& added = nodes_[index];
+        added.first = children_.size();
+        added.size = indices.size();
+        added.pure = pure;
+        added.kept = pure && node.type != Operator::OP_NUM && node.type != Operator::OP_VARIABLE &&
+            node.type != Operator::OP_EXTERNAL;
+        added.returns = returns;
+        children_.insert(children_.end(), indices.begin(), indices.end());
+        return index;
+    }
+
+    IncrementalEvaluator::Sources IncrementalEvaluator::Source(int source) const {
+        Sources sources(words_, 0);
+        sources[source / 64] |= 1ULL << (source % 64);
+        return sources;
+    }
+
+    void IncrementalEvaluator::Merge(Sources * to, const Sources& from) const {
+        for (std::size_t w = 0; w < words_; ++w) {
+            (*to)[w] |= from[w];
+        }
+    }
+
+    void IncrementalEvaluator::MergeSlot(Sources * to, int slot) const {
+        Merge(to, slots_[slot]);
+    }
+
+    void IncrementalEvaluator::Assign(int slot, const Sources& sources, bool * grown) {
+        Sources& to = slots_[slot];
+        for (std::size_t w = 0; w < words_; ++w) {
+            if ((to[w] | sources[w]) != to[w]) {
+                to[w] |= sources[w];
+                *grown = true;
+            }
+        }
+    }
+
+    IncrementalEvaluator::Sources IncrementalEvaluator::Depend(int index, const Sources& control, bool * grown,
+                                                               std::vector<Sources> * sources) {
+        const Node& node = nodes_[index];
+        const int * child = node.size == 0 ? NULL : &children_[node.first];
+        Sources value(words_, 0);
+        switch (node.type) {
+        case Operator::OP_NUM:
+            break;
+        case Operator::OP_VARIABLE:
+            MergeSlot(&value, static_cast<const Variable *>(node.op)->Slot());
+            break;
+        case Operator::OP_EXTERNAL:
+            MergeSlot(&value, static_cast<const External *>(node.op)->Slot());
+            break;
+        case Operator::OP_REFERENCE:
+            {
+                // a slot is assigned only where the conditions lead.
+                const Reference * ref = static_cast<const Reference *>(node.op);
+                Sources assigned = Depend(child[0], control, grown, sources);
+                Merge(&assigned, control);
+                if (ref->IsReturn()) {
+                    Assign(ref->ReturnedSlot(), control, grown);
+                } else if (ref->AssignType() == Reference::DIV_ASSIGN ||
+                           ref->AssignType() == Reference::MOD_ASSIGN) {
+                    MergeSlot(&assigned, ref->DefaultSlot());
+                }
+                Assign(ref->Slot(), assigned, grown);
+                MergeSlot(&value, ref->Slot());
+            }
+            break;
+        case Operator::OP_MODULE:
+            {
+                // a sentence runs if no sentence before it returned.
+                const Module * module = static_cast<const Module *>(node.op);
+                Sources reached = control;
+                MergeSlot(&value, module->DefaultSlot());
+                for (std::size_t i = 0; i < node.size; ++i) {
+                    Sources sentence = Depend(child[i], reached, grown, sources);
+                    Merge(&value, sentence);
+                    if (nodes_[child[i]].returns) {
+                        Merge(&reached, sentence);
+                    }
+                }
+                MergeSlot(&value, module->ReturnSlot());
+                MergeSlot(&value, module->ReturnedSlot());
+            }
+            break;
+        case Operator::OP_IF:
+        case Operator::OP_AND:
+        case Operator::OP_OR:
+            {
+                // every child runs if the conditions before it decided so;
+                // the branches of "if" decide nothing, but add no harm.
+                Sources reached = control;
+                for (std::size_t i = 0; i < node.size; ++i) {
+                    Sources operand = Depend(child[i], reached, grown, sources);
+                    Merge(&value, operand);
+                    Merge(&reached, operand);
+                }
+            }
+            break;
+        case Operator::OP_DIV:
+            {
+                // the dividend runs if the divisor is not 0.
+                Sources divisor = Depend(child[1], control, grown, sources);
+                Sources reached = control;
+                Merge(&reached, divisor);
+                Merge(&value, divisor);
+                Merge(&value, Depend(child[0], reached, grown, sources));
+            }
+            break;
+        case Operator::OP_LOGISTIC:
+        case Operator::OP_ENSEMBLE:
+            {
+                for (std::size_t i = 0; i < node.size; ++i) {
+                    Merge(&value, Depend(child[i], control, grown, sources));
+                }
+                const int * slots = NULL;
+                std::size_t count = 0;
+                if (node.type == Operator::OP_LOGISTIC) {
+                    const Logistic * lr = static_cast<const Logistic *>(node.op);
+                    slots = lr->Slots();
+                    count = lr->Model()->Size();
+                } else {
+                    const Ensemble * lambdamart = static_cast<const Ensemble *>(node.op);
+                    slots = lambdamart->Slots();
+                    count = lambdamart->Model()->Features().size();
+                }
+                for (std::size_t i = 0; i < count; ++i) {
+                    MergeSlot(&value, slots[i]);
+                }
+            }
+            break;
+        case Operator::OP_CALL:
+            for (std::size_t i = 0; i < node.size; ++i) {
+                Merge(&value, Depend(child[i], control, grown, sources));
+            }
+            if (static_cast<const Call *>(node.op)->GetFunction()->pure == false) {
+                Merge(&value, Source(volatile_));
+            }
+            break;
+        default:
+            for (std::size_t i = 0; i < node.size; ++i) {
+                Merge(&value, Depend(child[i], control, grown, sources));
+            }
+            break;
+        }
+        (*sources)[index] = value;
+        return value;
+    }
+
+    void IncrementalEvaluator::Invalidate() {
+        valid_.assign(valid_.size(), false);
+        known_.assign(known_.size(), false);
+    }
+
+    void IncrementalEvaluator::Invalidate(const Context& context) {
+        for (std::size_t k = 0; k < source_slots_.size(); ++k) {
+            double value = context.Get(source_slots_[k]);
+            unsigned long long bits;
+            memcpy(&bits, &value, sizeof(bits));
+            // an extern not set by the host is resolved again, if read.
+            bool known = resolved_slots_[k] < 0 || context.Resolved(resolved_slots_[k]);
+            if (known == false || known_[k] == false || bits != last_[k]) {
+                const std::vector<int>& dependents = dependents_[k];
+                for (std::size_t i = 0; i < dependents.size(); ++i) {
+                    valid_[dependents[i]] = false;
+                }
+            }
+            last_[k] = bits;
+            known_[k] = known;
+        }
+
+        const std::vector<int>& dependents = dependents_[volatile_];
+        for (std::size_t i = 0; i < dependents.size(); ++i) {
+            valid_[dependents[i]] = false;
+        }
+    }
+
+    double IncrementalEvaluator::Evaluate(Context& context) {
+        computed_ = 0;
+        reused_ = 0;
+        if (nodes_.empty()) {
+            return 0;
+        }
+        Invalidate(context);
+        return Evaluate(0, context);
+    }
+
+    double IncrementalEvaluator::Evaluate(int index, Context& context) {
+        const Node& node = nodes_[index];
+        if (node.kept && valid_[index]) {
+            ++reused_;
+            return values_[index];
+        }
+
+        ++computed_;
+        double value = Run(node, context);
+        if (node.kept) {
+            values_[index] = value;
+            valid_[index] = true;
+        }
+        return value;
+    }
+
+    // following are the semantics of Operator::Evaluate of every node.
+    double IncrementalEvaluator::Run(const Node& node, Context& context) {
+        const int * child = node.size == 0 ? NULL : &children_[node.first];
+        switch (node.type) {
+        case Operator::OP_MODULE:
+            {
+                const Module * module = static_cast<const Module *>(node.op);
+                double value = context.Get(module->DefaultSlot());
+                for (std::size_t i = 0; i < node.size && context.Returned(module->ReturnedSlot()) == false; ++i) {
+                    value = Evaluate(child[i], context);
+                }
+                return context.Returned(module->ReturnedSlot()) ? context.Get(module->ReturnSlot()) : value;
+            }
+        case Operator::OP_NUM:
+            return static_cast<const Num *>(node.op)->Value();
+        case Operator::OP_VARIABLE:
+            return context.Get(static_cast<const Variable *>(node.op)->Slot());
+        case Operator::OP_EXTERNAL:
+            return static_cast<const External *>(node.op)->Evaluate(context);
+        case Operator::OP_REFERENCE:
+            {
+                static double (* const ops[])(double, double) = { assign, add, sub, mul, div, mod };
+                const Reference * ref = static_cast<const Reference *>(node.op);
+                int slot = ref->Slot();
+                if (ref->IsReturn()) {
+                    context.Return(ref->ReturnedSlot(), slot, Evaluate(child[0], context));
+                } else {
+                    bool check_rhs = ref->AssignType() == Reference::DIV_ASSIGN ||
+                                     ref->AssignType() == Reference::MOD_ASSIGN;
+                    double lhs = context.Get(slot);
+                    double rhs = Evaluate(child[0], context);
+                    context.Set(slot, (check_rhs && rhs == 0) ? context.Get(ref->DefaultSlot())
+                                                              : ops[ref->AssignType()](lhs, rhs));
+                }
+                return context.Get(slot);
+            }
+        case Operator::OP_ADD:
+            {
+                double value = 0.0;
+                for (std::size_t i = 0; i < node.size; ++i) {
+                    value += Evaluate(child[i], context);
+                }
+                return value;
+            }
+        case Operator::OP_NEGATIVE:
+            return - Evaluate(child[0], context);
+        case Operator::OP_IF:
+            {
+                std::size_t i = 0;
+                for (i = 0; i + 1 < node.size; i += 2) {
+                    if (Evaluate(child[i], context)) {
+                        return Evaluate(child[i + 1], context);
+                    }
+                }
+                return i + 1 == node.size ? Evaluate(child[i], context) : 0;
+            }
+        case Operator::OP_OR:
+            for (std::size_t i = 0; i < node.size; ++i) {
+                if (Evaluate(child[i], context) != 0) {
+                    return (double)true;
+                }
+            }
+            return (double)false;
+        case Operator::OP_AND:
+            for (std::size_t i = 0; i < node.size; ++i) {
+                if (Evaluate(child[i], context) == 0) {
+                    return (double)false;
+                }
+            }
+            return (double)true;
+        case Operator::OP_LESS:
+        case Operator::OP_LESS_EQUAL:
+        case Operator::OP_GREATER:
+        case Operator::OP_GREATER_EQUAL:
+        case Operator::OP_EQUAL:
+        case Operator::OP_NOT_EQUAL:
+            {
+                double lhs = Evaluate(child[0], context);
+                double rhs = Evaluate(child[1], context);
+                switch (node.type) {
+                case Operator::OP_LESS: return (double)(lhs < rhs);
+                case Operator::OP_LESS_EQUAL: return (double)(lhs <= rhs);
+                case Operator::OP_GREATER: return (double)(lhs > rhs);
+                case Operator::OP_GREATER_EQUAL: return (double)(lhs >= rhs);
+                case Operator::OP_EQUAL: return (double)(lhs == rhs);
+                default: return (double)(lhs != rhs);
+                }
+            }
+        case Operator::OP_DIV:
+            {
+                double divisor = Evaluate(child[1], context);
+                if (divisor == 0) {
+                    double default_value = static_cast<const Div *>(node.op)->DefaultValue();
+                    std::cerr << "Divided by zero. Return default value "
+                              << default_value << "." << std::endl;
+                    return default_value;
+                }
+                return Evaluate(child[0], context) / divisor;
+            }
+        case Operator::OP_MUL:
+            {
+                double lhs = Evaluate(child[0], context);
+                return lhs * Evaluate(child[1], context);
+            }
+        case Operator::OP_MOD:
+            {
+                double lhs = Evaluate(child[0], context);
+                return (long long)lhs % (long long)Evaluate(child[1], context);
+            }
+        case Operator::OP_NOT:
+            return !Evaluate(child[0], context);
+        case Operator::OP_LOGISTIC:
+        case Operator::OP_ENSEMBLE:
+            return static_cast<const ModelOperator *>(node.op)->Evaluate(context);
+        case Operator::OP_CALL:
+            {
+                double args[Function::MAX_ARITY];
+                for (std::size_t i = 0; i < node.size; ++i) {
+                    args[i] = Evaluate(child[i], context);
+                }
+                return static_cast<const Call *>(node.op)->GetFunction()->scalar(args);
+            }
+        }
+        return 0;
+    }
+
+} // ttl
@@ -0,0 +1,115 @@
+/**
+ * incremental.hh - re-evaluate only what depends on the inputs changed
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#ifndef TTL_INCREMENTAL_H
+#define TTL_INCREMENTAL_H
+
+#include <cstddef>
+#include <vector>
+#include "operator.hh"
+#include "program.hh"
+
+namespace ttl {
+
+    /**
+     * evaluate a program like the tree walker, reusing the values of the
+     * nodes whose inputs did not change since the last evaluation.
+     *
+     * NOTE:
+     *     0. a dependency graph is built once: the inputs and externs each
+     *        node may read, directly or through the variables assigned by
+     *        "=" (and "+=", ...), and through the conditions which decide
+     *        whether an assignment or a "return" runs;
+     *     1. Evaluate() compares the inputs of the context with those of
+     *        the last evaluation, the nodes downstream of the changed ones
+     *        are recomputed, the others return the value they had;
+     *     2. only nodes without side effects keep a value: the assignments
+     *        and modules run every time (they store the values reused into
+     *        the fresh context), so do a division which may print "Divided
+     *        by zero". a native function which is not pure, and an extern
+     *        the host did not Set() (it may resolve to another value), are
+     *        changed in every evaluation;
+     *     3. the context is Reset() and the inputs set before every
+     *        Evaluate(), as for the other engines; the result is the same
+     *        as Program::Evaluate;
+     *     4. one evaluator per thread (per document re-scored), like
+     *        Context.
+     */
+    class IncrementalEvaluator {
+    public:
+        explicit IncrementalEvaluator(const Program& program);
+
+        double Evaluate(Context& context);
+
+        // forget the values kept, the next Evaluate() computes every node.
+        void Invalidate();
+
+        // the nodes computed and the nodes reused by the last Evaluate().
+        std::size_t Computed() const { return computed_; }
+        std::size_t Reused() const { return reused_; }
+        std::size_t NodeCount() const { return nodes_.size(); }
+
+    private:
+        IncrementalEvaluator(const IncrementalEvaluator&);
+        IncrementalEvaluator& operator=(const IncrementalEvaluator&);
+
+        // a set of sources: the inputs, the externs, then "volatile".
+        typedef std::vector<unsigned long long> Sources;
+
+        struct Node {
+            const Operator * op;
+            int type;
+            std::size_t first; // of the children in 'children_'
+            std::size_t size;
+            bool pure;         // no side effects in the subtree
+            bool kept;         // pure, and not too cheap to keep
+            bool returns;      // a "return" in the subtree
+        };
+
+        int Add(const Operator * op);
+        // the sources of the value of node 'index', evaluated under the
+        // conditions 'control'; the sources of the slots assigned grow. the
+        // sources of every node are put to 'sources'.
+        Sources Depend(int index, const Sources& control, bool * grown, std::vector<Sources> * sources);
+        void Assign(int slot, const Sources& sources, bool * grown);
+        void Merge(Sources * to, const Sources& from) const;
+        void MergeSlot(Sources * to, int slot) const;
+        Sources Source(int source) const;
+
+        // mark the nodes downstream of the sources changed in 'context'
+        void Invalidate(const Context& context);
+        double Evaluate(int index, Context& context);
+        double Run(const Node& node, Context& context);
+
+    private:
+        const Program& program_;
+        std::vector<Node> nodes_;   // in pre-order, the root first
+        std::vector<int> children_;
+
+        // the dependency graph
+        std::size_t words_;         // of a Sources
+        int volatile_;              // the source changed every time
+        std::vector<Sources> slots_; // the sources of every slot
+        std::vector<std::vector<int> > dependents_; // the kept nodes of every source
+
+        // the sources, and their values in the last evaluation
+        std::vector<int> source_slots_;
+        std::vector<int> resolved_slots_; // of the externs, -1 for an input
+        std::vector<unsigned long long> last_;
+        std::vector<bool> known_;   // 'last_' is the value the host set
+
+        std::vector<double> values_;
+        std::vector<bool> valid_;
+        std::size_t computed_;
+        std::size_t reused_;
+    };
+
+} // ttl
+
+#endif
@@ -7,33 +7,567 @@
  * Copyright © 2017, Bao Hexing. All Rights Reserved.
  */
 
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/time.h>
 #include <iostream>
+#include <memory>
+#include <sstream>
+#include <vector>
 #include <readline/readline.h>
 #include <readline/history.h>
+#include "aot.hh"
+#include "batch.hh"
+#include "bytecode.hh"
+#include "jit.hh"
+#include "common.hh"
+#include "incremental.hh"
+#include "parallel.hh"
 #include "parser.hh"
+#include "profiler.hh"
+#include "registry.hh"
+#include "reorder.hh"
+#include "scorer.hh"
+#include "tokenizer.hh"
 
 using namespace ttl;
 
+static void Usage(const char * name) {
+    std::cerr << "usage: " << name << " [options]" << std::endl
+              << "       " << name << " [options] --aot=FILE.so script" << std::endl
+              << "       " << name << " [options] --load=FILE.so" << std::endl
+              << "       " << name << " [options] --tokenize=FILE" << std::endl
+              << "       " << name << " [options] --batch script [input.tsv]" << std::endl
+              << "       " << name << " [options] --profile script" << std::endl
+              << "       " << name << " [options] --watch script" << std::endl
+              << "  -e, --engine=NAME     tree (default), bytecode, jit, batch, parallel, incremental or compare" << std::endl
+              << "  -r, --repeat=N        evaluate N times (N rows for batch), report the time per evaluation" << std::endl
+              << "  -d, --dump-bytecode   print the bytecode of every sentence" << std::endl
+              << "  -t, --dump-tree       print the ast before and after optimizing" << std::endl
+              << "  -n, --no-optimize     evaluate the ast as parsed" << std::endl
+              << "  -i, --input=NAME      declare an input variable (value 0), may be repeated" << std::endl
+              << "  -a, --aot=FILE.so     compile the script to C++ (FILE.so.cc) and a shared object" << std::endl
+              << "  -l, --load=FILE.so    evaluate a shared object built by --aot" << std::endl
+              << "  -k, --tokenize=FILE   tokenize FILE with every scanner, report the tokens per second" << std::endl
+              << "  -b, --batch           score every record of input.tsv (default stdin), its header names" << std::endl
+              << "                        the inputs; engine jit by default, not parallel, incremental" << std::endl
+              << "                        or compare" << std::endl
+              << "  -j, --jobs=N          threads of --batch and parallel, default the number of cpus" << std::endl
+              << "  -p, --profile         evaluate with the profiler (--repeat times, or every record of" << std::endl
+              << "                        --batch), print the code annotated with the runs and time per line" << std::endl
+              << "  -o, --reorder=TRAIN   --batch: profile the script on the records of TRAIN.tsv first, then" << std::endl
+              << "                        run the cheap and decisive conditions first" << std::endl
+              << "  -w, --watch           reload the script when it or an included file changes, score every" << std::endl
+              << "                        line of stdin (the values of the --input names) with the latest" << std::endl;
+}
+
+static double Now() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+// evaluate 'repeat' times with the engine, return the last result.
+template <typename Engine>
+static double Run(Engine& engine, Context& context, int repeat, const char * name) {
+    double result = 0;
+    double start = Now();
+    for (int i = 0; i < repeat; ++i) {
+        context.Reset();
+        result = engine.Evaluate(context);
+    }
+    if (repeat > 1) {
+        std::cerr << name << ": " << (Now() - start) / repeat * 1e9 << " ns/evaluation" << std::endl;
+    }
+    return result;
+}
+
+// evaluate 'rows' rows with the batch evaluator, return the last row.
+static double RunBatch(const Program& program, int rows) {
+    BatchEvaluator evaluator(program);
+    std::vector<double> results(rows);
+    double start = Now();
+    evaluator.Evaluate(rows, &results[0]);
+    if (rows > 1) {
+        std::cerr << "batch(" << BestKernels().name << "): "
+                  << (Now() - start) / rows * 1e9 << " ns/evaluation" << std::endl;
+    }
+    return results.back();
+}
+
+// evaluate 'rows' rows with the jit on 'jobs' threads, return the last row.
+static double RunParallel(const Program& program, int rows, int jobs) {
+    Scheduler scheduler(jobs);
+    ParallelEvaluator evaluator(program, scheduler);
+    std::vector<double> results(rows);
+    double start = Now();
+    evaluator.Evaluate(rows, &results[0]);
+    if (rows > 1) {
+        std::cerr << "parallel(" << scheduler.Threads() << " threads, " << scheduler.Stolen() << " stolen): "
+                  << (Now() - start) / rows * 1e9 << " ns/evaluation" << std::endl;
+    }
+    return results.back();
+}
+
+// ttlc --aot=FILE.so script
+static int CompileScript(const char * script, const std::string& path,
+                         const std::vector<std::string>& inputs, bool optimize) {
+    Parser p;
+    p.SetOptimize(optimize);
+    for (std::size_t i = 0; i < inputs.size(); ++i) {
+        p.AddInput(inputs[i]);
+    }
+    MappedFile content;
+    if (content.Open(script) == false) {
+        std::cerr << script << ": file not readable" << std::endl;
+        return 1;
+    }
+    if (p.Create(content.Data(), content.Size()) == false) {
+        std::cerr << script << ": " << p.ErrorMsg() << std::endl;
+        std::string msg;
+        p.ErrorContext(msg);
+        std::cerr << msg << std::endl;
+        return 1;
+    }
+
+    std::string error;
+    if (Aot::Compile(*p.GetProgram(), path, &error) == false) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+// ttlc --load=FILE.so
+static int LoadSharedObject(const std::string& path, int repeat) {
+    std::string error;
+    SharedProgram * shared = SharedProgram::Load(path, &error);
+    if (shared == NULL) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+
+    Context context(shared->GetProgram());
+    std::cout << Run(*shared, context, repeat, "aot") << std::endl;
+    delete shared;
+    return 0;
+}
+
+// ttlc --tokenize=FILE
+static int Tokenize(const std::string& path, int repeat) {
+    MappedFile content;
+    if (content.Open(path) == false) {
+        std::cerr << path << ": file not readable" << std::endl;
+        return 1;
+    }
+
+    const char * const names[] = { "scalar", "sse2", "avx2" };
+    for (int i = 0; i < 3; ++i) {
+        const Scanner * scanner = FindScanner(names[i]);
+        if (scanner == NULL) {
+            continue;
+        }
+
+        Tokenizer tokenizer(content.Data(), content.Size());
+        tokenizer.SetScanner(*scanner);
+        Token token;
+        std::size_t tokens = 0;
+        double start = Now();
+        for (int r = 0; r < repeat; ++r) {
+            tokenizer.Reset(content.Data(), content.Size());
+            do {
+                tokenizer.NextToken(token);
+                ++tokens;
+            } while (token.token_type != Tokenizer::TOKEN_EOL);
+        }
+        double seconds = Now() - start;
+        std::cerr << names[i] << ": " << tokens / repeat << " tokens, "
+                  << tokens / seconds << " tokens/s, "
+                  << content.Size() * (double)repeat / seconds / 1e6 << " MB/s" << std::endl;
+    }
+    return 0;
+}
+
+// ttlc --profile script
+static int ProfileScript(const char * script, int repeat, const std::vector<std::string>& inputs, bool optimize) {
+    Parser p;
+    p.SetOptimize(optimize);
+    p.SetTrackPositions(true);
+    for (std::size_t i = 0; i < inputs.size(); ++i) {
+        p.AddInput(inputs[i]);
+    }
+    MappedFile content;
+    if (content.Open(script) == false) {
+        std::cerr << script << ": file not readable" << std::endl;
+        return 1;
+    }
+    if (p.Create(content.Data(), content.Size()) == false) {
+        std::cerr << script << ": " << p.ErrorMsg() << std::endl;
+        std::string msg;
+        p.ErrorContext(msg);
+        std::cerr << msg << std::endl;
+        return 1;
+    }
+
+    Context context(*p.GetProgram());
+    Profiler profiler(*p.GetProgram());
+    std::cout << Run(profiler, context, repeat, "profile") << std::endl;
+    profiler.Report(content.Data(), content.Size(), std::cerr);
+    return 0;
+}
+
+// ttlc --watch script
+static int WatchScript(const char * script, const std::vector<std::string>& inputs) {
+    Registry registry;
+    std::string error;
+    int id = registry.Add(script, script, inputs, &error);
+    if (id < 0) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    registry.SetListener([script](int, std::size_t generation, const std::string& error) {
+        if (error.empty()) {
+            std::cerr << "reload: " << script << " generation " << generation << std::endl;
+        } else {
+            std::cerr << "reload: " << error << ", generation " << generation << " kept" << std::endl;
+        }
+    });
+    if (registry.Start(&error) == false) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+
+    Registry::Reader reader(registry);
+    std::unique_ptr<Context> context;
+    std::size_t generation = 0;
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        reader.Enter();
+        const Registry::Version * version = reader.Get(id);
+        if (version->Generation() != generation) {
+            context.reset(new Context(version->GetProgram()));
+            generation = version->Generation();
+        }
+        context->Reset();
+        std::istringstream values(line);
+        double value;
+        for (std::size_t i = 0; i < inputs.size() && values >> value; ++i) {
+            context->Set(inputs[i], value);
+        }
+        double result = version->Evaluate(*context);
+        reader.Leave();
+        std::cout << generation << "\t" << result << std::endl;
+    }
+    return 0;
+}
+
+// profile 'program' on the records of 'train', and reorder it.
+static bool Reorder(Program * program, RecordReader& train, const std::vector<std::string>& columns,
+                    int jobs, std::string * error) {
+    RecordScorer scorer(*program, "profile", jobs);
+    std::ostream null(NULL);
+    if (scorer.Run(train, columns, null, error) == false) {
+        return false;
+    }
+    Profiler profile(*program);
+    scorer.MergeProfiles(&profile);
+
+    Reorderer reorderer(program, profile);
+    reorderer.Run();
+    std::cerr << "reorder: " << reorderer.Changes() << " changes (" << scorer.Records() << " records)" << std::endl;
+    return true;
+}
+
+// ttlc --batch [--reorder=train.tsv] script [input.tsv]
+static int ScoreRecords(const char * script, const char * input, const std::string& engine,
+                        int jobs, const std::vector<std::string>& inputs, bool optimize,
+                        const std::string& train) {
+    int fd = 0;
+    if (input != NULL && strcmp(input, "-") != 0) {
+        fd = open(input, O_RDONLY);
+        if (fd < 0) {
+            std::cerr << input << ": file not readable" << std::endl;
+            return 1;
+        }
+    } else {
+        input = "stdin";
+    }
+
+    RecordReader reader(fd);
+    std::vector<std::string> columns;
+    if (reader.ReadHeader(&columns) == false) {
+        std::cerr << input << ": no header" << std::endl;
+        return 1;
+    }
+
+    int train_fd = -1;
+    std::vector<std::string> train_columns;
+    if (train.empty() == false) {
+        train_fd = open(train.c_str(), O_RDONLY);
+        if (train_fd < 0) {
+            std::cerr << train << ": file not readable" << std::endl;
+            return 1;
+        }
+    }
+    RecordReader train_reader(train_fd);
+    if (train_fd >= 0 && train_reader.ReadHeader(&train_columns) == false) {
+        std::cerr << train << ": no header" << std::endl;
+        close(train_fd);
+        return 1;
+    }
+
+    // the columns are inputs, so the script can read any of them.
+    Parser p;
+    p.SetOptimize(optimize);
+    p.SetTrackPositions(engine == "profile");
+    for (std::size_t i = 0; i < columns.size(); ++i) {
+        p.AddInput(columns[i]);
+    }
+    for (std::size_t i = 0; i < train_columns.size(); ++i) {
+        p.AddInput(train_columns[i]);
+    }
+    for (std::size_t i = 0; i < inputs.size(); ++i) {
+        p.AddInput(inputs[i]);
+    }
+    MappedFile content;
+    if (content.Open(script) == false) {
+        std::cerr << script << ": file not readable" << std::endl;
+        return 1;
+    }
+    if (p.Create(content.Data(), content.Size()) == false) {
+        std::cerr << script << ": " << p.ErrorMsg() << std::endl;
+        std::string msg;
+        p.ErrorContext(msg);
+        std::cerr << msg << std::endl;
+        return 1;
+    }
+
+    std::unique_ptr<Program> program(p.Release());
+    std::string error;
+    if (train_fd >= 0) {
+        bool ok = Reorder(program.get(), train_reader, train_columns, jobs, &error);
+        close(train_fd);
+        if (ok == false) {
+            std::cerr << train << ": " << error << std::endl;
+            return 1;
+        }
+    }
+
+    RecordScorer scorer(*program, engine, jobs);
+    double start = Now();
+    bool ok = scorer.Run(reader, columns, std::cout, &error);
+    double seconds = Now() - start;
+    std::cerr << "batch(" << engine << ", " << jobs << " threads): " << scorer.Records() << " records, "
+              << scorer.Records() / seconds << " records/s" << std::endl;
+    if (fd != 0) {
+        close(fd);
+    }
+
+    if (engine == "profile") {
+        Profiler profile(*program);
+        scorer.MergeProfiles(&profile);
+        profile.Report(content.Data(), content.Size(), std::cerr);
+    }
+
+    if (ok == false) {
+        std::cerr << input << ": " << error << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
 int main(int argc, char ** argv) {
-    char * line = NULL;
+    std::string engine;
+    int repeat = 1;
+    bool dump = false;
+    bool dump_tree = false;
+    bool optimize = true;
+    std::vector<std::string> inputs;
+    std::string aot;
+    std::string load;
+    std::string tokenize;
+    bool batch = false;
+    bool profile = false;
+    std::string train;
+    bool watch = false;
+    int jobs = std::thread::hardware_concurrency();
+
+    static struct option options[] = {
+        { "engine", required_argument, NULL, 'e' },
+        { "repeat", required_argument, NULL, 'r' },
+        { "dump-bytecode", no_argument, NULL, 'd' },
+        { "dump-tree", no_argument, NULL, 't' },
+        { "no-optimize", no_argument, NULL, 'n' },
+        { "input", required_argument, NULL, 'i' },
+        { "aot", required_argument, NULL, 'a' },
+        { "load", required_argument, NULL, 'l' },
+        { "tokenize", required_argument, NULL, 'k' },
+        { "batch", no_argument, NULL, 'b' },
+        { "jobs", required_argument, NULL, 'j' },
+        { "profile", no_argument, NULL, 'p' },
+        { "reorder", required_argument, NULL, 'o' },
+        { "watch", no_argument, NULL, 'w' },
+        { "help", no_argument, NULL, 'h' },
+        { NULL, 0, NULL, 0 }
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "e:r:dtni:a:l:k:bj:po:wh", options, NULL)) != -1) {
+        switch (c) {
+        case 'e': engine = optarg; break;
+        case 'r': repeat = atoi(optarg); break;
+        case 'd': dump = true; break;
+        case 't': dump_tree = true; break;
+        case 'n': optimize = false; break;
+        case 'i': inputs.push_back(optarg); break;
+        case 'a': aot = optarg; break;
+        case 'l': load = optarg; break;
+        case 'k': tokenize = optarg; break;
+        case 'b': batch = true; break;
+        case 'j': jobs = atoi(optarg); break;
+        case 'p': profile = true; break;
+        case 'o': train = optarg; break;
+        case 'w': watch = true; break;
+        default:
+            Usage(argv[0]);
+            return c == 'h' ? 0 : 1;
+        }
+    }
+
+    if (repeat < 1) {
+        repeat = 1;
+    }
+    if (jobs < 1) {
+        jobs = 1;
+    }
+    if (engine.empty()) {
+        engine = batch ? "jit" : "tree";
+    }
+
+    if (engine != "tree" && engine != "bytecode" && engine != "jit" && engine != "batch" &&
+        engine != "parallel" && engine != "incremental" && engine != "compare") {
+        Usage(argv[0]);
+        return 1;
+    }
 
     Parser::Init();
+
+    if (aot.empty() == false) {
+        if (optind + 1 != argc) {
+            Usage(argv[0]);
+            return 1;
+        }
+        return CompileScript(argv[optind], aot, inputs, optimize);
+    }
+
+    if (load.empty() == false) {
+        return LoadSharedObject(load, repeat);
+    }
+
+    if (tokenize.empty() == false) {
+        return Tokenize(tokenize, repeat);
+    }
+
+    if (watch) {
+        if (optind + 1 != argc) {
+            Usage(argv[0]);
+            return 1;
+        }
+        return WatchScript(argv[optind], inputs);
+    }
+
+    if (train.empty() == false && batch == false) {
+        Usage(argv[0]);
+        return 1;
+    }
+
+    if (batch) {
+        if ((optind + 1 != argc && optind + 2 != argc) || engine == "compare" || engine == "parallel" ||
+            engine == "incremental") {
+            Usage(argv[0]);
+            return 1;
+        }
+        return ScoreRecords(argv[optind], optind + 1 < argc ? argv[optind + 1] : NULL,
+                            profile ? "profile" : engine, jobs, inputs, optimize, train);
+    }
+
+    if (profile && optind < argc) {
+        if (optind + 1 != argc) {
+            Usage(argv[0]);
+            return 1;
+        }
+        return ProfileScript(argv[optind], repeat, inputs, optimize);
+    }
+
+    char * line = NULL;
     while (true) {
         line = readline("> ");
-        if (strcmp(line, "quit") == 0) {
+        if (line == NULL || strcmp(line, "quit") == 0) {
             break;
         }
 
         Parser p;
+        p.SetOptimize(optimize, dump_tree ? &std::cout : NULL);
+        p.SetTrackPositions(profile);
+        for (std::size_t i = 0; i < inputs.size(); ++i) {
+            p.AddInput(inputs[i]);
+        }
         bool ret = p.Create(line);
         if (ret == false) {
             std::cerr << "Error to create ast: " << p.ErrorMsg() << std::endl;
             std::string msg;
             p.ErrorContext(msg);
             std::cerr << msg << std::endl;
+            continue;
+        }
+
+        const Program& program = *p.GetProgram();
+        Context context(program);
+        Bytecode bytecode(program);
+        if (dump) {
+            bytecode.Dump(std::cout);
+        }
+
+        if (profile) {
+            Profiler profiler(program);
+            std::cout << Run(profiler, context, repeat, "profile") << std::endl;
+            profiler.Report(line, strlen(line), std::cerr);
+        } else if (engine == "tree") {
+            std::cout << Run(program, context, repeat, "tree") << std::endl;
+        } else if (engine == "bytecode") {
+            std::cout << Run(bytecode, context, repeat, "bytecode") << std::endl;
+        } else if (engine == "jit") {
+            Jit jit(program);
+            std::cout << Run(jit, context, repeat, jit.Native() ? "jit" : "jit(tree)") << std::endl;
+        } else if (engine == "batch") {
+            std::cout << RunBatch(program, repeat) << std::endl;
+        } else if (engine == "parallel") {
+            std::cout << RunParallel(program, repeat, jobs) << std::endl;
+        } else if (engine == "incremental") {
+            IncrementalEvaluator incremental(program);
+            std::cout << Run(incremental, context, repeat, "incremental") << std::endl;
+            std::cerr << "incremental: " << incremental.Computed() << " of " << incremental.NodeCount()
+                      << " nodes computed by the last evaluation" << std::endl;
         } else {
-            double result = p.Evaluate();
-            std::cout << result << std::endl;
+            Jit jit(program);
+            IncrementalEvaluator incremental(program);
+            double expected = Run(program, context, repeat, "tree");
+            double results[] = {
+                Run(bytecode, context, repeat, "bytecode"),
+                Run(jit, context, repeat, "jit"),
+                RunBatch(program, repeat),
+                RunParallel(program, repeat, jobs),
+                Run(incremental, context, repeat, "incremental")
+            };
+            const char * const names[] = { "bytecode", "jit", "batch", "parallel", "incremental" };
+            std::cout << expected << std::endl;
+            for (int i = 0; i < 5; ++i) {
+                if (results[i] != expected && (results[i] == results[i] || expected == expected)) {
+                    std::cerr << names[i] << " mismatch: " << results[i] << std::endl;
+                }
+            }
         }
     }
     return 0;
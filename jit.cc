@@ -0,0 +1,422 @@
+/**
+ * jit.cc - compile a program to x86-64 machine code
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#include <string.h> // for memcpy
+#include <iostream>
+#include <vector>
+#include "jit.hh"
+#include "operator.hh"
+
+#if defined(__x86_64__) && defined(__linux__)
+#define TTL_JIT 1
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace ttl {
+
+#if defined(TTL_JIT)
+
+    // called by the code of OP_DIVZERO, the same message as Div.
+    static void DivZero(double value) {
+        std::cerr << "Divided by zero. Return default value "
+                  << value << "." << std::endl;
+    }
+
+    // called by the code of OP_MODEL.
+    static double Score(const ModelOperator * node, const double * registers) {
+        return node->Score(registers);
+    }
+
+    // called by the code of OP_RESOLVE, the registers are the values of
+    // the context, it writes the slot in place.
+    static void Resolve(Context * context, int index) {
+        context->Resolve(index);
+    }
+
+    /**
+     * translate bytecode to machine code, instruction by instruction.
+     *
+     * rbx holds the registers of the context, the operands are
+     * [rbx + 8 * register], or [rip + offset] for constants, which are
+     * stored after the code; r12 holds the context. xmm0, xmm1, rax, rcx
+     * and rdx are scratch.
+     */
+    class JitAssembler {
+    public:
+        explicit JitAssembler(const Bytecode& bytecode)
+            : bytecode_(bytecode),
+              constant_base_(bytecode.ConstantBase()),
+              constant_count_(bytecode.Constants().size()) {}
+
+        // return false if an instruction is not supported.
+        bool Assemble() {
+            const std::vector<Instruction>& code = bytecode_.Code();
+
+            Emit(0x53);             // push rbx
+            Emit(0x41, 0x54);       // push r12
+            Emit(0x48, 0x83, 0xec); // sub rsp, 8, aligned to 16 for the calls
+            Emit(0x08);
+            Emit(0x48, 0x89, 0xfb); // mov rbx, rdi
+            Emit(0x49, 0x89, 0xf4); // mov r12, rsi
+
+            for (std::size_t pc = 0; pc < code.size(); ++pc) {
+                offsets_.push_back(bytes_.size());
+                if (Assemble(code[pc]) == false) {
+                    return false;
+                }
+            }
+
+            // resolve the jumps
+            for (std::size_t i = 0; i < jumps_.size(); ++i) {
+                Patch(jumps_[i].first, offsets_[jumps_[i].second]);
+            }
+
+            // append the constants, aligned to 8 bytes
+            while (bytes_.size() % sizeof(double) != 0) {
+                Emit(0xcc); // int3
+            }
+            std::size_t pool = bytes_.size();
+            const std::vector<double>& constants = bytecode_.Constants();
+            if (constants.empty() == false) {
+                bytes_.resize(pool + constants.size() * sizeof(double));
+                memcpy(&bytes_[pool], &constants[0], constants.size() * sizeof(double));
+            }
+            for (std::size_t i = 0; i < literals_.size(); ++i) {
+                Patch(literals_[i].first, pool + literals_[i].second * sizeof(double));
+            }
+            return true;
+        }
+
+        const std::vector<unsigned char>& Bytes() const { return bytes_; }
+
+    private:
+        bool Assemble(const Instruction& i) {
+            switch (i.op) {
+            case Bytecode::OP_MOV:
+                Integer(0x8b, 0, i.b); // mov rax, b
+                Integer(0x89, 0, i.a); // mov a, rax
+                return true;
+            case Bytecode::OP_LOADI:
+                {
+                    double value = i.b;
+                    unsigned long long bits;
+                    memcpy(&bits, &value, sizeof(bits));
+                    Emit(0x48, 0xb8); // mov rax, imm64
+                    Int64(bits);
+                    Integer(0x89, 0, i.a);
+                }
+                return true;
+            case Bytecode::OP_ADD: return Arithmetic(0x58, i);
+            case Bytecode::OP_SUB: return Arithmetic(0x5c, i);
+            case Bytecode::OP_MUL: return Arithmetic(0x59, i);
+            case Bytecode::OP_DIV: return Arithmetic(0x5e, i);
+            case Bytecode::OP_MOD:
+                Sse(0xf2, 0x48, 0x2c, 0, i.b);  // cvttsd2si rax, b
+                Sse(0xf2, 0x48, 0x2c, 1, i.c);  // cvttsd2si rcx, c
+                Emit(0x48, 0x99);               // cqo
+                Emit(0x48, 0xf7, 0xf9);         // idiv rcx
+                Emit(0x66, 0x0f, 0x57, 0xc0);   // xorpd xmm0, xmm0
+                Emit(0xf2, 0x48, 0x0f, 0x2a);   // cvtsi2sd xmm0, rdx
+                Emit(0xc2);
+                Store(i.a);
+                return true;
+            case Bytecode::OP_NEG:
+                Integer(0x8b, 0, i.b);
+                Emit(0x48, 0x0f, 0xba, 0xf8);   // btc rax, 63
+                Emit(63);
+                Integer(0x89, 0, i.a);
+                return true;
+            case Bytecode::OP_NOT:
+                CompareZero(i.b);
+                return Boolean(0x94, 0x9b, 0x20, i.a); // sete, setnp, and
+            // "b < c" is "c > b", and unordered sets CF, so seta and setae
+            // are false for NaN.
+            case Bytecode::OP_LT: Compare(i.c, i.b); return Boolean(0x97, 0, 0, i.a);
+            case Bytecode::OP_LE: Compare(i.c, i.b); return Boolean(0x93, 0, 0, i.a);
+            case Bytecode::OP_GT: Compare(i.b, i.c); return Boolean(0x97, 0, 0, i.a);
+            case Bytecode::OP_GE: Compare(i.b, i.c); return Boolean(0x93, 0, 0, i.a);
+            case Bytecode::OP_EQ: Compare(i.b, i.c); return Boolean(0x94, 0x9b, 0x20, i.a);
+            case Bytecode::OP_NE: Compare(i.b, i.c); return Boolean(0x95, 0x9a, 0x08, i.a);
+            case Bytecode::OP_JMP:
+                Emit(0xe9);
+                Jump(i.a);
+                return true;
+            case Bytecode::OP_JZ:
+                // jump if ZF and not PF, NaN is true
+                CompareZero(i.b);
+                Emit(0x7a, 0x06);       // jp +6
+                Emit(0x0f, 0x84);       // je
+                Jump(i.a);
+                return true;
+            case Bytecode::OP_JNZ:
+                CompareZero(i.b);
+                Emit(0x0f, 0x8a);       // jp
+                Jump(i.a);
+                Emit(0x0f, 0x85);       // jne
+                Jump(i.a);
+                return true;
+            case Bytecode::OP_DIVZERO:
+                Load(0, i.b);
+                Store(i.a);
+                Emit(0x48, 0xb8);       // mov rax, DivZero
+                Int64(reinterpret_cast<unsigned long long>(&DivZero));
+                Emit(0xff, 0xd0);       // call rax
+                return true;
+            case Bytecode::OP_MODEL:
+                Emit(0x48, 0xbf);       // mov rdi, node
+                Int64(reinterpret_cast<unsigned long long>(bytecode_.Models()[i.b]));
+                Emit(0x48, 0x89, 0xde); // mov rsi, rbx
+                Emit(0x48, 0xb8);       // mov rax, Score
+                Int64(reinterpret_cast<unsigned long long>(&Score));
+                Emit(0xff, 0xd0);       // call rax
+                Store(i.a);
+                return true;
+            case Bytecode::OP_CALL:
+                Emit(0x48, 0x8d, 0xbb); // lea rdi, [rbx + disp32], the arguments
+                Int32(i.b * (int)sizeof(double));
+                Emit(0x48, 0xb8);       // mov rax, scalar
+                Int64(reinterpret_cast<unsigned long long>(bytecode_.Functions()[i.c]->scalar));
+                Emit(0xff, 0xd0);       // call rax
+                Store(i.a);
+                return true;
+            case Bytecode::OP_RESOLVE:
+                Emit(0x48, 0x83, 0xbb); // cmp qword [rbx + disp32], 0, the bits of 0.0
+                Int32(i.b * (int)sizeof(double));
+                Emit(0x00);
+                Emit(0x75, 20);         // jne over the call
+                Emit(0x4c, 0x89, 0xe7); // mov rdi, r12
+                Emit(0xbe);             // mov esi, imm32
+                Int32(i.c);
+                Emit(0x48, 0xb8);       // mov rax, Resolve
+                Int64(reinterpret_cast<unsigned long long>(&Resolve));
+                Emit(0xff, 0xd0);       // call rax
+                return true;
+            case Bytecode::OP_DTOI:
+                Sse(0xf2, 0x48, 0x2c, 0, i.b);  // cvttsd2si rax, b
+                Integer(0x89, 0, i.a);
+                return true;
+            case Bytecode::OP_ITOD:
+                Emit(0x66, 0x0f, 0x57, 0xc0);   // xorpd xmm0, xmm0
+                Sse(0xf2, 0x48, 0x2a, 0, i.b);  // cvtsi2sd xmm0, b
+                Store(i.a);
+                return true;
+            case Bytecode::OP_IADD: return IntegerArithmetic(0x03, i);
+            case Bytecode::OP_ISUB: return IntegerArithmetic(0x2b, i);
+            case Bytecode::OP_IMUL:
+                Integer(0x8b, 0, i.b);
+                Emit(0x48, 0x0f, 0xaf);         // imul rax, c
+                Operand(0, i.c);
+                Integer(0x89, 0, i.a);
+                return true;
+            case Bytecode::OP_IMOD:
+                Integer(0x8b, 0, i.b);
+                Integer(0x8b, 1, i.c);          // mov rcx, c
+                Emit(0x48, 0x99);               // cqo
+                Emit(0x48, 0xf7, 0xf9);         // idiv rcx
+                Integer(0x89, 2, i.a);          // mov a, rdx
+                return true;
+            case Bytecode::OP_ILT: IntegerCompare(i); return Boolean(0x9c, 0, 0, i.a);
+            case Bytecode::OP_ILE: IntegerCompare(i); return Boolean(0x9e, 0, 0, i.a);
+            case Bytecode::OP_IGT: IntegerCompare(i); return Boolean(0x9f, 0, 0, i.a);
+            case Bytecode::OP_IGE: IntegerCompare(i); return Boolean(0x9d, 0, 0, i.a);
+            case Bytecode::OP_IEQ: IntegerCompare(i); return Boolean(0x94, 0, 0, i.a);
+            case Bytecode::OP_INE: IntegerCompare(i); return Boolean(0x95, 0, 0, i.a);
+            case Bytecode::OP_RET:
+                Load(0, i.a);
+                Emit(0x48, 0x83, 0xc4); // add rsp, 8
+                Emit(0x08);
+                Emit(0x41, 0x5c);       // pop r12
+                Emit(0x5b);             // pop rbx
+                Emit(0xc3);             // ret
+                return true;
+            default:
+                return false;
+            }
+        }
+
+        // xmm0 = b op c, a = xmm0
+        bool Arithmetic(int opcode, const Instruction& i) {
+            Load(0, i.b);
+            Sse(0xf2, 0, opcode, 0, i.c);
+            Store(i.a);
+            return true;
+        }
+
+        // rax = b op c, a = rax
+        bool IntegerArithmetic(int opcode, const Instruction& i) {
+            Integer(0x8b, 0, i.b);
+            Integer(opcode, 0, i.c);
+            Integer(0x89, 0, i.a);
+            return true;
+        }
+
+        // cmp b, c on int64
+        void IntegerCompare(const Instruction& i) {
+            Integer(0x8b, 0, i.b);
+            Integer(0x3b, 0, i.c);
+        }
+
+        // ucomisd lhs, rhs
+        void Compare(int lhs, int rhs) {
+            Load(0, lhs);
+            Sse(0x66, 0, 0x2e, 0, rhs);
+        }
+
+        // ucomisd reg, 0
+        void CompareZero(int reg) {
+            Load(0, reg);
+            Emit(0x66, 0x0f, 0x57, 0xc9); // xorpd xmm1, xmm1
+            Emit(0x66, 0x0f, 0x2e, 0xc1); // ucomisd xmm0, xmm1
+        }
+
+        // a = setcc al [combine setcc2 cl] ? 1.0 : 0.0
+        bool Boolean(int setcc, int setcc2, int combine, int a) {
+            Emit(0x0f, setcc, 0xc0);
+            if (setcc2 != 0) {
+                Emit(0x0f, setcc2, 0xc1);
+                Emit(combine, 0xc8);      // and/or al, cl
+            }
+            Emit(0x0f, 0xb6, 0xc0);       // movzx eax, al
+            Emit(0xf2, 0x0f, 0x2a, 0xc0); // cvtsi2sd xmm0, eax
+            Store(a);
+            return true;
+        }
+
+        void Load(int xmm, int reg) {
+            Sse(0xf2, 0, 0x10, xmm, reg); // movsd xmm, reg
+        }
+
+        void Store(int reg) {
+            Sse(0xf2, 0, 0x11, 0, reg);   // movsd reg, xmm0
+        }
+
+        // prefix [rex] 0f opcode modrm: an sse instruction on a register
+        void Sse(int prefix, int rex, int opcode, int r, int reg) {
+            Emit(prefix);
+            if (rex != 0) {
+                Emit(rex);
+            }
+            Emit(0x0f, opcode);
+            Operand(r, reg);
+        }
+
+        // rex.w opcode modrm: mov rax, reg, mov reg, rax, or an int64 op of
+        // rax (rcx, rdx by r) and reg
+        void Integer(int opcode, int r, int reg) {
+            Emit(0x48, opcode);
+            Operand(r, reg);
+        }
+
+        // the modrm byte and displacement of register 'reg', the operand
+        // must be the last part of the instruction.
+        void Operand(int r, int reg) {
+            int index = reg - (int)constant_base_;
+            if (index >= 0 && index < (int)constant_count_) {
+                Emit(0x05 | (r << 3)); // [rip + disp32]
+                literals_.push_back(std::make_pair(bytes_.size(), index));
+                Int32(0);
+            } else {
+                Emit(0x83 | (r << 3)); // [rbx + disp32]
+                Int32(reg * (int)sizeof(double));
+            }
+        }
+
+        void Jump(int target) {
+            jumps_.push_back(std::make_pair(bytes_.size(), target));
+            Int32(0);
+        }
+
+        // the displacement at 'at' is relative to the end of itself
+        void Patch(std::size_t at, std::size_t target) {
+            int disp = (int)target - (int)(at + 4);
+            memcpy(&bytes_[at], &disp, sizeof(disp));
+        }
+
+        void Emit(int b) { bytes_.push_back((unsigned char)b); }
+        void Emit(int b0, int b1) { Emit(b0); Emit(b1); }
+        void Emit(int b0, int b1, int b2) { Emit(b0); Emit(b1); Emit(b2); }
+        void Emit(int b0, int b1, int b2, int b3) { Emit(b0, b1); Emit(b2, b3); }
+
+        void Int32(int value) {
+            for (int i = 0; i < 4; ++i) {
+                Emit((value >> (i * 8)) & 0xff);
+            }
+        }
+
+        void Int64(unsigned long long value) {
+            for (int i = 0; i < 8; ++i) {
+                Emit((int)((value >> (i * 8)) & 0xff));
+            }
+        }
+
+    private:
+        const Bytecode& bytecode_;
+        std::size_t constant_base_;
+        std::size_t constant_count_;
+        std::vector<unsigned char> bytes_;
+        std::vector<std::size_t> offsets_; // of every instruction
+        std::vector<std::pair<std::size_t, int> > jumps_;    // (displacement, pc)
+        std::vector<std::pair<std::size_t, int> > literals_; // (displacement, constant)
+    };
+
+    Jit::Jit(const Program& program)
+        : program_(program),
+          register_count_(0),
+          code_(NULL),
+          code_size_(0),
+          map_size_(0),
+          function_(NULL) {
+        Bytecode bytecode(program);
+        JitAssembler assembler(bytecode);
+        if (assembler.Assemble() == false) {
+            return;
+        }
+
+        const std::vector<unsigned char>& bytes = assembler.Bytes();
+        std::size_t page = sysconf(_SC_PAGESIZE);
+        std::size_t size = (bytes.size() + page - 1) / page * page;
+        void * code = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (code == MAP_FAILED) {
+            return;
+        }
+        memcpy(code, &bytes[0], bytes.size());
+        if (mprotect(code, size, PROT_READ | PROT_EXEC) != 0) {
+            munmap(code, size);
+            return;
+        }
+
+        register_count_ = bytecode.RegisterCount();
+        code_ = code;
+        code_size_ = bytes.size();
+        map_size_ = size;
+        function_ = reinterpret_cast<Function>(code);
+    }
+
+    Jit::~Jit() {
+        if (code_ != NULL) {
+            munmap(code_, map_size_);
+        }
+    }
+
+#else
+
+    Jit::Jit(const Program& program)
+        : program_(program),
+          register_count_(0),
+          code_(NULL),
+          code_size_(0),
+          map_size_(0),
+          function_(NULL) {}
+
+    Jit::~Jit() {}
+
+#endif
+
+} // ttl
@@ -0,0 +1,67 @@
+/**
+ * jit.hh - compile a program to x86-64 machine code
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#ifndef TTL_JIT_H
+#define TTL_JIT_H
+
+#include "bytecode.hh"
+#include "program.hh"
+
+namespace ttl {
+
+    /**
+     * a program compiled to native code at runtime.
+     *
+     * NOTE:
+     *     0. the ast is lowered by the bytecode compiler first, then every
+     *        instruction is translated to SSE2 code, the same registers
+     *        (slots, constants and temporaries in the Context) are used,
+     *        so the result is the same as Bytecode::Evaluate;
+     *     1. constants are embedded in the code, they are not copied to
+     *        the context on every evaluation;
+     *     2. the code lives in its own mmap'd pages, writable while
+     *        compiling and executable after that;
+     *     3. on other cpus, or if the code can not be compiled (mmap fails,
+     *        an instruction is not supported), Evaluate() falls back to the
+     *        tree walker, see Native().
+     */
+    class Jit {
+    public:
+        explicit Jit(const Program& program);
+        ~Jit();
+
+        double Evaluate(Context& context) const {
+            if (function_ == NULL) {
+                return program_.Evaluate(context);
+            }
+            return function_(context.Registers(register_count_), &context);
+        }
+
+        // true if Evaluate() runs native code.
+        bool Native() const { return function_ != NULL; }
+
+        std::size_t CodeSize() const { return code_size_; }
+
+    private:
+        Jit(const Jit&);
+        Jit& operator=(const Jit&);
+
+        typedef double (*Function)(double * registers, Context * context);
+
+        const Program& program_;
+        std::size_t register_count_;
+        void * code_;           // the mmap'd pages
+        std::size_t code_size_; // bytes of code and constants
+        std::size_t map_size_;
+        Function function_;
+    };
+
+} // ttl
+
+#endif
@@ -0,0 +1,333 @@
+/**
+ * kernels.cc - scalar, sse2 and avx2 kernels
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#include "kernels.hh"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TTL_X86 1
+#endif
+
+namespace ttl {
+
+    // following are the scalar kernels, also used for the tails of the
+    // vectorized ones.
+
+#define TTL_SCALAR_BINARY(name, expr)                                   \
+    static void name##_scalar(double * out, const double * a,           \
+                              const double * b, std::size_t n) {        \
+        for (std::size_t i = 0; i < n; ++i) {                           \
+            double x = a[i], y = b[i];                                  \
+            out[i] = (expr);                                            \
+        }                                                               \
+    }
+
+    TTL_SCALAR_BINARY(add, x + y)
+    TTL_SCALAR_BINARY(sub, x - y)
+    TTL_SCALAR_BINARY(mul, x * y)
+    TTL_SCALAR_BINARY(div, x / y)
+    TTL_SCALAR_BINARY(lt, (double)(x < y))
+    TTL_SCALAR_BINARY(le, (double)(x <= y))
+    TTL_SCALAR_BINARY(gt, (double)(x > y))
+    TTL_SCALAR_BINARY(ge, (double)(x >= y))
+    TTL_SCALAR_BINARY(eq, (double)(x == y))
+    TTL_SCALAR_BINARY(ne, (double)(x != y))
+
+    static void neg_scalar(double * out, const double * a, std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            out[i] = - a[i];
+        }
+    }
+
+    static void lnot_scalar(double * out, const double * a, std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            out[i] = !a[i];
+        }
+    }
+
+    static void fill_scalar(double * out, double value, std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            out[i] = value;
+        }
+    }
+
+    static void select_scalar(double * out, const Mask * mask, const double * a, std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            out[i] = mask[i] ? a[i] : out[i];
+        }
+    }
+
+    static void truth_scalar(Mask * out, const Mask * mask, const double * a, std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            out[i] = a[i] != 0 ? mask[i] : 0;
+        }
+    }
+
+    static void falsity_scalar(Mask * out, const Mask * mask, const double * a, std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            out[i] = a[i] == 0 ? mask[i] : 0;
+        }
+    }
+
+    static void boolean_scalar(double * out, const Mask * mask, std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            out[i] = mask[i] ? 1.0 : 0.0;
+        }
+    }
+
+    // the lanes of a dot product, from term 'i' on.
+    static double dot_lanes(double * lanes, const double * values, const int * slots,
+                            const double * weights, std::size_t i, std::size_t n) {
+        for (; i < n; ++i) {
+            lanes[i % DOT_LANES] += weights[i] * values[slots[i]];
+        }
+        return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    }
+
+    static double dot_scalar(const double * values, const int * slots,
+                             const double * weights, std::size_t n) {
+        double lanes[DOT_LANES] = { 0.0, 0.0, 0.0, 0.0 };
+        return dot_lanes(lanes, values, slots, weights, 0, n);
+    }
+
+    static void axpy_scalar(double * out, double w, const double * a, std::size_t n) {
+        for (std::size_t i = 0; i < n; ++i) {
+            out[i] = out[i] + w * a[i];
+        }
+    }
+
+    static const Kernels SCALAR_KERNELS = {
+        "scalar",
+        add_scalar, sub_scalar, mul_scalar, div_scalar,
+        lt_scalar, le_scalar, gt_scalar, ge_scalar, eq_scalar, ne_scalar,
+        neg_scalar, lnot_scalar,
+        fill_scalar, select_scalar, truth_scalar, falsity_scalar, boolean_scalar,
+        dot_scalar, axpy_scalar
+    };
+
+#if defined(TTL_X86)
+
+    // following are the kernels of 'isa' with 'width' lanes, 'v' is the
+    // vector type and 'p' the prefix of the intrinsics.
+    //
+    // the avx2 functions are compiled with the target attribute, so the
+    // whole program does not need -mavx2 and still runs on older cpus.
+
+#define TTL_VECTOR_BINARY(isa, attr, v, p, width, name, vexpr)          \
+    attr static void name##_##isa(double * out, const double * a,       \
+                                  const double * b, std::size_t n) {    \
+        const v one = p##_set1_pd(1.0);                                 \
+        (void)one;                                                      \
+        std::size_t i = 0;                                              \
+        for (; i + width <= n; i += width) {                            \
+            v x = p##_loadu_pd(a + i);                                  \
+            v y = p##_loadu_pd(b + i);                                  \
+            p##_storeu_pd(out + i, (vexpr));                            \
+        }                                                               \
+        name##_scalar(out + i, a + i, b + i, n - i);                    \
+    }
+
+#define TTL_VECTOR_KERNELS(isa, attr, v, p, width, CMP, AND, ANDNOT, OR, XOR) \
+    TTL_VECTOR_BINARY(isa, attr, v, p, width, add, p##_add_pd(x, y))    \
+    TTL_VECTOR_BINARY(isa, attr, v, p, width, sub, p##_sub_pd(x, y))    \
+    TTL_VECTOR_BINARY(isa, attr, v, p, width, mul, p##_mul_pd(x, y))    \
+    TTL_VECTOR_BINARY(isa, attr, v, p, width, div, p##_div_pd(x, y))    \
+    TTL_VECTOR_BINARY(isa, attr, v, p, width, lt, AND(CMP(x, y, LT), one)) \
+    TTL_VECTOR_BINARY(isa, attr, v, p, width, le, AND(CMP(x, y, LE), one)) \
+    TTL_VECTOR_BINARY(isa, attr, v, p, width, gt, AND(CMP(x, y, GT), one)) \
+    TTL_VECTOR_BINARY(isa, attr, v, p, width, ge, AND(CMP(x, y, GE), one)) \
+    TTL_VECTOR_BINARY(isa, attr, v, p, width, eq, AND(CMP(x, y, EQ), one)) \
+    TTL_VECTOR_BINARY(isa, attr, v, p, width, ne, AND(CMP(x, y, NE), one)) \
+                                                                        \
+    attr static void neg_##isa(double * out, const double * a, std::size_t n) { \
+        const v sign = p##_set1_pd(-0.0);                               \
+        std::size_t i = 0;                                              \
+        for (; i + width <= n; i += width) {                            \
+            p##_storeu_pd(out + i, XOR(p##_loadu_pd(a + i), sign));     \
+        }                                                               \
+        neg_scalar(out + i, a + i, n - i);                              \
+    }                                                                   \
+                                                                        \
+    attr static void lnot_##isa(double * out, const double * a, std::size_t n) { \
+        const v zero = p##_setzero_pd();                                \
+        const v one = p##_set1_pd(1.0);                                 \
+        std::size_t i = 0;                                              \
+        for (; i + width <= n; i += width) {                            \
+            v x = p##_loadu_pd(a + i);                                  \
+            p##_storeu_pd(out + i, AND(CMP(x, zero, EQ), one));         \
+        }                                                               \
+        lnot_scalar(out + i, a + i, n - i);                             \
+    }                                                                   \
+                                                                        \
+    attr static void fill_##isa(double * out, double value, std::size_t n) { \
+        const v x = p##_set1_pd(value);                                 \
+        std::size_t i = 0;                                              \
+        for (; i + width <= n; i += width) {                            \
+            p##_storeu_pd(out + i, x);                                  \
+        }                                                               \
+        fill_scalar(out + i, value, n - i);                             \
+    }                                                                   \
+                                                                        \
+    attr static void select_##isa(double * out, const Mask * mask,     \
+                                  const double * a, std::size_t n) {    \
+        std::size_t i = 0;                                              \
+        for (; i + width <= n; i += width) {                            \
+            v m = p##_loadu_pd((const double *)(mask + i));             \
+            v x = p##_loadu_pd(a + i);                                  \
+            v o = p##_loadu_pd(out + i);                                \
+            p##_storeu_pd(out + i, OR(AND(m, x), ANDNOT(m, o)));        \
+        }                                                               \
+        select_scalar(out + i, mask + i, a + i, n - i);                 \
+    }                                                                   \
+                                                                        \
+    attr static void truth_##isa(Mask * out, const Mask * mask,        \
+                                 const double * a, std::size_t n) {     \
+        const v zero = p##_setzero_pd();                                \
+        std::size_t i = 0;                                              \
+        for (; i + width <= n; i += width) {                            \
+            v m = p##_loadu_pd((const double *)(mask + i));             \
+            v x = p##_loadu_pd(a + i);                                  \
+            p##_storeu_pd((double *)(out + i), AND(CMP(x, zero, NE), m)); \
+        }                                                               \
+        truth_scalar(out + i, mask + i, a + i, n - i);                  \
+    }                                                                   \
+                                                                        \
+    attr static void falsity_##isa(Mask * out, const Mask * mask,      \
+                                   const double * a, std::size_t n) {   \
+        const v zero = p##_setzero_pd();                                \
+        std::size_t i = 0;                                              \
+        for (; i + width <= n; i += width) {                            \
+            v m = p##_loadu_pd((const double *)(mask + i));             \
+            v x = p##_loadu_pd(a + i);                                  \
+            p##_storeu_pd((double *)(out + i), AND(CMP(x, zero, EQ), m)); \
+        }                                                               \
+        falsity_scalar(out + i, mask + i, a + i, n - i);                \
+    }                                                                   \
+                                                                        \
+    attr static void boolean_##isa(double * out, const Mask * mask, std::size_t n) { \
+        const v one = p##_set1_pd(1.0);                                 \
+        std::size_t i = 0;                                              \
+        for (; i + width <= n; i += width) {                            \
+            v m = p##_loadu_pd((const double *)(mask + i));             \
+            p##_storeu_pd(out + i, AND(m, one));                        \
+        }                                                               \
+        boolean_scalar(out + i, mask + i, n - i);                       \
+    }                                                                   \
+                                                                        \
+    attr static void axpy_##isa(double * out, double w, const double * a, std::size_t n) { \
+        const v x = p##_set1_pd(w);                                     \
+        std::size_t i = 0;                                              \
+        for (; i + width <= n; i += width) {                            \
+            v o = p##_loadu_pd(out + i);                                \
+            p##_storeu_pd(out + i, p##_add_pd(o, p##_mul_pd(x, p##_loadu_pd(a + i)))); \
+        }                                                               \
+        axpy_scalar(out + i, w, a + i, n - i);                          \
+    }                                                                   \
+                                                                        \
+    static const Kernels isa##_KERNELS = {                              \
+        #isa,                                                           \
+        add_##isa, sub_##isa, mul_##isa, div_##isa,                     \
+        lt_##isa, le_##isa, gt_##isa, ge_##isa, eq_##isa, ne_##isa,     \
+        neg_##isa, lnot_##isa,                                          \
+        fill_##isa, select_##isa, truth_##isa, falsity_##isa, boolean_##isa, \
+        dot_##isa, axpy_##isa                                           \
+    };
+
+    // sse2 has one intrinsic per predicate, the quiet ones: NaN compares
+    // false except for "!=".
+#define TTL_SSE2_CMP(x, y, pred) TTL_SSE2_CMP_##pred(x, y)
+#define TTL_SSE2_CMP_LT(x, y) _mm_cmplt_pd(x, y)
+#define TTL_SSE2_CMP_LE(x, y) _mm_cmple_pd(x, y)
+#define TTL_SSE2_CMP_GT(x, y) _mm_cmpgt_pd(x, y)
+#define TTL_SSE2_CMP_GE(x, y) _mm_cmpge_pd(x, y)
+#define TTL_SSE2_CMP_EQ(x, y) _mm_cmpeq_pd(x, y)
+#define TTL_SSE2_CMP_NE(x, y) _mm_cmpneq_pd(x, y)
+
+#define TTL_AVX2_CMP(x, y, pred) _mm256_cmp_pd(x, y, TTL_AVX2_##pred)
+#define TTL_AVX2_LT _CMP_LT_OQ
+#define TTL_AVX2_LE _CMP_LE_OQ
+#define TTL_AVX2_GT _CMP_GT_OQ
+#define TTL_AVX2_GE _CMP_GE_OQ
+#define TTL_AVX2_EQ _CMP_EQ_OQ
+#define TTL_AVX2_NE _CMP_NEQ_UQ
+
+#define TTL_NO_ATTRIBUTE
+#define TTL_AVX2_ATTRIBUTE __attribute__((target("avx2")))
+
+    // the dot products gather the values by slot, lanes 0 and 1 in one
+    // register and 2 and 3 in the other for sse2, which has no gather.
+    static double dot_sse2(const double * values, const int * slots,
+                           const double * weights, std::size_t n) {
+        __m128d low = _mm_setzero_pd();
+        __m128d high = _mm_setzero_pd();
+        std::size_t i = 0;
+        for (; i + DOT_LANES <= n; i += DOT_LANES) {
+            __m128d x = _mm_set_pd(values[slots[i + 1]], values[slots[i]]);
+            __m128d y = _mm_set_pd(values[slots[i + 3]], values[slots[i + 2]]);
+            low = _mm_add_pd(low, _mm_mul_pd(_mm_loadu_pd(weights + i), x));
+            high = _mm_add_pd(high, _mm_mul_pd(_mm_loadu_pd(weights + i + 2), y));
+        }
+        double lanes[DOT_LANES];
+        _mm_storeu_pd(lanes, low);
+        _mm_storeu_pd(lanes + 2, high);
+        return dot_lanes(lanes, values, slots, weights, i, n);
+    }
+
+    TTL_AVX2_ATTRIBUTE static double dot_avx2(const double * values, const int * slots,
+                                              const double * weights, std::size_t n) {
+        __m256d sum = _mm256_setzero_pd();
+        std::size_t i = 0;
+        for (; i + DOT_LANES <= n; i += DOT_LANES) {
+            __m128i index = _mm_loadu_si128(reinterpret_cast<const __m128i *>(slots + i));
+            __m256d x = _mm256_i32gather_pd(values, index, 8);
+            sum = _mm256_add_pd(sum, _mm256_mul_pd(_mm256_loadu_pd(weights + i), x));
+        }
+        double lanes[DOT_LANES];
+        _mm256_storeu_pd(lanes, sum);
+        return dot_lanes(lanes, values, slots, weights, i, n);
+    }
+
+    TTL_VECTOR_KERNELS(sse2, TTL_NO_ATTRIBUTE, __m128d, _mm, 2, TTL_SSE2_CMP,
+                       _mm_and_pd, _mm_andnot_pd, _mm_or_pd, _mm_xor_pd)
+
+    TTL_VECTOR_KERNELS(avx2, TTL_AVX2_ATTRIBUTE, __m256d, _mm256, 4, TTL_AVX2_CMP,
+                       _mm256_and_pd, _mm256_andnot_pd, _mm256_or_pd, _mm256_xor_pd)
+
+#endif
+
+    const Kernels * FindKernels(const std::string& name) {
+        if (name == "scalar") {
+            return &SCALAR_KERNELS;
+        }
+#if defined(TTL_X86)
+        if (name == "sse2" && __builtin_cpu_supports("sse2")) {
+            return &sse2_KERNELS;
+        }
+        if (name == "avx2" && __builtin_cpu_supports("avx2")) {
+            return &avx2_KERNELS;
+        }
+#endif
+        return NULL;
+    }
+
+    static const Kernels * ChooseKernels() {
+        const char * const names[] = { "avx2", "sse2", "scalar" };
+        const Kernels * kernels = NULL;
+        for (int i = 0; kernels == NULL; ++i) {
+            kernels = FindKernels(names[i]);
+        }
+        return kernels;
+    }
+
+    const Kernels& BestKernels() {
+        static const Kernels * best = ChooseKernels();
+        return *best;
+    }
+
+} // ttl
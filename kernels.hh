@@ -0,0 +1,81 @@
+/**
+ * kernels.hh - vectorized loops over columns of values
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#ifndef TTL_KERNELS_H
+#define TTL_KERNELS_H
+
+#include <cstddef>
+#include <string>
+
+namespace ttl {
+
+    // a lane of a mask is all ones (active) or all zeros.
+    typedef unsigned long long Mask;
+
+    /**
+     * the loops used by the batch evaluator, one table per instruction set.
+     *
+     * NOTE:
+     *     0. every kernel has the same result as the scalar C++ operator,
+     *        including NaN: comparisons with NaN are false except "!=",
+     *        and NaN is "true" as a condition;
+     *     1. 'out' may be the same column as an operand;
+     *     2. "dot" sums in DOT_LANES lanes, the product of term i into lane
+     *        i % DOT_LANES, in the order of the terms; the lanes start
+     *        from +0 and are added as (0 + 1) + (2 + 3). every table (and
+     *        the batch evaluator, with "axpy") sums this way, so the result
+     *        is the same bit for bit.
+     */
+    struct Kernels {
+        const char * name;
+
+        // out = a op b, comparisons give 1.0 or 0.0
+        void (*add)(double * out, const double * a, const double * b, std::size_t n);
+        void (*sub)(double * out, const double * a, const double * b, std::size_t n);
+        void (*mul)(double * out, const double * a, const double * b, std::size_t n);
+        void (*div)(double * out, const double * a, const double * b, std::size_t n);
+        void (*lt)(double * out, const double * a, const double * b, std::size_t n);
+        void (*le)(double * out, const double * a, const double * b, std::size_t n);
+        void (*gt)(double * out, const double * a, const double * b, std::size_t n);
+        void (*ge)(double * out, const double * a, const double * b, std::size_t n);
+        void (*eq)(double * out, const double * a, const double * b, std::size_t n);
+        void (*ne)(double * out, const double * a, const double * b, std::size_t n);
+
+        // out = -a, out = !a
+        void (*neg)(double * out, const double * a, std::size_t n);
+        void (*lnot)(double * out, const double * a, std::size_t n);
+
+        // out = value
+        void (*fill)(double * out, double value, std::size_t n);
+        // out = mask ? a : out
+        void (*select)(double * out, const Mask * mask, const double * a, std::size_t n);
+        // out = mask && a != 0
+        void (*truth)(Mask * out, const Mask * mask, const double * a, std::size_t n);
+        // out = mask && a == 0
+        void (*falsity)(Mask * out, const Mask * mask, const double * a, std::size_t n);
+        // out = mask ? 1.0 : 0.0
+        void (*boolean)(double * out, const Mask * mask, std::size_t n);
+
+        // sum of weights[i] * values[slots[i]]
+        double (*dot)(const double * values, const int * slots, const double * weights, std::size_t n);
+        // out = out + w * a
+        void (*axpy)(double * out, double w, const double * a, std::size_t n);
+    };
+
+    const static std::size_t DOT_LANES = 4;
+
+    // the best kernels supported by this cpu, chosen once at runtime.
+    const Kernels& BestKernels();
+
+    // kernels by name: "scalar", "sse2" or "avx2", NULL if not supported.
+    const Kernels * FindKernels(const std::string& name);
+
+} // ttl
+
+#endif
@@ -0,0 +1,264 @@
+/**
+ * model.cc - models of "lr" and "lambdamart"
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#include <math.h>   // for NAN
+#include <stdlib.h>
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include "common.hh"
+#include "model.hh"
+
+namespace ttl {
+
+    static bool IsSpace(char c) {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    static bool BadLine(const FileStamp& stamp, int line, std::string * error) {
+        std::ostringstream message;
+        message << stamp.path << ":" << line << ": bad model line";
+        *error = message.str();
+        return false;
+    }
+
+    // split the content into lines of words, without the comments.
+    static void Lines(const char * data, std::size_t size,
+                      std::vector<std::pair<int, std::vector<std::string> > > * lines) {
+        const char * end = data + size;
+        int line = 0;
+        for (const char * p = data; p < end; ) {
+            ++line;
+            std::vector<std::string> words;
+            while (p < end && *p != '\n') {
+                if (IsSpace(*p)) {
+                    ++p;
+                    continue;
+                }
+                const char * word = p;
+                while (p < end && *p != '\n' && IsSpace(*p) == false) {
+                    ++p;
+                }
+                words.push_back(std::string(word, p));
+            }
+            ++p;
+            if (words.empty() == false && words[0][0] != '#') {
+                lines->push_back(std::make_pair(line, words));
+            }
+        }
+    }
+
+    static bool Number(const std::string& word, double * value) {
+        char * end = NULL;
+        *value = strtod(word.c_str(), &end);
+        return end != word.c_str() && *end == '\0';
+    }
+
+    static bool Integer(const std::string& word, int * value) {
+        char * end = NULL;
+        long n = strtol(word.c_str(), &end, 10);
+        *value = static_cast<int>(n);
+        return end != word.c_str() && *end == '\0' && n >= 0 && n < (1L << 30);
+    }
+
+    bool LinearModel::Parse(const char * data, std::size_t size, std::string * error) {
+        std::vector<std::pair<int, std::vector<std::string> > > lines;
+        Lines(data, size, &lines);
+        for (std::size_t i = 0; i < lines.size(); ++i) {
+            const std::vector<std::string>& words = lines[i].second;
+            double value;
+            if (words.size() != 2 || Number(words[1], &value) == false) {
+                return BadLine(stamp_, lines[i].first, error);
+            }
+            if (words[0] == "bias") {
+                bias_ += value;
+            } else {
+                features_.push_back(words[0]);
+                weights_.push_back(value);
+            }
+        }
+        return true;
+    }
+
+    bool TreeEnsemble::Parse(const char * data, std::size_t size, std::string * error) {
+        // the nodes of a tree as they are written, by id.
+        struct Raw {
+            int line;
+            int feature; // -1 for a leaf
+            double value; // the threshold, or the leaf
+            int yes;
+            int no;
+        };
+
+        std::vector<std::pair<int, std::vector<std::string> > > lines;
+        Lines(data, size, &lines);
+        std::map<std::string, int> features;
+        std::vector<std::map<int, Raw> > trees;
+        for (std::size_t i = 0; i < lines.size(); ++i) {
+            int line = lines[i].first;
+            const std::vector<std::string>& words = lines[i].second;
+            if (words.size() == 1 && words[0] == "tree") {
+                trees.push_back(std::map<int, Raw>());
+                continue;
+            }
+
+            Raw raw = { line, -1, 0, -1, -1 };
+            int id;
+            if (trees.empty() || Integer(words[0], &id) == false || trees.back().count(id) != 0) {
+                return BadLine(stamp_, line, error);
+            }
+            if (words.size() == 2) {
+                if (Number(words[1], &raw.value) == false) {
+                    return BadLine(stamp_, line, error);
+                }
+            } else if (words.size() == 5) {
+                if (Number(words[2], &raw.value) == false || Integer(words[3], &raw.yes) == false ||
+                    Integer(words[4], &raw.no) == false) {
+                    return BadLine(stamp_, line, error);
+                }
+                std::map<std::string, int>::iterator it = features.find(words[1]);
+                if (it == features.end()) {
+                    it = features.insert(std::make_pair(words[1], (int)features_.size())).first;
+                    features_.push_back(words[1]);
+                }
+                raw.feature = it->second;
+            } else {
+                return BadLine(stamp_, line, error);
+            }
+            trees.back()[id] = raw;
+        }
+
+        // lay every tree out breadth first, a node is reached once only.
+        for (std::size_t t = 0; t < trees.size(); ++t) {
+            const std::map<int, Raw>& tree = trees[t];
+            std::map<int, Raw>::const_iterator root = tree.find(0);
+            if (root == tree.end()) {
+                *error = stamp_.path + ": a tree without node 0";
+                return false;
+            }
+
+            std::vector<int> queue(1, 0);  // ids, in the order of 'nodes_'
+            std::vector<int> levels(1, 0);
+            std::map<int, bool> seen;
+            seen[0] = true;
+            int base = static_cast<int>(nodes_.size());
+            int depth = 0;
+            for (std::size_t i = 0; i < queue.size(); ++i) {
+                const Raw& raw = tree.find(queue[i])->second;
+                int index = base + static_cast<int>(i);
+                Node node;
+                if (raw.feature < 0) {
+                    node.threshold = NAN;
+                    node.feature = 0;
+                    node.left = index - 1;
+                    leaves_.push_back(raw.value);
+                } else {
+                    int children[2] = { raw.yes, raw.no };
+                    for (int k = 0; k < 2; ++k) {
+                        if (tree.count(children[k]) == 0 || seen[children[k]]) {
+                            return BadLine(stamp_, raw.line, error);
+                        }
+                        seen[children[k]] = true;
+                        queue.push_back(children[k]);
+                        levels.push_back(levels[i] + 1);
+                    }
+                    node.threshold = raw.value;
+                    node.feature = raw.feature;
+                    node.left = base + static_cast<int>(queue.size()) - 2;
+                    leaves_.push_back(0.0);
+                    depth = std::max(depth, levels[i] + 1);
+                }
+                nodes_.push_back(node);
+            }
+            roots_.push_back(base);
+            depths_.push_back(depth);
+        }
+        return true;
+    }
+
+    double TreeEnsemble::Evaluate(const double * values, const int * slots) const {
+        const Node * nodes = nodes_.data();
+        double sum = 0.0;
+        for (std::size_t t = 0; t < roots_.size(); ++t) {
+            int index = roots_[t];
+            for (int step = depths_[t]; step > 0; --step) {
+                const Node& node = nodes[index];
+                index = node.left + !(values[slots[node.feature]] < node.threshold);
+            }
+            sum += leaves_[index];
+        }
+        return sum;
+    }
+
+    void TreeEnsemble::Evaluate(const double * const * columns, std::size_t rows, double * out) const {
+        // tree by tree, so the nodes of a tree stay in cache for all the
+        // rows; a step of a tree is taken for CHUNK rows at once, the rows
+        // do not depend on each other and their loads overlap.
+        const std::size_t CHUNK = 64;
+        const Node * nodes = nodes_.data();
+        int indices[CHUNK];
+        for (std::size_t first = 0; first < rows; first += CHUNK) {
+            std::size_t n = std::min(CHUNK, rows - first);
+            double * sum = out + first;
+            std::fill(sum, sum + n, 0.0);
+            for (std::size_t t = 0; t < roots_.size(); ++t) {
+                std::fill(indices, indices + n, roots_[t]);
+                for (int step = depths_[t]; step > 0; --step) {
+                    for (std::size_t i = 0; i < n; ++i) {
+                        const Node& node = nodes[indices[i]];
+                        indices[i] = node.left + !(columns[node.feature][first + i] < node.threshold);
+                    }
+                }
+                for (std::size_t i = 0; i < n; ++i) {
+                    sum[i] += leaves_[indices[i]];
+                }
+            }
+        }
+    }
+
+    template <class T>
+    std::shared_ptr<const T> LoadModel(const std::string& path, std::string * error) {
+        static std::mutex mutex;
+        static std::map<std::string, std::shared_ptr<const T> > models;
+
+        // stat before reading, a change meanwhile is seen by the next Load().
+        FileStamp stamp;
+        if (stamp.Stat(path) == false) {
+            *error = path + ": file not readable";
+            return std::shared_ptr<const T>();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            typename std::map<std::string, std::shared_ptr<const T> >::iterator it = models.find(path);
+            if (it != models.end() && it->second->Stamp() == stamp) {
+                return it->second;
+            }
+        }
+
+        MappedFile content;
+        if (content.Open(path) == false) {
+            *error = path + ": file not readable";
+            return std::shared_ptr<const T>();
+        }
+        std::shared_ptr<T> model(new T());
+        model->stamp_ = stamp;
+        if (model->Parse(content.Data(), content.Size(), error) == false) {
+            return std::shared_ptr<const T>();
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        models[path] = model;
+        return model;
+    }
+
+    template std::shared_ptr<const LinearModel> LoadModel<LinearModel>(const std::string&, std::string *);
+    template std::shared_ptr<const TreeEnsemble> LoadModel<TreeEnsemble>(const std::string&, std::string *);
+
+} // ttl
@@ -0,0 +1,147 @@
+/**
+ * model.hh - models of "lr" and "lambdamart"
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#ifndef TTL_MODEL_H
+#define TTL_MODEL_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include "cache.hh"
+
+namespace ttl {
+
+    // the model of 'path' (LinearModel or TreeEnsemble), read once per
+    // process and shared until the file changes. NULL and 'error' if the
+    // file can not be read or parsed.
+    template <class T>
+    std::shared_ptr<const T> LoadModel(const std::string& path, std::string * error);
+
+    /**
+     * the weights of a logistic regression, read from a text file:
+     *
+     *     # comment
+     *     bias -1.25
+     *     ctr 0.8
+     *     price -0.003
+     *
+     * NOTE:
+     *     0. one "name weight" per line, the names are variables of the
+     *        script ("lr" binds them to slots), "bias" is the intercept;
+     *        a name may be given more than once;
+     *     1. a file is read (mmap'd) once per process, the model is shared
+     *        by every script which loads it, until the file changes;
+     *     2. immutable after Load(), thread safe.
+     */
+    class LinearModel {
+    public:
+        // see LoadModel(), a line which is not "name weight" is an error.
+        static std::shared_ptr<const LinearModel> Load(const std::string& path, std::string * error) {
+            return LoadModel<LinearModel>(path, error);
+        }
+
+        const FileStamp& Stamp() const { return stamp_; }
+        const std::string& Path() const { return stamp_.path; }
+
+        std::size_t Size() const { return weights_.size(); }
+        const std::vector<std::string>& Features() const { return features_; }
+        const double * Weights() const { return weights_.data(); }
+        double Bias() const { return bias_; }
+
+    private:
+        template <class T>
+        friend std::shared_ptr<const T> LoadModel(const std::string& path, std::string * error);
+
+        LinearModel() : stamp_(), features_(), weights_(), bias_(0) {}
+        LinearModel(const LinearModel&);
+        LinearModel& operator=(const LinearModel&);
+
+        bool Parse(const char * data, std::size_t size, std::string * error);
+
+        FileStamp stamp_;
+        std::vector<std::string> features_;
+        std::vector<double> weights_; // of 'features_'
+        double bias_;
+    };
+
+    /**
+     * the trees of a gradient boosted ensemble (lambdamart), the score is
+     * the sum of the leaves reached in every tree, in order:
+     *
+     *     # comment
+     *     tree
+     *     0 ctr 0.5 1 2
+     *     1 -0.1
+     *     2 price 10 3 4
+     *     3 0.3
+     *     4 0.2
+     *
+     * NOTE:
+     *     0. "tree" starts a tree, its nodes follow in any order, the root
+     *        is node 0. "id name threshold yes no" is a split, to node yes
+     *        if variable 'name' < threshold (not for NaN), else to node no;
+     *        "id value" is a leaf;
+     *     1. the nodes of all trees are one array, every tree breadth first,
+     *        and the children of a split next to each other: a step is
+     *        "left + !(x < threshold)", without a branch;
+     *     2. a leaf steps to itself (its threshold is NaN, its left is its
+     *        own index - 1), so every tree is walked a fixed number of
+     *        steps, its depth;
+     *     3. read once per process like LinearModel, immutable, thread safe.
+     */
+    class TreeEnsemble {
+    public:
+        struct Node {
+            double threshold;
+            int feature; // in Features()
+            int left;
+        };
+
+        static std::shared_ptr<const TreeEnsemble> Load(const std::string& path, std::string * error) {
+            return LoadModel<TreeEnsemble>(path, error);
+        }
+
+        const FileStamp& Stamp() const { return stamp_; }
+        const std::string& Path() const { return stamp_.path; }
+
+        const std::vector<std::string>& Features() const { return features_; }
+        std::size_t Trees() const { return roots_.size(); }
+        std::size_t Size() const { return nodes_.size(); }
+        const Node * Nodes() const { return nodes_.data(); }
+        const double * Leaves() const { return leaves_.data(); } // by node
+        const int * Roots() const { return roots_.data(); }
+        const int * Depths() const { return depths_.data(); }
+
+        // the score of one row, feature f is values[slots[f]].
+        double Evaluate(const double * values, const int * slots) const;
+        // the scores of 'rows' rows, feature f is the column columns[f].
+        void Evaluate(const double * const * columns, std::size_t rows, double * out) const;
+
+    private:
+        template <class T>
+        friend std::shared_ptr<const T> LoadModel(const std::string& path, std::string * error);
+
+        TreeEnsemble() : stamp_(), features_(), nodes_(), leaves_(), roots_(), depths_() {}
+        TreeEnsemble(const TreeEnsemble&);
+        TreeEnsemble& operator=(const TreeEnsemble&);
+
+        bool Parse(const char * data, std::size_t size, std::string * error);
+
+        FileStamp stamp_;
+        std::vector<std::string> features_;
+        std::vector<Node> nodes_;
+        std::vector<double> leaves_;
+        std::vector<int> roots_;  // by tree
+        std::vector<int> depths_; // by tree
+    };
+
+} // ttl
+
+#endif
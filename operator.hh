@@ -14,42 +14,130 @@
 #include <map>
 #include <string>
 #include <iostream>
+#include "arena.hh"
 #include "common.hh"
+#include "function.hh"
+#include "kernels.hh"
+#include "model.hh"
+#include "program.hh"
 
 namespace ttl {
 
+    class Operator;
+
+    /**
+     * the children of a node, an array in the arena of the program.
+     *
+     * NOTE: when the array is full it is copied into a twice larger one,
+     *       the old array is left in the arena; most nodes have at most
+     *       two children and never grow.
+     */
+    class OperatorList {
+    public:
+        typedef Operator * const * const_iterator;
+
+        OperatorList() : items_(NULL), size_(0), capacity_(0) {}
+
+        std::size_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+        Operator * operator[](std::size_t i) const { return items_[i]; }
+        Operator *& operator[](std::size_t i) { return items_[i]; }
+        Operator * back() const { return items_[size_ - 1]; }
+        const_iterator begin() const { return items_; }
+        const_iterator end() const { return items_ + size_; }
+
+        void push_back(Arena& arena, Operator * child) {
+            if (size_ == capacity_) {
+                std::size_t capacity = capacity_ == 0 ? 2 : capacity_ * 2;
+                Operator ** items = static_cast<Operator **>(arena.Allocate(capacity * sizeof(Operator *)));
+                for (std::size_t i = 0; i < size_; ++i) {
+                    items[i] = items_[i];
+                }
+                items_ = items;
+                capacity_ = capacity;
+            }
+            items_[size_++] = child;
+        }
+
+        void pop_back() { --size_; }
+
+    private:
+        Operator ** items_;
+        std::size_t size_;
+        std::size_t capacity_;
+    };
+
+    /**
+     * a node of the ast.
+     *
+     * NOTE: nodes are created by "new (arena) T(...)" and are never deleted,
+     *       they are released with the arena of the program.
+     */
     class Operator {
     public:
 
         Operator()  : children_() {}
 
-        virtual ~Operator() {
-            for (int i = 0; i < children_.size(); ++i) {
-                delete children_[i];
-            }
+        void AddChild(Arena& arena, Operator * child) {
+            children_.push_back(arena, child);
         }
 
-        void AddChild(Operator * child) {
-            children_.push_back(child);
+        virtual double Evaluate(Context& context) const = 0;
+
+        // one of OP_*, for the passes which walk the tree.
+        virtual int Type() const = 0;
+
+        const OperatorList& Children() const {
+            return children_;
         }
 
-        virtual double Evaluate() = 0;
+    public:
+        const static int OP_MODULE = 0;
+        const static int OP_NUM = 1;
+        const static int OP_VARIABLE = 2;
+        const static int OP_REFERENCE = 3;
+        const static int OP_ADD = 4;
+        const static int OP_NEGATIVE = 5;
+        const static int OP_IF = 6;
+        const static int OP_OR = 7;
+        const static int OP_AND = 8;
+        const static int OP_LESS = 9;
+        const static int OP_LESS_EQUAL = 10;
+        const static int OP_GREATER = 11;
+        const static int OP_GREATER_EQUAL = 12;
+        const static int OP_EQUAL = 13;
+        const static int OP_NOT_EQUAL = 14;
+        const static int OP_DIV = 15;
+        const static int OP_MUL = 16;
+        const static int OP_MOD = 17;
+        const static int OP_NOT = 18;
+        const static int OP_LOGISTIC = 19;
+        const static int OP_ENSEMBLE = 20;
+        const static int OP_CALL = 21;
+        const static int OP_EXTERNAL = 22;
 
     protected:
-        std::vector<Operator*> children_;
+        friend class Optimizer;
+        friend class Reorderer;
+        friend class SubexpressionEliminator;
+
+        ~Operator() {}
+
+        OperatorList children_;
     };
 
     class Module : public Operator {
     public:
-        Module(double default_value) : Operator(), variables_(), should_return_(false) {
-            variables_.insert(make_pair(std::string("default"), default_value));
-            variables_.insert(make_pair(std::string("return"), default_value));
-
-            default_value_ = &(variables_.find("default")->second);
-            return_value_ = &(variables_.find("return")->second);
-        }
+        // "default", "return" and the "returned" flag take the first slots,
+        // the names of the other variables are only known by the parser.
+        Module(Program * program, double default_value)
+            : Operator(),
+              default_slot_(program->AllocateSlot(default_value)),
+              return_slot_(program->AllocateSlot(default_value)),
+              returned_slot_(program->AllocateSlot(0)),
+              default_value_(default_value) {}
 
-        virtual ~Module() {}
+        virtual int Type() const { return OP_MODULE; }
 
         bool PopLastChild(Operator ** child) {
             if (child == NULL || children_.size() == 0) {
@@ -61,111 +149,145 @@ namespace ttl {
             return true;
         }
 
-        double * GetReturn() const {
-            return return_value_;
+        int ReturnSlot() const {
+            return return_slot_;
         }
 
-        double GetDefault() const {
-            return *default_value_;
+        int ReturnedSlot() const {
+            return returned_slot_;
         }
 
-        double * GetVariable(const std::string& variable_name) {
-            std::map<std::string, double>::iterator target = variables_.find(variable_name);
-            if (target == variables_.end()) {
-                return NULL;
-            }
-            return &(target->second);
+        int DefaultSlot() const {
+            return default_slot_;
         }
 
-        double * CreateOrGetVariable(const std::string& variable_name) {
-            std::pair<std::map<std::string, double>::iterator, bool> result =
-                variables_.insert(make_pair(std::string(variable_name), *default_value_));
-            return &(result.first->second);
+        // the default value when parsing, "default" may be reassigned at runtime.
+        double GetDefault() const {
+            return default_value_;
         }
 
-        virtual double Evaluate() {
-            double value = *default_value_;
-            for (std::vector<Operator*>::iterator it = children_.begin();
-                 it != children_.end() && should_return_ == false; ++it) {
-                value = (*it)->Evaluate();
+        virtual double Evaluate(Context& context) const {
+            double value = context.Get(default_slot_);
+            for (OperatorList::const_iterator it = children_.begin();
+                 it != children_.end() && context.Returned(returned_slot_) == false; ++it) {
+                value = (*it)->Evaluate(context);
             }
 
-            // return 'return_value_' if "return" is called,
+            // return 'return' slot if "return" is called,
             // or return the value of last sentence(for offline tool)
-            return should_return_ ? *return_value_ : value;
-        }
-
-        void Return(double value) {
-            *return_value_ = value;
-            should_return_ = true;
+            return context.Returned(returned_slot_) ? context.Get(return_slot_) : value;
         }
 
     private:
-        double * default_value_;
-        double * return_value_;
-        std::map<std::string, double> variables_;
-        bool should_return_;
+        int default_slot_;
+        int return_slot_;
+        int returned_slot_;
+        double default_value_;
     };
 
     class Num : public Operator {
     public:
         Num(double value) : Operator(), value_(value) {}
-        virtual double Evaluate() { return value_; }
+        virtual double Evaluate(Context& context) const { return value_; }
+        virtual int Type() const { return OP_NUM; }
+        double Value() const { return value_; }
     private:
         double value_;
     };
 
     class Variable : public Operator {
     public:
-        Variable(double * reference) : reference_(reference) {}
-        virtual double Evaluate() {
-            return *reference_;
+        Variable(int slot) : slot_(slot) {}
+        virtual int Type() const { return OP_VARIABLE; }
+        int Slot() const { return slot_; }
+        virtual double Evaluate(Context& context) const {
+            return context.Get(slot_);
         }
     private:
-        double * reference_;
+        int slot_;
+    };
+
+    // an extern, resolved by the first read in an evaluation, see Resolver.
+    class External : public Operator {
+    public:
+        External(int index, int slot, int resolved_slot)
+            : Operator(), index_(index), slot_(slot), resolved_slot_(resolved_slot) {}
+        virtual int Type() const { return OP_EXTERNAL; }
+        int Index() const { return index_; }
+        int Slot() const { return slot_; }
+        int ResolvedSlot() const { return resolved_slot_; }
+        virtual double Evaluate(Context& context) const {
+            if (context.Resolved(resolved_slot_) == false) {
+                context.Resolve(index_);
+            }
+            return context.Get(slot_);
+        }
+    private:
+        int index_; // in Program::Externs()
+        int slot_;
+        int resolved_slot_;
     };
 
     class Reference : public Operator {
     public:
-        Reference(Module * module,
-                  const std::string& name,
-                  double (*op)(double, double) = assign,
-                  bool check_rhs = false)
+        const static int ASSIGN = 0;
+        const static int ADD_ASSIGN = 1;
+        const static int SUB_ASSIGN = 2;
+        const static int MUL_ASSIGN = 3;
+        const static int DIV_ASSIGN = 4;
+        const static int MOD_ASSIGN = 5;
+
+        Reference(const Module * module, int slot, int assign_type = ASSIGN)
             : Operator(),
-              module_(module),
-              reference_(NULL),
-              is_return_(false),
-              op_(op),
-              check_rhs_(check_rhs) {
-                  reference_ = module_->CreateOrGetVariable(name);
-                  is_return_ = name == "return" ? true : false;
-              }
-
-        virtual double Evaluate() {
+              returned_slot_(module->ReturnedSlot()),
+              default_slot_(module->DefaultSlot()),
+              reference_(slot),
+              is_return_(slot == module->ReturnSlot()),
+              assign_type_(assign_type),
+              // "/=" and "%=" take the default value if rhs is 0
+              check_rhs_(assign_type == DIV_ASSIGN || assign_type == MOD_ASSIGN),
+              op_(NULL) {
+            static double (* const ops[])(double, double) = { assign, add, sub, mul, div, mod };
+            op_ = ops[assign_type];
+        }
+
+        virtual int Type() const { return OP_REFERENCE; }
+
+        int DefaultSlot() const { return default_slot_; }
+        int ReturnedSlot() const { return returned_slot_; }
+        int Slot() const { return reference_; }
+        bool IsReturn() const { return is_return_; }
+        int AssignType() const { return assign_type_; }
+
+        virtual double Evaluate(Context& context) const {
             if (is_return_) {
-                module_->Return(children_[0]->Evaluate());
+                context.Return(returned_slot_, reference_, children_[0]->Evaluate(context));
             } else {
-                double lhs = *reference_;
-                double rhs = children_[0]->Evaluate();
-                *reference_ = (check_rhs_ && rhs == 0) ? module_->GetDefault() : op_(lhs, rhs);
+                double lhs = context.Get(reference_);
+                double rhs = children_[0]->Evaluate(context);
+                context.Set(reference_, (check_rhs_ && rhs == 0) ? context.Get(default_slot_) : op_(lhs, rhs));
             }
-            return *reference_;
+            return context.Get(reference_);
         }
     private:
-        Module * module_;
-        double * reference_;
+        int returned_slot_;
+        int default_slot_;
+        int reference_;
         bool is_return_;
+        int assign_type_;
         bool check_rhs_;
         double (*op_)(double, double);
     };
 
     class Add : public Operator {
     public:
-        virtual double Evaluate() {
+        virtual int Type() const { return OP_ADD; }
+
+        virtual double Evaluate(Context& context) const {
             double value = 0.0;
-            for (std::vector<Operator *>::iterator it = children_.begin();
+            for (OperatorList::const_iterator it = children_.begin();
                  it != children_.end(); ++it) {
-                value += (*it)->Evaluate();
+                value += (*it)->Evaluate(context);
             }
             return value;
         }
@@ -173,24 +295,28 @@ namespace ttl {
 
     class Negative : public Operator {
     public:
-        virtual double Evaluate() {
-            return - children_[0]->Evaluate();
+        virtual int Type() const { return OP_NEGATIVE; }
+
+        virtual double Evaluate(Context& context) const {
+            return - children_[0]->Evaluate(context);
         }
     };
 
     class If : public Operator {
     public:
-        virtual double Evaluate() {
+        virtual int Type() const { return OP_IF; }
+
+        virtual double Evaluate(Context& context) const {
             int i = 0;
             for (i = 0; i + 1 < children_.size(); i += 2) {
-                if (children_[i]->Evaluate()) {
-                    return children_[i + 1]->Evaluate();
+                if (children_[i]->Evaluate(context)) {
+                    return children_[i + 1]->Evaluate(context);
                 }
             }
 
             if (i + 1 == children_.size()) {
                 // return the last else: if (...) { ... } else { ... }
-                return children_[i]->Evaluate();
+                return children_[i]->Evaluate(context);
             } else {
                 return 0; // take no effect when: if (false) { ... }
             }
@@ -199,10 +325,12 @@ namespace ttl {
 
     class Or : public Operator {
     public:
-        virtual double Evaluate() {
-            for (std::vector<Operator *>::iterator it = children_.begin();
+        virtual int Type() const { return OP_OR; }
+
+        virtual double Evaluate(Context& context) const {
+            for (OperatorList::const_iterator it = children_.begin();
                  it != children_.end(); ++it) {
-                double result = (*it)->Evaluate();
+                double result = (*it)->Evaluate(context);
                 if (result != 0) {
                     return (double)true;
                 }
@@ -213,10 +341,12 @@ namespace ttl {
 
     class And : public Operator {
     public:
-        virtual double Evaluate() {
-            for (std::vector<Operator *>::iterator it = children_.begin();
+        virtual int Type() const { return OP_AND; }
+
+        virtual double Evaluate(Context& context) const {
+            for (OperatorList::const_iterator it = children_.begin();
                  it != children_.end(); ++it) {
-                if ((*it)->Evaluate() == 0) {
+                if ((*it)->Evaluate(context) == 0) {
                     return (double)false;
                 }
             }
@@ -226,9 +356,11 @@ namespace ttl {
 
     class Less : public Operator {
     public:
-        virtual double Evaluate() {
-            double lhs = children_[0]->Evaluate();
-            double rhs = children_[1]->Evaluate();
+        virtual int Type() const { return OP_LESS; }
+
+        virtual double Evaluate(Context& context) const {
+            double lhs = children_[0]->Evaluate(context);
+            double rhs = children_[1]->Evaluate(context);
             bool ret =  lhs < rhs;
             return (double)ret;
         }
@@ -236,9 +368,11 @@ namespace ttl {
 
     class LessEqual : public Operator {
     public:
-        virtual double Evaluate() {
-            double lhs = children_[0]->Evaluate();
-            double rhs = children_[1]->Evaluate();
+        virtual int Type() const { return OP_LESS_EQUAL; }
+
+        virtual double Evaluate(Context& context) const {
+            double lhs = children_[0]->Evaluate(context);
+            double rhs = children_[1]->Evaluate(context);
             bool ret =  lhs <= rhs;
             return (double)ret;
         }
@@ -246,9 +380,11 @@ namespace ttl {
 
     class Greater : public Operator {
     public:
-        virtual double Evaluate() {
-            double lhs = children_[0]->Evaluate();
-            double rhs = children_[1]->Evaluate();
+        virtual int Type() const { return OP_GREATER; }
+
+        virtual double Evaluate(Context& context) const {
+            double lhs = children_[0]->Evaluate(context);
+            double rhs = children_[1]->Evaluate(context);
             bool ret =  lhs > rhs;
             return (double)ret;
         }
@@ -256,9 +392,11 @@ namespace ttl {
 
     class GreaterEqual : public Operator {
     public:
-        virtual double Evaluate() {
-            double lhs = children_[0]->Evaluate();
-            double rhs = children_[1]->Evaluate();
+        virtual int Type() const { return OP_GREATER_EQUAL; }
+
+        virtual double Evaluate(Context& context) const {
+            double lhs = children_[0]->Evaluate(context);
+            double rhs = children_[1]->Evaluate(context);
             bool ret =  lhs >= rhs;
             return (double)ret;
         }
@@ -266,9 +404,11 @@ namespace ttl {
 
     class Equal : public Operator {
     public:
-        virtual double Evaluate() {
-            double lhs = children_[0]->Evaluate();
-            double rhs = children_[1]->Evaluate();
+        virtual int Type() const { return OP_EQUAL; }
+
+        virtual double Evaluate(Context& context) const {
+            double lhs = children_[0]->Evaluate(context);
+            double rhs = children_[1]->Evaluate(context);
             bool ret =  lhs == rhs;
             return (double)ret;
         }
@@ -276,9 +416,11 @@ namespace ttl {
 
     class NotEqual : public Operator {
     public:
-        virtual double Evaluate() {
-            double lhs = children_[0]->Evaluate();
-            double rhs = children_[1]->Evaluate();
+        virtual int Type() const { return OP_NOT_EQUAL; }
+
+        virtual double Evaluate(Context& context) const {
+            double lhs = children_[0]->Evaluate(context);
+            double rhs = children_[1]->Evaluate(context);
             bool ret =  lhs != rhs;
             return (double)ret;
         }
@@ -288,14 +430,17 @@ namespace ttl {
     public:
         Div(double default_value) : Operator(), default_value_(default_value) {}
 
-        virtual double Evaluate() {
-            double divisor = children_[1]->Evaluate();
+        virtual int Type() const { return OP_DIV; }
+        double DefaultValue() const { return default_value_; }
+
+        virtual double Evaluate(Context& context) const {
+            double divisor = children_[1]->Evaluate(context);
             if (divisor == 0) {
                 std::cerr << "Divided by zero. Return default value "
                           << default_value_ << "." << std::endl;
                 return default_value_;
             }
-            return children_[0]->Evaluate() / divisor;
+            return children_[0]->Evaluate(context) / divisor;
         }
     private:
         double default_value_;
@@ -303,24 +448,162 @@ namespace ttl {
 
     class Mul : public Operator {
     public:
-        virtual double Evaluate() {
-            return children_[0]->Evaluate() * children_[1]->Evaluate();
+        virtual int Type() const { return OP_MUL; }
+
+        virtual double Evaluate(Context& context) const {
+            double lhs = children_[0]->Evaluate(context);
+            double rhs = children_[1]->Evaluate(context);
+            return lhs * rhs;
         }
     };
 
     class Mod : public Operator {
     public:
-        virtual double Evaluate() {
-            return (long long)children_[0]->Evaluate() % (long long)children_[1]->Evaluate();
+        virtual int Type() const { return OP_MOD; }
+
+        virtual double Evaluate(Context& context) const {
+            double lhs = children_[0]->Evaluate(context);
+            double rhs = children_[1]->Evaluate(context);
+            return (long long)lhs % (long long)rhs;
         }
     };
 
     class Not : public Operator {
     public:
-        virtual double Evaluate() {
-            return !children_[0]->Evaluate();
+        virtual int Type() const { return OP_NOT; }
+
+        virtual double Evaluate(Context& context) const {
+            return !children_[0]->Evaluate(context);
+        }
+    };
+
+    // "name(a, b, ...)": a native function, see Function.
+    class Call : public Operator {
+    public:
+        explicit Call(const Function * function) : Operator(), function_(function) {}
+
+        virtual int Type() const { return OP_CALL; }
+
+        const Function * GetFunction() const { return function_; }
+
+        virtual double Evaluate(Context& context) const {
+            double args[Function::MAX_ARITY];
+            for (std::size_t i = 0; i < children_.size(); ++i) {
+                args[i] = children_[i]->Evaluate(context);
+            }
+            return function_->scalar(args);
+        }
+    private:
+        const Function * function_; // registered, never deleted
+    };
+
+    /**
+     * a leaf which scores the variables with a model read from a file, the
+     * variables of the model are bound to slots by the parser.
+     */
+    // the children are the externs among the features, read before the
+    // model so they are resolved.
+    class ModelOperator : public Operator {
+    public:
+        // of the variables in 'values', by slot.
+        virtual double Score(const double * values) const = 0;
+        virtual const std::string& Path() const = 0;
+
+        virtual double Evaluate(Context& context) const {
+            for (std::size_t i = 0; i < children_.size(); ++i) {
+                children_[i]->Evaluate(context);
+            }
+            return Score(context.Registers(0));
         }
     };
+
+    /**
+     * "lr(model)": sigmoid(bias + sum of weight * variable).
+     *
+     * NOTE: the dot product is one call of the best kernels, see
+     *       Kernels::dot for its order.
+     */
+    class Logistic : public ModelOperator {
+    public:
+        // 'slots' has model->Size() items, in the arena.
+        Logistic(const LinearModel * model, const int * slots)
+            : ModelOperator(), model_(model), slots_(slots), dot_(BestKernels().dot) {}
+
+        virtual int Type() const { return OP_LOGISTIC; }
+
+        const LinearModel * Model() const { return model_; }
+        const int * Slots() const { return slots_; }
+        virtual const std::string& Path() const { return model_->Path(); }
+
+        virtual double Score(const double * values) const {
+            return sigmoid(dot_(values, slots_, model_->Weights(), model_->Size()) + model_->Bias());
+        }
+    private:
+        const LinearModel * model_; // kept by the program
+        const int * slots_;
+        double (*dot_)(const double * values, const int * slots, const double * weights, std::size_t n);
+    };
+
+    // "lambdamart(model)": the sum of the leaves of the trees.
+    class Ensemble : public ModelOperator {
+    public:
+        // 'slots' has a slot per feature of 'model', in the arena.
+        Ensemble(const TreeEnsemble * model, const int * slots)
+            : ModelOperator(), model_(model), slots_(slots) {}
+
+        virtual int Type() const { return OP_ENSEMBLE; }
+
+        const TreeEnsemble * Model() const { return model_; }
+        const int * Slots() const { return slots_; }
+        virtual const std::string& Path() const { return model_->Path(); }
+
+        virtual double Score(const double * values) const {
+            return model_->Evaluate(values, slots_);
+        }
+    private:
+        const TreeEnsemble * model_; // kept by the program
+        const int * slots_;
+    };
+
+    // true if the value of 'node' is 1 or 0.
+    inline bool IsBoolean(const Operator * node) {
+        switch (node->Type()) {
+        case Operator::OP_OR:
+        case Operator::OP_AND:
+        case Operator::OP_LESS:
+        case Operator::OP_LESS_EQUAL:
+        case Operator::OP_GREATER:
+        case Operator::OP_GREATER_EQUAL:
+        case Operator::OP_EQUAL:
+        case Operator::OP_NOT_EQUAL:
+        case Operator::OP_NOT:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    // true if 'node' is "<", "<=", ">", ">=", "==" or "!=".
+    inline bool IsComparison(const Operator * node) {
+        return IsBoolean(node) && node->Type() != Operator::OP_OR &&
+            node->Type() != Operator::OP_AND && node->Type() != Operator::OP_NOT;
+    }
+
+    // true if the value of 'node' is never -0. Add starts from +0.0, so
+    // "0.0 + node" is 'node' bit for bit.
+    inline bool NeverNegativeZero(const Operator * node) {
+        switch (node->Type()) {
+        case Operator::OP_NUM:
+            {
+                double value = static_cast<const Num *>(node)->Value();
+                return value != 0 || 1 / value > 0;
+            }
+        case Operator::OP_ADD: // the sum starts from +0
+            return true;
+        default:
+            return IsBoolean(node);
+        }
+    }
 }
 
 #endif
@@ -0,0 +1,313 @@
+/**
+ * optimizer.cc - simplify the ast after parsing
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#include "optimizer.hh"
+
+namespace ttl {
+
+    static bool IsNum(const Operator * node) {
+        return node->Type() == Operator::OP_NUM;
+    }
+
+    static double NumValue(const Operator * node) {
+        return static_cast<const Num *>(node)->Value();
+    }
+
+    static bool IsNum(const Operator * node, double value) {
+        return IsNum(node) && NumValue(node) == value;
+    }
+
+    Optimizer::Optimizer(Program * program)
+        : program_(program), context_(*program), changes_(0) {}
+
+    void Optimizer::Run() {
+        Module * root = program_->root_;
+        if (root != NULL) {
+            SimplifyModule(root);
+        }
+    }
+
+    Operator * Optimizer::Simplify(Operator * node) {
+        switch (node->Type()) {
+        case Operator::OP_MODULE:
+            return SimplifyModule(static_cast<Module *>(node));
+        case Operator::OP_NUM:
+        case Operator::OP_VARIABLE:
+        case Operator::OP_EXTERNAL:
+        case Operator::OP_LOGISTIC: // leaves, but not numbers
+        case Operator::OP_ENSEMBLE:
+            return node;
+        case Operator::OP_ADD:
+            return SimplifyAdd(node);
+        case Operator::OP_AND:
+            return SimplifyLogical(node, true);
+        case Operator::OP_OR:
+            return SimplifyLogical(node, false);
+        case Operator::OP_IF:
+            return SimplifyIf(node);
+        case Operator::OP_MUL:
+            return SimplifyMul(node);
+        case Operator::OP_DIV:
+            return SimplifyDiv(node);
+        case Operator::OP_NEGATIVE:
+            return SimplifyNegative(node);
+        case Operator::OP_NOT:
+            return SimplifyNot(node);
+        case Operator::OP_CALL:
+            {
+                // a pure call of numbers is a number
+                OperatorList& args = node->children_;
+                for (std::size_t i = 0; i < args.size(); ++i) {
+                    args[i] = Simplify(args[i]);
+                }
+                return static_cast<const Call *>(node)->GetFunction()->pure ? Fold(node) : node;
+            }
+        }
+
+        // references, comparisons and "%"
+        OperatorList& children = node->children_;
+        for (std::size_t i = 0; i < children.size(); ++i) {
+            children[i] = Simplify(children[i]);
+        }
+        return node->Type() == Operator::OP_REFERENCE ? node : Fold(node);
+    }
+
+    Operator * Optimizer::SimplifyModule(Module * module) {
+        OperatorList& sentences = module->children_;
+        for (std::size_t i = 0; i < sentences.size(); ++i) {
+            sentences[i] = Simplify(sentences[i]);
+        }
+        return module;
+    }
+
+    Operator * Optimizer::SimplifyAdd(Operator * node) {
+        Arena& arena = program_->GetArena();
+        const OperatorList& children = node->children_;
+
+        // "(a + b) + c": 0.0 + (0.0 + a + b) + c is 0.0 + a + b + c, as
+        // a sum is never -0.
+        OperatorList addends;
+        for (std::size_t i = 0; i < children.size(); ++i) {
+            Operator * addend = Simplify(children[i]);
+            if (i == 0 && addend->Type() == Operator::OP_ADD) {
+                const OperatorList& nested = addend->children_;
+                for (std::size_t j = 0; j < nested.size(); ++j) {
+                    addends.push_back(arena, nested[j]);
+                }
+                ++changes_;
+            } else {
+                addends.push_back(arena, addend);
+            }
+        }
+
+        // sum up the leading numbers in order, the sum starts from +0 and
+        // adding +0 or -0 to it changes nothing.
+        double prefix = 0.0;
+        std::size_t first = 0;
+        while (first < addends.size() && IsNum(addends[first])) {
+            prefix += NumValue(addends[first++]);
+        }
+
+        OperatorList result;
+        if (prefix != 0) {
+            result.push_back(arena, first == 1 ? addends[0] : NewNum(prefix));
+        }
+        for (std::size_t i = first; i < addends.size(); ++i) {
+            if (IsNum(addends[i], 0)) {
+                continue;
+            }
+            result.push_back(arena, addends[i]);
+        }
+
+        if (result.size() != children.size()) {
+            ++changes_;
+        }
+        if (result.size() == 0) {
+            return NewNum(prefix);
+        }
+        if (result.size() == 1 && NeverNegativeZero(result[0])) {
+            return result[0];
+        }
+        node->children_ = result;
+        return node;
+    }
+
+    Operator * Optimizer::SimplifyLogical(Operator * node, bool is_and) {
+        Arena& arena = program_->GetArena();
+        const OperatorList& children = node->children_;
+
+        OperatorList conditions;
+        for (std::size_t i = 0; i < children.size(); ++i) {
+            Operator * condition = Condition(Simplify(children[i]));
+            if (condition->Type() == node->Type()) {
+                // "a && (b && c)", the result is 1 or 0 either way.
+                const OperatorList& nested = condition->children_;
+                for (std::size_t j = 0; j < nested.size(); ++j) {
+                    conditions.push_back(arena, nested[j]);
+                }
+                ++changes_;
+                continue;
+            }
+
+            if (IsNum(condition)) {
+                bool truth = NumValue(condition) != 0;
+                if (truth != is_and) {
+                    // decides the result, the rest is never evaluated.
+                    conditions.push_back(arena, condition);
+                    break;
+                }
+                ++changes_; // "1 && x", "0 || x"
+                continue;
+            }
+            conditions.push_back(arena, condition);
+        }
+
+        if (conditions.size() == 0) {
+            return NewNum(is_and ? 1.0 : 0.0);
+        }
+        if (conditions.size() == 1 && IsNum(conditions[0])) {
+            return Replace(node, NewNum(is_and ? 0.0 : 1.0));
+        }
+        if (conditions.size() == 1 && IsBoolean(conditions[0])) {
+            return Replace(node, conditions[0]);
+        }
+        node->children_ = conditions;
+        return node;
+    }
+
+    Operator * Optimizer::SimplifyIf(Operator * node) {
+        Arena& arena = program_->GetArena();
+        const OperatorList& children = node->children_;
+
+        OperatorList branches;
+        std::size_t i = 0;
+        for (; i + 1 < children.size(); i += 2) {
+            Operator * condition = Condition(Simplify(children[i]));
+            if (IsNum(condition) == false) {
+                branches.push_back(arena, condition);
+                branches.push_back(arena, Simplify(children[i + 1]));
+                continue;
+            }
+
+            if (NumValue(condition) == 0) {
+                ++changes_; // never taken
+                continue;
+            }
+
+            // always taken, it is the "else" of the branches before.
+            Operator * module = Simplify(children[i + 1]);
+            ++changes_;
+            if (branches.size() == 0) {
+                return module;
+            }
+            branches.push_back(arena, module);
+            node->children_ = branches;
+            return node;
+        }
+
+        if (i + 1 == children.size()) {
+            Operator * module = Simplify(children[i]);
+            if (branches.size() == 0) {
+                ++changes_;
+                return module;
+            }
+            branches.push_back(arena, module);
+        }
+
+        if (branches.size() == 0) {
+            ++changes_;
+            return NewNum(0); // no branch is taken
+        }
+        node->children_ = branches;
+        return node;
+    }
+
+    Operator * Optimizer::SimplifyMul(Operator * node) {
+        OperatorList& children = node->children_;
+        children[0] = Simplify(children[0]);
+        children[1] = Simplify(children[1]);
+
+        if (IsNum(children[1], 1)) {
+            return Replace(node, children[0]);
+        }
+        if (IsNum(children[0], 1)) {
+            return Replace(node, children[1]);
+        }
+        return Fold(node);
+    }
+
+    Operator * Optimizer::SimplifyDiv(Operator * node) {
+        OperatorList& children = node->children_;
+        children[0] = Simplify(children[0]);
+        children[1] = Simplify(children[1]);
+
+        if (IsNum(children[1], 1)) {
+            return Replace(node, children[0]);
+        }
+        return Fold(node);
+    }
+
+    Operator * Optimizer::SimplifyNegative(Operator * node) {
+        OperatorList& children = node->children_;
+        children[0] = Simplify(children[0]);
+
+        if (children[0]->Type() == Operator::OP_NEGATIVE) {
+            return Replace(node, children[0]->children_[0]);
+        }
+        return Fold(node);
+    }
+
+    Operator * Optimizer::SimplifyNot(Operator * node) {
+        OperatorList& children = node->children_;
+        children[0] = Condition(Simplify(children[0]));
+        return Fold(node);
+    }
+
+    Operator * Optimizer::Fold(Operator * node) {
+        const OperatorList& children = node->children_;
+        for (std::size_t i = 0; i < children.size(); ++i) {
+            if (IsNum(children[i]) == false) {
+                return node;
+            }
+        }
+
+        if (node->Type() == Operator::OP_DIV && NumValue(children[1]) == 0) {
+            return node; // keep the message
+        }
+        if (node->Type() == Operator::OP_MOD) {
+            long long divisor = (long long)NumValue(children[1]);
+            if (divisor == 0 || divisor == -1) {
+                return node; // the same trap as the original
+            }
+        }
+
+        return Replace(node, NewNum(node->Evaluate(context_)));
+    }
+
+    Operator * Optimizer::Condition(Operator * node) {
+        while (node->Type() == Operator::OP_NOT &&
+               node->children_[0]->Type() == Operator::OP_NOT) {
+            node = node->children_[0]->children_[0];
+            ++changes_;
+        }
+        return node;
+    }
+
+    Operator * Optimizer::NewNum(double value) {
+        return new (program_->GetArena()) Num(value);
+    }
+
+    Operator * Optimizer::Replace(Operator * node, Operator * replacement) {
+        if (replacement != node) {
+            ++changes_;
+        }
+        return replacement;
+    }
+
+} // ttl
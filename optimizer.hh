@@ -0,0 +1,73 @@
+/**
+ * optimizer.hh - simplify the ast after parsing
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#ifndef TTL_OPTIMIZER_H
+#define TTL_OPTIMIZER_H
+
+#include "operator.hh"
+#include "program.hh"
+
+namespace ttl {
+
+    /**
+     * constant folding and algebraic simplification, in place.
+     *
+     * NOTE:
+     *     0. the result of every evaluation is the same bit for bit,
+     *        including NaN, -0 and the "Divided by zero" messages; only
+     *        the identities which hold for every double are applied:
+     *        "x * 1", "x / 1", "- - x", "x + 0", and "!!x" where only the
+     *        truth of x matters (conditions, "&&", "||", "!");
+     *     1. subtrees of numbers are folded, except "/" and "%" by zero;
+     *     2. "if" branches with constant conditions are pruned;
+     *     3. nested "&&" and "||" are flattened, so is an "+" which is the
+     *        first addend of another one: "(a + b) + c" -> "a + b + c".
+     *        other nested additions round differently and are kept;
+     *     4. new nodes are allocated in the arena of the program.
+     */
+    class Optimizer {
+    public:
+        explicit Optimizer(Program * program);
+
+        void Run();
+
+        // the number of nodes replaced or removed by Run().
+        std::size_t Changes() const { return changes_; }
+
+    private:
+        Operator * Simplify(Operator * node);
+        Operator * SimplifyModule(Module * module);
+        Operator * SimplifyAdd(Operator * node);
+        Operator * SimplifyLogical(Operator * node, bool is_and);
+        Operator * SimplifyIf(Operator * node);
+        Operator * SimplifyMul(Operator * node);
+        Operator * SimplifyDiv(Operator * node);
+        Operator * SimplifyNegative(Operator * node);
+        Operator * SimplifyNot(Operator * node);
+        // evaluate 'node' if all children are numbers, or return 'node'.
+        Operator * Fold(Operator * node);
+
+        // remove pairs of "!" from a node of which only the truth is used.
+        Operator * Condition(Operator * node);
+
+        Operator * NewNum(double value);
+        Operator * Replace(Operator * node, Operator * replacement);
+
+    private:
+        Optimizer(const Optimizer&);
+        Optimizer& operator=(const Optimizer&);
+
+        Program * program_;
+        Context context_; // to fold numbers
+        std::size_t changes_;
+    };
+
+} // ttl
+
+#endif
@@ -0,0 +1,122 @@
+/**
+ * parallel.cc - evaluate columns of documents on all cpus
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#include <algorithm>
+#include "parallel.hh"
+
+namespace ttl {
+
+    ParallelEvaluator::ParallelEvaluator(const Program& program, Scheduler& scheduler,
+                                         const std::string& engine)
+        : program_(program),
+          scheduler_(scheduler),
+          bytecode_(NULL),
+          jit_(NULL),
+          inputs_(),
+          resolved_(),
+          resolver_(NULL),
+          contexts_(),
+          batches_() {
+        if (engine == "bytecode") {
+            bytecode_ = new Bytecode(program_);
+        } else if (engine == "jit") {
+            jit_ = new Jit(program_);
+        }
+
+        for (int i = 0; i < scheduler_.Threads(); ++i) {
+            if (engine == "batch") {
+                batches_.push_back(new BatchEvaluator(program_));
+            } else {
+                contexts_.push_back(new Context(program_));
+            }
+        }
+    }
+
+    ParallelEvaluator::~ParallelEvaluator() {
+        for (std::size_t i = 0; i < contexts_.size(); ++i) {
+            delete contexts_[i];
+        }
+        for (std::size_t i = 0; i < batches_.size(); ++i) {
+            delete batches_[i];
+        }
+        delete bytecode_;
+        delete jit_;
+    }
+
+    bool ParallelEvaluator::Bind(const std::string& name, const double * column) {
+        int slot = program_.Input(name);
+        if (slot < 0) {
+            return false;
+        }
+        Bind(slot, column);
+        return true;
+    }
+
+    void ParallelEvaluator::Bind(int slot, const double * column) {
+        for (std::size_t i = 0; i < batches_.size(); ++i) {
+            batches_[i]->Bind(slot, column);
+        }
+        const std::vector<Extern>& externs = program_.Externs();
+        for (std::size_t i = 0; i < externs.size(); ++i) {
+            if (externs[i].slot == slot &&
+                std::find(resolved_.begin(), resolved_.end(), externs[i].resolved_slot) == resolved_.end()) {
+                resolved_.push_back(externs[i].resolved_slot);
+            }
+        }
+        for (std::size_t i = 0; i < inputs_.size(); ++i) {
+            if (inputs_[i].first == slot) {
+                inputs_[i].second = column;
+                return;
+            }
+        }
+        inputs_.push_back(std::make_pair(slot, column));
+    }
+
+    void ParallelEvaluator::SetResolver(Resolver * resolver) {
+        resolver_ = resolver;
+        for (std::size_t i = 0; i < batches_.size(); ++i) {
+            batches_[i]->SetResolver(resolver);
+        }
+    }
+
+    void ParallelEvaluator::Evaluate(std::size_t rows, double * out) {
+        scheduler_.For(rows, CHUNK_SIZE, [this, out](std::size_t begin, std::size_t end, int worker) {
+            EvaluateChunk(begin, end, worker, out);
+        });
+    }
+
+    void ParallelEvaluator::EvaluateChunk(std::size_t begin, std::size_t end, int worker, double * out) {
+        if (batches_.empty() == false) {
+            batches_[worker]->Evaluate(begin, end, out);
+        } else if (bytecode_ != NULL) {
+            EvaluateRows(*bytecode_, *contexts_[worker], begin, end, out);
+        } else if (jit_ != NULL) {
+            EvaluateRows(*jit_, *contexts_[worker], begin, end, out);
+        } else {
+            EvaluateRows(program_, *contexts_[worker], begin, end, out);
+        }
+    }
+
+    template <typename Engine>
+    void ParallelEvaluator::EvaluateRows(const Engine& engine, Context& context,
+                                         std::size_t begin, std::size_t end, double * out) {
+        for (std::size_t row = begin; row < end; ++row) {
+            context.Reset();
+            context.SetResolver(resolver_, row);
+            for (std::size_t i = 0; i < inputs_.size(); ++i) {
+                context.Set(inputs_[i].first, inputs_[i].second[row]);
+            }
+            for (std::size_t i = 0; i < resolved_.size(); ++i) {
+                context.Set(resolved_[i], 1);
+            }
+            out[row] = engine.Evaluate(context);
+        }
+    }
+
+} // ttl
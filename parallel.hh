@@ -0,0 +1,87 @@
+/**
+ * parallel.hh - evaluate columns of documents on all cpus
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#ifndef TTL_PARALLEL_H
+#define TTL_PARALLEL_H
+
+#include <string>
+#include <utility>
+#include <vector>
+#include "batch.hh"
+#include "bytecode.hh"
+#include "jit.hh"
+#include "program.hh"
+#include "scheduler.hh"
+
+namespace ttl {
+
+    /**
+     * evaluate a program over columns of inputs, one row per document, on
+     * the threads of a scheduler.
+     *
+     * NOTE:
+     *     0. the rows are split into chunks of CHUNK_SIZE, scheduled with
+     *        work stealing, so rows of uneven cost (deep "if" chains, early
+     *        "&&" exits) keep all threads busy;
+     *     1. the program is compiled once for all threads, every thread
+     *        has its own Context, or BatchEvaluator;
+     *     2. the result of each row is the same as Program::Evaluate with
+     *        the inputs of that row;
+     *     3. one Evaluate() at a time;
+     *     4. the externs not bound are resolved by the resolver, with the
+     *        row numbers, from all threads.
+     */
+    class ParallelEvaluator {
+    public:
+        const static std::size_t CHUNK_SIZE = 1024;
+
+        // 'engine' is "tree", "bytecode", "jit" or "batch".
+        ParallelEvaluator(const Program& program, Scheduler& scheduler,
+                          const std::string& engine = "jit");
+        ~ParallelEvaluator();
+
+        // bind input (or extern) 'name' to a column, the column must hold
+        // all rows evaluated. return false if 'name' is not an input.
+        bool Bind(const std::string& name, const double * column);
+        void Bind(int slot, const double * column);
+
+        // the resolver of the externs not bound, it must be thread safe.
+        void SetResolver(Resolver * resolver);
+
+        // evaluate 'rows' rows of the bound columns, the result of row i is
+        // stored in out[i].
+        void Evaluate(std::size_t rows, double * out);
+
+    private:
+        ParallelEvaluator(const ParallelEvaluator&);
+        ParallelEvaluator& operator=(const ParallelEvaluator&);
+
+        void EvaluateChunk(std::size_t begin, std::size_t end, int worker, double * out);
+
+        template <typename Engine>
+        void EvaluateRows(const Engine& engine, Context& context,
+                          std::size_t begin, std::size_t end, double * out);
+
+    private:
+        const Program& program_;
+        Scheduler& scheduler_;
+        Bytecode * bytecode_;
+        Jit * jit_;
+        std::vector<std::pair<int, const double *> > inputs_; // slot, column
+        std::vector<int> resolved_; // the flags of the externs bound
+        Resolver * resolver_;
+
+        // per thread of the scheduler
+        std::vector<Context *> contexts_;
+        std::vector<BatchEvaluator *> batches_;
+    };
+
+} // ttl
+
+#endif
@@ -7,6 +7,7 @@
  * Copyright © 2017, Bao Hexing. All Rights Reserved.
  */
 
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <string>
@@ -16,6 +17,8 @@
 #include <time.h>
 #include "parser.hh"
 #include "common.hh"
+#include "cse.hh"
+#include "optimizer.hh"
 
 namespace ttl {
 
@@ -24,7 +27,8 @@ namespace ttl {
         "bad syntax", // 1
         "nested loop", // 2
         "file not readable", // 3
-        "variable not defined" // 4
+        "variable not defined", // 4
+        "bad model" // 5
     };
 
     std::map<std::string, Parser::fn> Parser::name_token_processors_;
@@ -37,15 +41,36 @@ namespace ttl {
         // register name token handlers, such as lr", "lambdamart", ...
         name_token_processors_.insert(make_pair(std::string("include"), &Parser::CreateInclude));
         name_token_processors_.insert(make_pair(std::string("now"), &Parser::CreateNow));
+        name_token_processors_.insert(make_pair(std::string("lr"), &Parser::CreateLr));
+        name_token_processors_.insert(make_pair(std::string("lambdamart"), &Parser::CreateLambdamart));
 
         // ...
         return true;
     }
 
-    Parser::Parser() : Parser(NULL) {}
-
-    Parser::Parser(std::list<std::string> * module_name_stack)
-        : ast_tree_(NULL),
+    Parser::Parser() : Parser(NULL, NULL) {}
+
+    Parser::Parser(std::list<std::string> * module_name_stack, Program * program)
+        : program_(program),
+          owns_program_(program == NULL),
+          context_(NULL),
+          inputs_(),
+          optimize_(true),
+          dump_(NULL),
+          track_positions_(false),
+          source_(NULL),
+          ast_tree_(NULL),
+          dependencies_(),
+          symbols_(),
+          processors_(),
+          functions_(),
+          input_slots_(),
+          externs_(),
+          extern_names_(),
+          bindings_(),
+          hidden_(),
+          scope_(0),
+          scopes_(0),
           current_token_(),
           tokenizer_(""),
           error_code_(0),
@@ -55,10 +80,29 @@ namespace ttl {
         if (module_name_stack_ == NULL) {
             module_name_stack_ = new std::list<std::string>();
         }
+
+        symbols_.Intern("default");
+        symbols_.Intern("return");
+        symbols_.Intern("extern");
+        for (std::map<std::string, fn>::iterator it = name_token_processors_.begin();
+             it != name_token_processors_.end(); ++it) {
+            int symbol = symbols_.Intern(it->first);
+            processors_.resize(symbol + 1, NULL);
+            processors_[symbol] = it->second;
+        }
+        std::vector<const Function *> functions = RegisteredFunctions();
+        for (std::size_t i = 0; i < functions.size(); ++i) {
+            int symbol = symbols_.Intern(functions[i]->name);
+            functions_.resize(symbol + 1, NULL);
+            functions_[symbol] = functions[i];
+        }
     }
 
     Parser::~Parser() {
-        delete ast_tree_;
+        delete context_;
+        if (owns_program_) {
+            delete program_;
+        }
 
         // only the top Parser is responsible to release module_name_stack_
         if (module_name_stack_->size() == 0) {
@@ -72,18 +116,113 @@ namespace ttl {
             return false;
         }
 
-        tokenizer_.Reset(code);
+        return Create(code, strlen(code));
+    }
+
+    bool Parser::Create(const char * code, std::size_t length) {
+        tokenizer_.Reset(code, length);
+        source_ = code;
+
+        if (owns_program_) {
+            delete context_;
+            context_ = NULL;
+            delete program_;
+            program_ = new Program();
+            for (std::vector<std::string>::iterator it = inputs_.begin();
+                 it != inputs_.end(); ++it) {
+                program_->AddInput(*it, Constants::DEFAULT_RETURN_VALUE);
+            }
+            for (std::size_t i = 0; i < extern_names_.size(); ++i) {
+                program_->AddExtern(extern_names_[i]);
+            }
+        }
+
+        const std::map<std::string, int>& inputs = program_->Inputs();
+        for (std::map<std::string, int>::const_iterator it = inputs.begin(); it != inputs.end(); ++it) {
+            int symbol = symbols_.Intern(it->first);
+            if (input_slots_.size() <= (std::size_t)symbol) {
+                input_slots_.resize(symbol + 1, -1);
+            }
+            input_slots_[symbol] = it->second;
+        }
+        externs_.clear();
+        const std::vector<Extern>& externs = program_->Externs();
+        for (std::size_t i = 0; i < externs.size(); ++i) {
+            int symbol = symbols_.Intern(externs[i].name);
+            externs_.resize(std::max(externs_.size(), (std::size_t)symbol + 1), -1);
+            externs_[symbol] = i;
+        }
 
         module_name_stack_->push_back("plugin.conf");
-        ast_tree_ = new Module(Constants::DEFAULT_RETURN_VALUE);
+        bindings_.clear();
+        hidden_.clear();
+        scope_ = ++scopes_;
+        ast_tree_ = new (GetArena()) Module(program_, Constants::DEFAULT_RETURN_VALUE);
         CreateModule(Tokenizer::TOKEN_EOL);
+        scope_ = 0;
         module_name_stack_->pop_back();
 
-        return error_code_ == 0 && ast_tree_ != NULL;
+        if (owns_program_) {
+            // the program owns the ast from now on.
+            program_->SetRoot(ast_tree_);
+            ast_tree_ = NULL;
+            if (error_code_ == 0) {
+                Optimize();
+            }
+        }
+
+        return error_code_ == 0 && (owns_program_ || ast_tree_ != NULL);
+    }
+
+    void Parser::Optimize() {
+        if (dump_ != NULL) {
+            *dump_ << "ast:" << std::endl;
+            program_->Dump(*dump_);
+        }
+
+        if (optimize_ == false) {
+            return;
+        }
+
+        Optimizer optimizer(program_);
+        optimizer.Run();
+        SubexpressionEliminator eliminator(program_);
+        eliminator.Run();
+        if (dump_ != NULL) {
+            *dump_ << "optimized ast (" << optimizer.Changes() << " changes, "
+                   << eliminator.Changes() << " common subexpressions, "
+                   << eliminator.Shared() << " nodes shared):" << std::endl;
+            program_->Dump(*dump_);
+        }
+    }
+
+    void Parser::SetOptimize(bool optimize, std::ostream * dump) {
+        optimize_ = optimize;
+        dump_ = dump;
+    }
+
+    void Parser::AddInput(const std::string& name) {
+        inputs_.push_back(name);
     }
 
     double Parser::Evaluate() {
-        return ast_tree_->Evaluate();
+        if (context_ == NULL) {
+            context_ = new Context(*program_);
+        }
+        context_->Reset();
+        return program_->Evaluate(*context_);
+    }
+
+    const Program * Parser::GetProgram() const {
+        return program_;
+    }
+
+    Program * Parser::Release() {
+        Program * program = program_;
+        delete context_;
+        context_ = NULL;
+        program_ = NULL;
+        return program;
     }
 
     void Parser::CreateModule(long end_type) {
@@ -94,7 +233,12 @@ namespace ttl {
                 break;
             }
 
+            const char * begin = current_token_.token_pos;
+            std::size_t sentences = ast_tree_->Children().size();
             CreateSentence();
+            if (ast_tree_->Children().size() > sentences) {
+                Mark(begin);
+            }
 
             if (current_token_.token_type == end_type) {
                 break;
@@ -114,12 +258,19 @@ namespace ttl {
         }
 
         Module * origin_ast = ast_tree_;
-        ast_tree_ = new Module(Constants::DEFAULT_RETURN_VALUE);
+        int origin_scope = scope_;
+        std::size_t origin_hidden = hidden_.size();
+        scope_ = ++scopes_;
+        ast_tree_ = new (GetArena()) Module(program_, Constants::DEFAULT_RETURN_VALUE);
         CreateModule(Tokenizer::TOKEN_RIGHT_TORUS);
+        scope_ = origin_scope;
+        while (hidden_.size() > origin_hidden) {
+            bindings_[hidden_.back().first] = hidden_.back().second;
+            hidden_.pop_back();
+        }
 
         if (current_token_.token_type != Tokenizer::TOKEN_RIGHT_TORUS) {
             error_code_ = 1;
-            delete ast_tree_;
             ast_tree_ = origin_ast;
             return NULL;
         }
@@ -131,49 +282,47 @@ namespace ttl {
 
     void Parser::CreateIf() {
         Module * torus_module = NULL;
-        If * if_op = new If();
+        If * if_op = new (GetArena()) If();
 
         do {
             tokenizer_.NextToken(current_token_);
             CreateValue(); // create 'condition'
             if (error_code_ != 0) {
-                delete if_op;
                 return;
             }
 
             Operator * condition = NULL;
             if (ast_tree_->PopLastChild(&condition) == false) {
-                delete if_op;
                 error_code_ = 1;
                 return;
             }
-            if_op->AddChild(condition);
+            if_op->AddChild(GetArena(), condition);
 
+            const char * begin = current_token_.token_pos;
             torus_module = CreateTorusModule();
             if (torus_module == NULL) {
-                delete if_op;
                 return;
             }
-            if_op->AddChild(torus_module);
+            Mark(torus_module, begin, current_token_.token_pos + current_token_.token_length);
+            if_op->AddChild(GetArena(), torus_module);
 
             tokenizer_.NextToken(current_token_);
-            if (current_token_.token_type != Tokenizer::TOKEN_NAME ||
-                strncmp(current_token_.token_pos, "else", strlen("else")) != 0) {
-                ast_tree_->AddChild(if_op);
+            if (current_token_.token_type != Tokenizer::TOKEN_ELSE) {
+                ast_tree_->AddChild(GetArena(), if_op);
                 return; // if ( ... ) { ... }
             }
             tokenizer_.NextToken(current_token_);
-        } while (current_token_.token_type == Tokenizer::TOKEN_NAME &&
-                 strncmp(current_token_.token_pos, "if", strlen("if")) == 0);
+        } while (current_token_.token_type == Tokenizer::TOKEN_IF);
 
+        const char * begin = current_token_.token_pos;
         torus_module = CreateTorusModule();
         if (torus_module == NULL) {
-            delete if_op;
             return;
         }
+        Mark(torus_module, begin, current_token_.token_pos + current_token_.token_length);
 
-        if_op->AddChild(torus_module);
-        ast_tree_->AddChild(if_op);
+        if_op->AddChild(GetArena(), torus_module);
+        ast_tree_->AddChild(GetArena(), if_op);
         tokenizer_.NextToken(current_token_);
         return;
     }
@@ -196,9 +345,9 @@ namespace ttl {
             return;
         }
 
-        Reference * ref = new Reference(ast_tree_, std::string("return"));
-        ref->AddChild(expr);
-        ast_tree_->AddChild(ref);
+        Reference * ref = new (GetArena()) Reference(ast_tree_, ast_tree_->ReturnSlot());
+        ref->AddChild(GetArena(), expr);
+        ast_tree_->AddChild(GetArena(), ref);
         return;
     }
 
@@ -212,18 +361,18 @@ namespace ttl {
         return false;
     }
 
-    void Parser::CreateInclude() {
+    bool Parser::ReadPath(std::string * path) {
         // read "("
         tokenizer_.NextToken(current_token_);
         if (current_token_.token_type != Tokenizer::TOKEN_LEFT_BANANA) {
             error_code_ = 1;
-            return;
+            return false;
         }
 
         // begin to read file name. "/" is considered as file path separator.
         tokenizer_.NextToken(current_token_);
         const char * path_start = current_token_.token_pos;
-        while (current_token_.token_type == Tokenizer::TOKEN_NAME ||
+        while (Tokenizer::IsName(current_token_.token_type) ||
                current_token_.token_type == Tokenizer::TOKEN_DIV) {
             tokenizer_.NextToken(current_token_);
         }
@@ -231,32 +380,288 @@ namespace ttl {
         // read ")"
         if (current_token_.token_type != Tokenizer::TOKEN_RIGHT_BANANA) {
             error_code_ = 1;
-            return;
+            return false;
         }
 
-        std::string filename = std::string(path_start, current_token_.token_pos - path_start);
+        *path = std::string(path_start, current_token_.token_pos - path_start);
+        return true;
+    }
+
+    void Parser::CreateInclude() {
+        std::string filename;
+        if (ReadPath(&filename) == false) {
+            return;
+        }
         if (NestedIncluded(filename) == true) {
             error_code_ = 2;
             return;
         }
 
-        const char * content = ReadFile(filename);
+        ModuleCache& cache = ModuleCache::Instance();
+        std::string key = ModuleCache::Key(filename, *program_);
+        std::shared_ptr<const CachedModule> cached = cache.Find(key);
+        if (cached) {
+            // included by one of its includes
+            for (std::size_t i = 0; i < cached->dependencies.size(); ++i) {
+                if (NestedIncluded(cached->dependencies[i].path)) {
+                    error_code_ = 2;
+                    return;
+                }
+            }
+        } else {
+            cached = ParseInclude(filename);
+            if (!cached) {
+                return;
+            }
+            cache.Insert(key, cached);
+        }
+        dependencies_.insert(dependencies_.end(), cached->dependencies.begin(), cached->dependencies.end());
+
+        const Program& from = *cached->program;
+        std::vector<int> slots(from.SlotCount(), -1);
+        ast_tree_->AddChild(GetArena(), Clone(from.Root(), NULL, from, &slots));
+
+        tokenizer_.NextToken(current_token_);
+    }
+
+    int * Parser::BindFeatures(const std::vector<std::string>& features, std::vector<Operator *> * externs) {
+        // the variables are bound now, as any variable read here.
+        int * slots = static_cast<int *>(GetArena().Allocate(features.size() * sizeof(int)));
+        for (std::size_t i = 0; i < features.size(); ++i) {
+            int symbol = symbols_.Intern(features[i]);
+            slots[i] = FindVariable(symbol);
+            if (slots[i] < 0 && (std::size_t)symbol < externs_.size() && externs_[symbol] >= 0) {
+                const Extern& e = program_->Externs()[externs_[symbol]];
+                externs->push_back(new (GetArena()) External(externs_[symbol], e.slot, e.resolved_slot));
+                slots[i] = e.slot;
+            }
+            if (slots[i] < 0) {
+                error_code_ = 4;
+                return NULL;
+            }
+        }
+        return slots;
+    }
+
+    void Parser::CreateLr() {
+        std::string filename;
+        if (ReadPath(&filename) == false) {
+            return;
+        }
+
+        std::string error;
+        std::shared_ptr<const LinearModel> model = LinearModel::Load(filename, &error);
+        if (!model) {
+            error_code_ = FileExists(filename) ? 5 : 3;
+            return;
+        }
+        std::vector<Operator *> externs;
+        int * slots = BindFeatures(model->Features(), &externs);
+        if (slots == NULL) {
+            return;
+        }
 
-        module_name_stack_->push_back(filename);
-        Parser p(module_name_stack_);
-        if (p.Create(content) == false) {
-            error_code_ = p.error_code_; // TODO copy the error context
-            module_name_stack_->pop_back();
+        program_->AddModel(model);
+        dependencies_.push_back(model->Stamp());
+        Operator * lr = new (GetArena()) Logistic(model.get(), slots);
+        for (std::size_t i = 0; i < externs.size(); ++i) {
+            lr->AddChild(GetArena(), externs[i]);
+        }
+        ast_tree_->AddChild(GetArena(), lr);
+        tokenizer_.NextToken(current_token_);
+    }
+
+    void Parser::CreateLambdamart() {
+        std::string filename;
+        if (ReadPath(&filename) == false) {
             return;
         }
-        module_name_stack_->pop_back();
 
-        ast_tree_->AddChild(p.ast_tree_);
-        p.ast_tree_ = NULL;
+        std::string error;
+        std::shared_ptr<const TreeEnsemble> model = TreeEnsemble::Load(filename, &error);
+        if (!model) {
+            error_code_ = FileExists(filename) ? 5 : 3;
+            return;
+        }
+        std::vector<Operator *> externs;
+        int * slots = BindFeatures(model->Features(), &externs);
+        if (slots == NULL) {
+            return;
+        }
 
+        program_->AddModel(model);
+        dependencies_.push_back(model->Stamp());
+        Operator * lambdamart = new (GetArena()) Ensemble(model.get(), slots);
+        for (std::size_t i = 0; i < externs.size(); ++i) {
+            lambdamart->AddChild(GetArena(), externs[i]);
+        }
+        ast_tree_->AddChild(GetArena(), lambdamart);
         tokenizer_.NextToken(current_token_);
     }
 
+    std::shared_ptr<const CachedModule> Parser::ParseInclude(const std::string& filename) {
+        std::shared_ptr<CachedModule> module(new CachedModule());
+        FileStamp stamp;
+        MappedFile content;
+        if (stamp.Stat(filename) == false || content.Open(filename) == false) {
+            error_code_ = 3;
+            return std::shared_ptr<const CachedModule>();
+        }
+        module->dependencies.push_back(stamp);
+
+        // optimized later, together with the program which includes it.
+        Parser p(module_name_stack_, NULL);
+        p.SetOptimize(false);
+        const std::map<std::string, int>& inputs = program_->Inputs();
+        for (std::map<std::string, int>::const_iterator it = inputs.begin(); it != inputs.end(); ++it) {
+            p.AddInput(it->first);
+        }
+        const std::vector<Extern>& externs = program_->Externs();
+        for (std::size_t i = 0; i < externs.size(); ++i) {
+            p.extern_names_.push_back(externs[i].name);
+        }
+
+        module_name_stack_->push_back(filename);
+        bool ok = p.Create(content.Data(), content.Size());
+        module_name_stack_->pop_back();
+        if (ok == false) {
+            error_code_ = p.error_code_; // TODO copy the error context
+            return std::shared_ptr<const CachedModule>();
+        }
+
+        module->program.reset(p.Release());
+        module->dependencies.insert(module->dependencies.end(), p.dependencies_.begin(), p.dependencies_.end());
+        return module;
+    }
+
+    int Parser::CloneSlot(int slot, const Program& from, std::vector<int> * slots) {
+        if ((*slots)[slot] < 0) {
+            // inputs and externs are shared, other variables are new slots.
+            const std::map<std::string, int>& inputs = from.Inputs();
+            for (std::map<std::string, int>::const_iterator it = inputs.begin(); it != inputs.end(); ++it) {
+                if (it->second == slot) {
+                    (*slots)[slot] = program_->Input(it->first);
+                    return (*slots)[slot];
+                }
+            }
+            const std::vector<Extern>& externs = from.Externs();
+            for (std::size_t i = 0; i < externs.size(); ++i) {
+                if (externs[i].slot == slot) {
+                    (*slots)[slot] = program_->Externs()[program_->AddExtern(externs[i].name)].slot;
+                    return (*slots)[slot];
+                }
+            }
+            (*slots)[slot] = program_->AllocateSlot(from.InitialValues()[slot]);
+        }
+        return (*slots)[slot];
+    }
+
+    const int * Parser::CloneSlots(const int * bound, std::size_t count, const Program& from, std::vector<int> * slots) {
+        int * copy = static_cast<int *>(GetArena().Allocate(count * sizeof(int)));
+        for (std::size_t i = 0; i < count; ++i) {
+            copy[i] = CloneSlot(bound[i], from, slots);
+        }
+        return copy;
+    }
+
+    void Parser::CloneModel(const void * model, const Program& from) {
+        for (std::size_t i = 0; i < from.models_.size(); ++i) {
+            if (from.models_[i].get() == model) {
+                program_->AddModel(from.models_[i]);
+                return;
+            }
+        }
+    }
+
+    Operator * Parser::Clone(const Operator * node, Module * module,
+                             const Program& from, std::vector<int> * slots) {
+        Arena& arena = GetArena();
+        Operator * copy = NULL;
+        switch (node->Type()) {
+        case Operator::OP_MODULE:
+            {
+                const Module * origin = static_cast<const Module *>(node);
+                module = new (arena) Module(program_, origin->GetDefault());
+                (*slots)[origin->DefaultSlot()] = module->DefaultSlot();
+                (*slots)[origin->ReturnSlot()] = module->ReturnSlot();
+                (*slots)[origin->ReturnedSlot()] = module->ReturnedSlot();
+                copy = module;
+            }
+            break;
+        case Operator::OP_NUM:
+            return new (arena) Num(static_cast<const Num *>(node)->Value());
+        case Operator::OP_VARIABLE:
+            return new (arena) Variable(CloneSlot(static_cast<const Variable *>(node)->Slot(), from, slots));
+        case Operator::OP_REFERENCE:
+            {
+                const Reference * ref = static_cast<const Reference *>(node);
+                copy = new (arena) Reference(module, CloneSlot(ref->Slot(), from, slots), ref->AssignType());
+            }
+            break;
+        case Operator::OP_ADD: copy = new (arena) Add(); break;
+        case Operator::OP_NEGATIVE: copy = new (arena) Negative(); break;
+        case Operator::OP_IF: copy = new (arena) If(); break;
+        case Operator::OP_OR: copy = new (arena) Or(); break;
+        case Operator::OP_AND: copy = new (arena) And(); break;
+        case Operator::OP_LESS: copy = new (arena) Less(); break;
+        case Operator::OP_LESS_EQUAL: copy = new (arena) LessEqual(); break;
+        case Operator::OP_GREATER: copy = new (arena) Greater(); break;
+        case Operator::OP_GREATER_EQUAL: copy = new (arena) GreaterEqual(); break;
+        case Operator::OP_EQUAL: copy = new (arena) Equal(); break;
+        case Operator::OP_NOT_EQUAL: copy = new (arena) NotEqual(); break;
+        case Operator::OP_DIV: copy = new (arena) Div(static_cast<const Div *>(node)->DefaultValue()); break;
+        case Operator::OP_MUL: copy = new (arena) Mul(); break;
+        case Operator::OP_MOD: copy = new (arena) Mod(); break;
+        case Operator::OP_NOT: copy = new (arena) Not(); break;
+        case Operator::OP_CALL: copy = new (arena) Call(static_cast<const Call *>(node)->GetFunction()); break;
+        case Operator::OP_LOGISTIC:
+            {
+                const Logistic * lr = static_cast<const Logistic *>(node);
+                const LinearModel * model = lr->Model();
+                CloneModel(model, from);
+                copy = new (arena) Logistic(model, CloneSlots(lr->Slots(), model->Size(), from, slots));
+            }
+            break;
+        case Operator::OP_ENSEMBLE:
+            {
+                const Ensemble * lambdamart = static_cast<const Ensemble *>(node);
+                const TreeEnsemble * model = lambdamart->Model();
+                CloneModel(model, from);
+                copy = new (arena) Ensemble(model, CloneSlots(lambdamart->Slots(), model->Features().size(), from, slots));
+            }
+            break;
+        case Operator::OP_EXTERNAL:
+            {
+                const External * origin = static_cast<const External *>(node);
+                int index = program_->AddExtern(from.Externs()[origin->Index()].name);
+                const Extern& e = program_->Externs()[index];
+                return new (arena) External(index, e.slot, e.resolved_slot);
+            }
+        }
+
+        const OperatorList& children = node->Children();
+        for (std::size_t i = 0; i < children.size(); ++i) {
+            copy->AddChild(arena, Clone(children[i], module, from, slots));
+        }
+        return copy;
+    }
+
+    void Parser::Mark(const char * begin) {
+        if (track_positions_ && error_code_ == 0 && ast_tree_->Children().empty() == false) {
+            Mark(ast_tree_->Children().back(), begin, current_token_.token_pos);
+        }
+    }
+
+    void Parser::Mark(const Operator * node, const char * begin, const char * end) {
+        if (track_positions_ && error_code_ == 0) {
+            // the spaces before the next token are not a part of 'node'.
+            while (end > begin && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\n')) {
+                --end;
+            }
+            program_->SetPosition(node, begin - source_, end - begin);
+        }
+    }
+
     void Parser::CreateNow() {
         time_t time = ::time(NULL);
         tokenizer_.NextToken(current_token_);
@@ -271,12 +676,12 @@ namespace ttl {
             return;
         }
 
-        Num * num = new Num(time);
-        ast_tree_->AddChild(num);
+        Num * num = new (GetArena()) Num(time);
+        ast_tree_->AddChild(GetArena(), num);
         tokenizer_.NextToken(current_token_);
     }
 
-    void Parser::CreateAssign(const std::string& name, double (*op)(double, double), bool check_rhs) {
+    void Parser::CreateAssign(int symbol, int assign_type) {
         tokenizer_.NextToken(current_token_);
         CreateValue();
         if (error_code_ != 0) {
@@ -289,102 +694,212 @@ namespace ttl {
             return;
         }
 
-        Reference * n = new Reference(ast_tree_, name, op, check_rhs);
-        n->AddChild(child);
-        ast_tree_->AddChild(n);
+        Reference * n = new (GetArena()) Reference(ast_tree_, CreateOrGetVariable(symbol), assign_type);
+        n->AddChild(GetArena(), child);
+        ast_tree_->AddChild(GetArena(), n);
         return;
     }
 
-    void Parser::CreateVariable(const std::string &name) {
-        double (*op)(double, double) = assign;
-        bool check_rhs = false;
+    void Parser::CreateVariable(int symbol) {
+        int assign_type = Reference::ASSIGN;
         tokenizer_.NextToken(current_token_);
         switch (current_token_.token_type) {
         case Tokenizer::TOKEN_ASSIGN:
             // do not need to check variable name is exists.
-            return CreateAssign(name, op, check_rhs);
+            return CreateAssign(symbol, assign_type);
         case Tokenizer::TOKEN_ADD_ASSIGN:
-            op = add;
+            assign_type = Reference::ADD_ASSIGN;
             break;
         case Tokenizer::TOKEN_SUB_ASSIGN:
-            op = sub;
+            assign_type = Reference::SUB_ASSIGN;
             break;
         case Tokenizer::TOKEN_MUL_ASSIGN:
-            op = mul;
+            assign_type = Reference::MUL_ASSIGN;
             break;
         case Tokenizer::TOKEN_DIV_ASSIGN:
-            op = div;
-            check_rhs = true;
+            assign_type = Reference::DIV_ASSIGN;
             break;
         case Tokenizer::TOKEN_MOD_ASSIGN:
-            op = mod;
-            check_rhs = true;
+            assign_type = Reference::MOD_ASSIGN;
             break;
         default:
             error_code_ = 4;
             return;
         }
 
-        double * variable = ast_tree_->GetVariable(name);
-        if (variable == NULL) {
+        if (GetVariable(symbol) < 0) {
             error_code_ = 4;
             return;
         }
 
-        return CreateAssign(name, op, check_rhs);
+        return CreateAssign(symbol, assign_type);
     }
 
     void Parser::CreateNum() {
+        // the source may not be terminated, so strtod reads a copy.
+        std::string text(current_token_.token_pos, current_token_.token_length);
         char * endptr = NULL;
-        double value = strtod(current_token_.token_pos, &endptr);
-        if (endptr != current_token_.token_pos + current_token_.token_length) {
+        double value = strtod(text.c_str(), &endptr);
+        if (endptr != text.c_str() + text.size()) {
             error_code_ = 1;
             return;
         }
 
-        Num * num = new Num(value);
-        ast_tree_->AddChild(num);
+        Num * num = new (GetArena()) Num(value);
+        ast_tree_->AddChild(GetArena(), num);
 
         tokenizer_.NextToken(current_token_);
     }
 
-    void Parser::CreateVariableValue(const std::string& name, double * variable) {
-        Variable * v = new Variable(variable);
-        ast_tree_->AddChild(v);
+    void Parser::CreateVariableValue(int slot) {
+        Variable * v = new (GetArena()) Variable(slot);
+        ast_tree_->AddChild(GetArena(), v);
         tokenizer_.NextToken(current_token_);
     }
 
-    void Parser::ProcessTokenName(const std::string& name) {
-        std::map<std::string, fn>::iterator processor = name_token_processors_.find(name);
-        if (processor != name_token_processors_.end()) {
-            fn f = processor->second;
+    void Parser::ProcessTokenName(int symbol) {
+        if ((std::size_t)symbol < processors_.size() && processors_[symbol] != NULL) {
+            fn f = processors_[symbol];
             return (this->*f)(); // named functions
         }
 
-        double * variable = ast_tree_->GetVariable(name);
-        if (variable != NULL) {
+        int slot = FindVariable(symbol);
+        if (slot >= 0) {
             // process variable value.
-            return CreateVariableValue(name, variable);
+            return CreateVariableValue(slot);
+        }
+
+        if ((std::size_t)symbol < externs_.size() && externs_[symbol] >= 0) {
+            return CreateExternal(externs_[symbol]);
+        }
+
+        // a variable hides a native function of the same name, so the
+        // scripts written before it was registered are read the same.
+        if ((std::size_t)symbol < functions_.size() && functions_[symbol] != NULL) {
+            return CreateCall(functions_[symbol]);
         }
 
         error_code_ = 4;
         return;
     }
 
-    void Parser::CreateAtom() {
-        switch (current_token_.token_type) {
-        case Tokenizer::TOKEN_NUM:
-            return CreateNum();
-        case Tokenizer::TOKEN_NAME:
-            {
-                std::string name(current_token_.token_pos, current_token_.token_length);
-                if (name == "if" || name == "return") {
+    void Parser::CreateExtern() {
+        // "extern a, b, c", visible in every module after it, like inputs.
+        do {
+            tokenizer_.NextToken(current_token_);
+            if (current_token_.token_type != Tokenizer::TOKEN_NAME) {
+                error_code_ = 1;
+                return;
+            }
+            int symbol = Symbol(current_token_);
+            std::string name(current_token_.token_pos, current_token_.token_length);
+            bool reserved = symbol <= SYMBOL_EXTERN ||
+                ((std::size_t)symbol < processors_.size() && processors_[symbol] != NULL);
+            bool input = (std::size_t)symbol < input_slots_.size() && input_slots_[symbol] >= 0;
+            if (reserved || input) {
+                error_code_ = 1;
+                return;
+            }
+
+            externs_.resize(std::max(externs_.size(), (std::size_t)symbol + 1), -1);
+            externs_[symbol] = program_->AddExtern(name);
+            tokenizer_.NextToken(current_token_);
+        } while (current_token_.token_type == Tokenizer::TOKEN_COMMA);
+    }
+
+    void Parser::CreateExternal(int index) {
+        const Extern& e = program_->Externs()[index];
+        ast_tree_->AddChild(GetArena(), new (GetArena()) External(index, e.slot, e.resolved_slot));
+        tokenizer_.NextToken(current_token_);
+    }
+
+    void Parser::CreateCall(const Function * function) {
+        tokenizer_.NextToken(current_token_);
+        if (current_token_.token_type != Tokenizer::TOKEN_LEFT_BANANA) {
+            error_code_ = 1;
+            return;
+        }
+
+        Call * call = new (GetArena()) Call(function);
+        tokenizer_.NextToken(current_token_);
+        while (current_token_.token_type != Tokenizer::TOKEN_RIGHT_BANANA) {
+            if (call->Children().size() > 0) {
+                if (current_token_.token_type != Tokenizer::TOKEN_COMMA) {
                     error_code_ = 1;
                     return;
                 }
+                tokenizer_.NextToken(current_token_);
+            }
+
+            if (call->Children().size() == (std::size_t)function->arity) {
+                error_code_ = 1; // too many arguments
+                return;
+            }
+            CreateValue();
+            if (error_code_ != 0) {
+                return;
+            }
+            Operator * arg = NULL;
+            if (ast_tree_->PopLastChild(&arg) == false) {
+                error_code_ = 1;
+                return;
+            }
+            call->AddChild(GetArena(), arg);
+        }
+
+        if (call->Children().size() != (std::size_t)function->arity) {
+            error_code_ = 1;
+            return;
+        }
+        ast_tree_->AddChild(GetArena(), call);
+        tokenizer_.NextToken(current_token_);
+    }
 
-                return ProcessTokenName(name);
+    int Parser::GetVariable(int symbol) const {
+        if (symbol == SYMBOL_DEFAULT) {
+            return ast_tree_->DefaultSlot();
+        } else if (symbol == SYMBOL_RETURN) {
+            return ast_tree_->ReturnSlot();
+        }
+
+        if ((std::size_t)symbol < bindings_.size() && bindings_[symbol].scope == scope_) {
+            return bindings_[symbol].slot;
+        }
+        return -1;
+    }
+
+    int Parser::FindVariable(int symbol) const {
+        int slot = GetVariable(symbol);
+        if (slot < 0 && (std::size_t)symbol < input_slots_.size()) {
+            slot = input_slots_[symbol];
+        }
+        return slot;
+    }
+
+    int Parser::CreateOrGetVariable(int symbol) {
+        int slot = GetVariable(symbol);
+        if (slot < 0) {
+            slot = program_->AllocateSlot(ast_tree_->GetDefault());
+            if (bindings_.size() <= (std::size_t)symbol) {
+                Binding none = { 0, -1 };
+                bindings_.resize(symbol + 1, none);
+            }
+            if (bindings_[symbol].scope != 0) {
+                hidden_.push_back(std::make_pair(symbol, bindings_[symbol]));
             }
+            bindings_[symbol].scope = scope_;
+            bindings_[symbol].slot = slot;
+        }
+        return slot;
+    }
+
+    void Parser::CreateAtom() {
+        switch (current_token_.token_type) {
+        case Tokenizer::TOKEN_NUM:
+            return CreateNum();
+        case Tokenizer::TOKEN_NAME:
+        case Tokenizer::TOKEN_ELSE: // not a keyword out of "if"
+            return ProcessTokenName(Symbol(current_token_));
         case Tokenizer::TOKEN_LEFT_BANANA:
             {
                 tokenizer_.NextToken(current_token_);
@@ -409,6 +924,7 @@ namespace ttl {
             return CreateAtom();
         }
 
+        const char * begin = current_token_.token_pos;
         tokenizer_.NextToken(current_token_);
         CreateAtom();
         if (error_code_ != 0) {
@@ -421,9 +937,10 @@ namespace ttl {
             return;
         }
 
-        Not * not_op = new Not();
-        not_op->AddChild(atom);
-        ast_tree_->AddChild(not_op);
+        Not * not_op = new (GetArena()) Not();
+        not_op->AddChild(GetArena(), atom);
+        ast_tree_->AddChild(GetArena(), not_op);
+        Mark(begin);
     }
 
     bool Parser::PopTwoFactors(Operator ** lhs, Operator ** rhs) {
@@ -434,7 +951,6 @@ namespace ttl {
 
         if (ast_tree_->PopLastChild(lhs) == false) {
             error_code_ = 1;
-            delete *rhs;
             return false;
         }
         return true;
@@ -455,10 +971,10 @@ namespace ttl {
         }
 
         Operator * op = (this->*operator_allocator)();
-        op->AddChild(lhs);
-        op->AddChild(rhs);
+        op->AddChild(GetArena(), lhs);
+        op->AddChild(GetArena(), rhs);
 
-        ast_tree_->AddChild(op);
+        ast_tree_->AddChild(GetArena(), op);
 
         switch (current_token_.token_type) {
         case Tokenizer::TOKEN_DIV: return CreateDiv();
@@ -470,7 +986,7 @@ namespace ttl {
     }
 
     Operator * Parser::AllocateDiv() {
-        return new Div(ast_tree_->GetDefault());
+        return new (GetArena()) Div(ast_tree_->GetDefault());
     }
 
     void Parser::CreateDiv() {
@@ -478,7 +994,7 @@ namespace ttl {
     }
 
     Operator * Parser::AllocateMul() {
-        return new Mul();
+        return new (GetArena()) Mul();
     }
 
     void Parser::CreateMul() {
@@ -486,7 +1002,7 @@ namespace ttl {
     }
 
     Operator * Parser::AllocateMod() {
-        return new Mod();
+        return new (GetArena()) Mod();
     }
 
     void Parser::CreateMod() {
@@ -494,18 +1010,20 @@ namespace ttl {
     }
 
     void Parser::CreateFactor() {
+        const char * begin = current_token_.token_pos;
         CreateRotator();
         if (error_code_ != 0) {
             return;
         }
 
         switch (current_token_.token_type) {
-        case Tokenizer::TOKEN_DIV: return CreateDiv();
-        case Tokenizer::TOKEN_MUL: return CreateMul();
-        case Tokenizer::TOKEN_MOD: return CreateMod();
+        case Tokenizer::TOKEN_DIV: CreateDiv(); break;
+        case Tokenizer::TOKEN_MUL: CreateMul(); break;
+        case Tokenizer::TOKEN_MOD: CreateMod(); break;
         default:
             return;
         }
+        Mark(begin);
     }
 
     void Parser::CreateNegative() {
@@ -515,12 +1033,13 @@ namespace ttl {
             return;
         }
 
-        Negative * neg = new Negative();
-        neg->AddChild(expr);
-        ast_tree_->AddChild(neg);
+        Negative * neg = new (GetArena()) Negative();
+        neg->AddChild(GetArena(), expr);
+        ast_tree_->AddChild(GetArena(), neg);
     }
 
     void Parser::CreateSymbol() {
+        const char * begin = current_token_.token_pos;
         bool negative = false;
         if (current_token_.token_type == Tokenizer::TOKEN_ADD ||
             current_token_.token_type == Tokenizer::TOKEN_SUB) {
@@ -544,14 +1063,13 @@ namespace ttl {
             return;
         }
 
-        Operator * add = new Add();
+        Operator * add = new (GetArena()) Add();
         Operator * addend = NULL;
         if (ast_tree_->PopLastChild(&addend) == false) {
             error_code_ = 1;
-            delete add;
             return;
         }
-        add->AddChild(addend);
+        add->AddChild(GetArena(), addend);
 
         while (current_token_.token_type == Tokenizer::TOKEN_ADD ||
                current_token_.token_type == Tokenizer::TOKEN_SUB) {
@@ -560,7 +1078,6 @@ namespace ttl {
             tokenizer_.NextToken(current_token_);
             CreateFactor();
             if (error_code_ != 0) {
-                delete add;
                 return;
             }
 
@@ -570,15 +1087,16 @@ namespace ttl {
 
             if (ast_tree_->PopLastChild(&addend) == false) {
                 error_code_ = 1;
-                delete add;
                 return;
             }
-            add->AddChild(addend);
+            add->AddChild(GetArena(), addend);
         }
-        ast_tree_->AddChild(add);
+        ast_tree_->AddChild(GetArena(), add);
+        Mark(begin);
     }
 
     void Parser::CreateCmp() {
+        const char * begin = current_token_.token_pos;
         CreateSymbol();
         if (error_code_ != 0) {
             return;
@@ -592,115 +1110,111 @@ namespace ttl {
 
         Operator * cmp = NULL;
         switch (current_token_.token_type) {
-        case Tokenizer::TOKEN_LT: cmp = new Less(); break;
-        case Tokenizer::TOKEN_LE: cmp = new LessEqual(); break;
-        case Tokenizer::TOKEN_GT: cmp = new Greater(); break;
-        case Tokenizer::TOKEN_GE: cmp = new GreaterEqual(); break;
-        case Tokenizer::TOKEN_EQ: cmp = new Equal(); break;
-        case Tokenizer::TOKEN_NEQ: cmp = new NotEqual(); break;
+        case Tokenizer::TOKEN_LT: cmp = new (GetArena()) Less(); break;
+        case Tokenizer::TOKEN_LE: cmp = new (GetArena()) LessEqual(); break;
+        case Tokenizer::TOKEN_GT: cmp = new (GetArena()) Greater(); break;
+        case Tokenizer::TOKEN_GE: cmp = new (GetArena()) GreaterEqual(); break;
+        case Tokenizer::TOKEN_EQ: cmp = new (GetArena()) Equal(); break;
+        case Tokenizer::TOKEN_NEQ: cmp = new (GetArena()) NotEqual(); break;
         default:
-            ast_tree_->AddChild(symbol);
+            ast_tree_->AddChild(GetArena(), symbol);
             return;
         }
 
-        cmp->AddChild(symbol);
+        cmp->AddChild(GetArena(), symbol);
 
         tokenizer_.NextToken(current_token_);
         CreateSymbol();
         if (error_code_ != 0) {
-            delete cmp;
             return;
         }
 
         if (ast_tree_->PopLastChild(&symbol) == false) {
             error_code_ = 1;
-            delete cmp;
             return;
         }
 
-        cmp->AddChild(symbol);
-        ast_tree_->AddChild(cmp);
+        cmp->AddChild(GetArena(), symbol);
+        ast_tree_->AddChild(GetArena(), cmp);
+        Mark(begin);
     }
 
     void Parser::CreateExpr() {
+        const char * begin = current_token_.token_pos;
         CreateCmp();
         if (error_code_ != 0 || current_token_.token_type != Tokenizer::TOKEN_AND) {
             return;
         }
 
-        And * and_operator = new And();
+        And * and_operator = new (GetArena()) And();
         Operator * cond = NULL;
         if (ast_tree_->PopLastChild(&cond) == false) {
             error_code_ = 1;
-            delete and_operator;
             return;
         }
-        and_operator->AddChild(cond);
+        and_operator->AddChild(GetArena(), cond);
 
         while (current_token_.token_type == Tokenizer::TOKEN_AND) {
             tokenizer_.NextToken(current_token_);
             CreateCmp();
             if (error_code_ != 0) {
-                delete and_operator;
                 return;
             }
 
             if (ast_tree_->PopLastChild(&cond) == false) {
                 error_code_ = 1;
-                delete and_operator;
                 return;
             }
-            and_operator->AddChild(cond);
+            and_operator->AddChild(GetArena(), cond);
         }
-        ast_tree_->AddChild(and_operator);
+        ast_tree_->AddChild(GetArena(), and_operator);
+        Mark(begin);
     }
 
     void Parser::CreateValue() {
+        const char * begin = current_token_.token_pos;
         CreateExpr();
         if (error_code_ != 0 || current_token_.token_type != Tokenizer::TOKEN_OR) {
             return;
         }
 
-        Or * or_operator = new Or();
+        Or * or_operator = new (GetArena()) Or();
         Operator * cond = NULL;
         if (ast_tree_->PopLastChild(&cond) == false) {
             error_code_ = 1;
-            delete or_operator;
             return;
         }
-        or_operator->AddChild(cond);
+        or_operator->AddChild(GetArena(), cond);
 
         while (current_token_.token_type == Tokenizer::TOKEN_OR) { // more conditions
             tokenizer_.NextToken(current_token_);
             CreateExpr();
             if (error_code_ != 0) {
-                delete or_operator;
                 return;
             }
 
             if (ast_tree_->PopLastChild(&cond) == false) {
                 error_code_ = 1;
-                delete or_operator;
                 return;
             }
-            or_operator->AddChild(cond);
+            or_operator->AddChild(GetArena(), cond);
         }
-        ast_tree_->AddChild(or_operator);
+        ast_tree_->AddChild(GetArena(), or_operator);
+        Mark(begin);
     }
 
     void Parser::CreateSentence() {
         switch (current_token_.token_type) {
         case Tokenizer::TOKEN_EOL:
             return;
+        case Tokenizer::TOKEN_IF:
+            return CreateIf();
+        case Tokenizer::TOKEN_RETURN:
+            return CreateReturn();
         case Tokenizer::TOKEN_NAME:
+        case Tokenizer::TOKEN_ELSE: // not a keyword out of "if"
             {
-                std::string name(current_token_.token_pos, current_token_.token_length);
-                if (name == "if") {
-                    return CreateIf();
-                } else if (name == "return") {
-                    return CreateReturn();
-                }
-
+                int symbol = Symbol(current_token_);
                 Token t;
                 tokenizer_.NextToken(t);
                 switch (t.token_type) {
@@ -711,11 +1225,14 @@ namespace ttl {
                 case Tokenizer::TOKEN_MUL_ASSIGN:   // go through
                 case Tokenizer::TOKEN_MOD_ASSIGN:   // go through
                     tokenizer_.PushBack(t);
-                    return CreateVariable(name);
+                    return CreateVariable(symbol);
                 default:
                     tokenizer_.PushBack(t);
                     break;
                 }
+                if (symbol == SYMBOL_EXTERN && t.token_type == Tokenizer::TOKEN_NAME) {
+                    return CreateExtern();
+                }
                 return CreateValue();
             }
         default:
@@ -13,8 +13,14 @@
 #include <istream>
 #include <list>
 #include <map>
+#include <ostream>
 #include <string>
+#include <vector>
+#include "cache.hh"
+#include "function.hh"
 #include "operator.hh"
+#include "program.hh"
+#include "symbols.hh"
 #include "tokenizer.hh"
 
 namespace ttl {
@@ -26,29 +32,58 @@ namespace ttl {
 
         static bool Init();
 
+        // declare an input variable, which is readable in every module.
+        // must be called before Create().
+        void AddInput(const std::string& name);
+
         // parse code and build ast, return true if no error occurs.
         bool Create(const char * code);
+        // 'code' needs not be terminated by '\0', it is read by Create() and
+        // ErrorContext() only, the program does not refer to it.
+        bool Create(const char * code, std::size_t length);
+
+        // simplify the ast after Create(), default true. if 'dump' is not
+        // NULL, the ast is printed to it before and after that.
+        void SetOptimize(bool optimize, std::ostream * dump = NULL);
 
+        // keep the position in the code of the sentences, branches and
+        // operators, see Program::Position(). default false, the nodes of
+        // included files have no positions.
+        void SetTrackPositions(bool track) { track_positions_ = track; }
+
+        // evaluate once with a fresh context owned by the parser.
         double Evaluate();
 
+        // the compiled program, still owned by the parser.
+        const Program * GetProgram() const;
+
+        // take the ownership of the compiled program, the parser can not
+        // evaluate after that.
+        Program * Release();
+
+        // the files included, directly or not, by Create(), as they were
+        // read.
+        const std::vector<FileStamp>& Dependencies() const { return dependencies_; }
+
         // return error message if Init() failed, or ""
         const char * ErrorMsg() const;
 
         void ErrorContext(std::string& msg) const;
 
     private:
-        Parser(std::list<std::string> * module_name_stack);
+        Parser(std::list<std::string> * module_name_stack, Program * program);
+        void Optimize();
         void CreateModule(long end_type);
         void CreateSentence();
         Module * CreateTorusModule(); // well, different style, but less code
         void CreateIf();
         void CreateReturn();
         void CreateNow(); // return the number of seconds since epoch
-        void CreateAssign(const std::string& name, double (*op)(double, double), bool check_rhs);
+        void CreateAssign(int symbol, int assign_type);
         // process variable creation and calculation.
-        void CreateVariable(const std::string& name);
+        void CreateVariable(int symbol);
         // process variable value.
-        void CreateVariableValue(const std::string& name, double * variable);
+        void CreateVariableValue(int slot);
         void CreateNum();
         void CreateAtom();
         void CreateRotator();
@@ -62,9 +97,38 @@ namespace ttl {
         void CreateExpr();
         void CreateValue();
         void CreateInclude();
+        void CreateLr(); // "lr(path)", a linear model, see LinearModel
+        void CreateLambdamart(); // "lambdamart(path)", see TreeEnsemble
+        void CreateCall(const Function * function); // "name(a, b, ...)"
+        void CreateExtern(); // "extern a, b", inputs filled by a Resolver
+        void CreateExternal(int index);
+        // the slots of the variables of a model, NULL if one is not defined.
+        // the externs among them are put to 'externs', to be resolved by
+        // the node of the model.
+        int * BindFeatures(const std::vector<std::string>& features, std::vector<Operator *> * externs);
+
+        // read "(path)", the current token is ")" then.
+        bool ReadPath(std::string * path);
 
         bool NestedIncluded(const std::string& filename);
 
+        // parse 'filename' as a program of its own, with the same inputs.
+        std::shared_ptr<const CachedModule> ParseInclude(const std::string& filename);
+
+        // copy the nodes of 'node' of program 'from' into program_, the
+        // slots of 'from' are mapped to slots of program_ by 'slots'.
+        Operator * Clone(const Operator * node, Module * module,
+                         const Program& from, std::vector<int> * slots);
+        int CloneSlot(int slot, const Program& from, std::vector<int> * slots);
+        const int * CloneSlots(const int * bound, std::size_t count, const Program& from, std::vector<int> * slots);
+        // keep the model of a cloned node, as 'from' does.
+        void CloneModel(const void * model, const Program& from);
+
+        // if tracking positions, keep the code of the last node of the
+        // module, from 'begin' to the current token, or of 'node'.
+        void Mark(const char * begin);
+        void Mark(const Operator * node, const char * begin, const char * end);
+
     private:
 
         // following are auxiliary methods for "*" "/" and "%"
@@ -78,16 +142,67 @@ namespace ttl {
         Operator * AllocateMod();
 
         // following are auxiliary methods for TOKNE_NAME
-        void ProcessTokenName(const std::string& name);
+        void ProcessTokenName(int symbol);
+        int Symbol(const Token& token) {
+            return symbols_.Intern(token.token_pos, token.token_length);
+        }
+
+        // following are auxiliary methods for variable names, the names
+        // are resolved to slots of the program while parsing.
+        int GetVariable(int symbol) const; // the current module only
+        int FindVariable(int symbol) const; // and the inputs
+        int CreateOrGetVariable(int symbol);
+
+        // the nodes are allocated in the arena of the program.
+        Arena& GetArena() { return program_->GetArena(); }
 
     private:
+        typedef void (Parser::*fn)();
+
+        Program * program_;
+        bool owns_program_; // false for parsers of "include"
+        Context * context_; // for Evaluate() only
+        std::vector<std::string> inputs_;
+        bool optimize_;
+        std::ostream * dump_;
+        bool track_positions_;
+        const char * source_; // of Create(), for the positions
+
         Module * ast_tree_;
 
+        // the files included, directly or not, while parsing.
+        std::vector<FileStamp> dependencies_;
+
+        // the names of the script, interned while parsing; "default",
+        // "return" and "extern" are the first symbols, the named functions
+        // follow.
+        const static int SYMBOL_DEFAULT = 0;
+        const static int SYMBOL_RETURN = 1;
+        const static int SYMBOL_EXTERN = 2;
+        SymbolTable symbols_;
+        std::vector<fn> processors_;   // by symbol, NULL if not a function
+        std::vector<const Function *> functions_; // by symbol, NULL if not a native one
+        std::vector<int> input_slots_; // by symbol, -1 if not an input
+        std::vector<int> externs_;     // by symbol, the index in Program::Externs(), or -1
+        std::vector<std::string> extern_names_; // declared before Create(), by "include"
+
+        // the variables of the modules being parsed, by symbol. a binding
+        // is visible in the module of its scope only, inner modules can not
+        // see the variables of outer ones. the bindings hidden by an inner
+        // module are restored when it ends.
+        struct Binding {
+            int scope;
+            int slot;
+        };
+        std::vector<Binding> bindings_;
+        std::vector<std::pair<int, Binding> > hidden_;
+        int scope_;  // of 'ast_tree_'
+        int scopes_; // the last scope number
+
         Token current_token_;
         Tokenizer tokenizer_;
         std::size_t error_code_;
 
-        typedef void (Parser::*fn)();
         static std::map<std::string, fn> name_token_processors_;
 
         // for module nested "include" check;
@@ -0,0 +1,371 @@
+/**
+ * profiler.cc - count and time every node of a program
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include <algorithm>
+#include <string>
+#include "profiler.hh"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define TTL_X86 1
+#endif
+
+namespace ttl {
+
+    static inline unsigned long long Ticks() {
+#ifdef TTL_X86
+        return __rdtsc();
+#else
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+    }
+
+    static double Nanoseconds() {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec * 1e9 + ts.tv_nsec;
+    }
+
+    // numbers and variables are too cheap to time.
+    static inline bool Timed(int type) {
+        return type != Operator::OP_NUM && type != Operator::OP_VARIABLE;
+    }
+
+    Profiler::Profiler(const Program& program)
+        : program_(program),
+          nodes_(),
+          children_(),
+          counters_(),
+          indices_(),
+          evaluations_(0),
+          ticks_(0),
+          nanoseconds_(0) {
+        if (program_.Root() != NULL) {
+            Add(program_.Root(), -1);
+        }
+        Counter zero = { 0, 0, 0 };
+        counters_.resize(nodes_.size(), zero);
+    }
+
+    int Profiler::Add(const Operator * op, int owner) {
+        int index = nodes_.size();
+        Node node;
+        node.op = op;
+        node.type = op->Type();
+        node.owner = program_.Position(op, &node.range) ? index : owner;
+        nodes_.push_back(node);
+        indices_[op] = index;
+
+        // the children are numbered after all of them are added, so the
+        // indices of the children of a node are contiguous.
+        const OperatorList& children = op->Children();
+        std::vector<int> indices(children.size());
+        for (std::size_t i = 0; i < children.size(); ++i) {
+            indices[i] = Add(children[i], nodes_[index].owner);
+        }
+        nodes_[index].first = children_.size();
+        nodes_[index].size = indices.size();
+        children_.insert(children_.end(), indices.begin(), indices.end());
+        return index;
+    }
+
+    double Profiler::Evaluate(Context& context) {
+        if (nodes_.empty()) {
+            return 0;
+        }
+
+        double start = Nanoseconds();
+        unsigned long long ticks = Ticks();
+        double value = Evaluate(0, context);
+        ticks_ += Ticks() - ticks;
+        nanoseconds_ += Nanoseconds() - start;
+        ++evaluations_;
+        return value;
+    }
+
+    double Profiler::Evaluate(int index, Context& context) {
+        const Node& node = nodes_[index];
+        Counter& counter = counters_[index];
+        ++counter.count;
+        double value;
+        if (Timed(node.type)) {
+            unsigned long long start = Ticks();
+            value = Run(node, context);
+            counter.ticks += Ticks() - start;
+        } else {
+            value = Run(node, context);
+        }
+        if (value != 0) {
+            ++counter.truths;
+        }
+        return value;
+    }
+
+    // following are the semantics of Operator::Evaluate of every node.
+    double Profiler::Run(const Node& node, Context& context) {
+        const int * child = node.size == 0 ? NULL : &children_[node.first];
+        switch (node.type) {
+        case Operator::OP_MODULE:
+            {
+                const Module * module = static_cast<const Module *>(node.op);
+                double value = context.Get(module->DefaultSlot());
+                for (std::size_t i = 0; i < node.size && context.Returned(module->ReturnedSlot()) == false; ++i) {
+                    value = Evaluate(child[i], context);
+                }
+                return context.Returned(module->ReturnedSlot()) ? context.Get(module->ReturnSlot()) : value;
+            }
+        case Operator::OP_NUM:
+            return static_cast<const Num *>(node.op)->Value();
+        case Operator::OP_VARIABLE:
+            return context.Get(static_cast<const Variable *>(node.op)->Slot());
+        case Operator::OP_EXTERNAL:
+            return static_cast<const External *>(node.op)->Evaluate(context);
+        case Operator::OP_REFERENCE:
+            {
+                static double (* const ops[])(double, double) = { assign, add, sub, mul, div, mod };
+                const Reference * ref = static_cast<const Reference *>(node.op);
+                int slot = ref->Slot();
+                if (ref->IsReturn()) {
+                    context.Return(ref->ReturnedSlot(), slot, Evaluate(child[0], context));
+                } else {
+                    bool check_rhs = ref->AssignType() == Reference::DIV_ASSIGN ||
+                                     ref->AssignType() == Reference::MOD_ASSIGN;
+                    double lhs = context.Get(slot);
+                    double rhs = Evaluate(child[0], context);
+                    context.Set(slot, (check_rhs && rhs == 0) ? context.Get(ref->DefaultSlot())
+                                                              : ops[ref->AssignType()](lhs, rhs));
+                }
+                return context.Get(slot);
+            }
+        case Operator::OP_ADD:
+            {
+                double value = 0.0;
+                for (std::size_t i = 0; i < node.size; ++i) {
+                    value += Evaluate(child[i], context);
+                }
+                return value;
+            }
+        case Operator::OP_NEGATIVE:
+            return - Evaluate(child[0], context);
+        case Operator::OP_IF:
+            {
+                std::size_t i = 0;
+                for (i = 0; i + 1 < node.size; i += 2) {
+                    if (Evaluate(child[i], context)) {
+                        return Evaluate(child[i + 1], context);
+                    }
+                }
+                return i + 1 == node.size ? Evaluate(child[i], context) : 0;
+            }
+        case Operator::OP_OR:
+            for (std::size_t i = 0; i < node.size; ++i) {
+                if (Evaluate(child[i], context) != 0) {
+                    return (double)true;
+                }
+            }
+            return (double)false;
+        case Operator::OP_AND:
+            for (std::size_t i = 0; i < node.size; ++i) {
+                if (Evaluate(child[i], context) == 0) {
+                    return (double)false;
+                }
+            }
+            return (double)true;
+        case Operator::OP_LESS:
+        case Operator::OP_LESS_EQUAL:
+        case Operator::OP_GREATER:
+        case Operator::OP_GREATER_EQUAL:
+        case Operator::OP_EQUAL:
+        case Operator::OP_NOT_EQUAL:
+            {
+                double lhs = Evaluate(child[0], context);
+                double rhs = Evaluate(child[1], context);
+                switch (node.type) {
+                case Operator::OP_LESS: return (double)(lhs < rhs);
+                case Operator::OP_LESS_EQUAL: return (double)(lhs <= rhs);
+                case Operator::OP_GREATER: return (double)(lhs > rhs);
+                case Operator::OP_GREATER_EQUAL: return (double)(lhs >= rhs);
+                case Operator::OP_EQUAL: return (double)(lhs == rhs);
+                default: return (double)(lhs != rhs);
+                }
+            }
+        case Operator::OP_DIV:
+            {
+                double divisor = Evaluate(child[1], context);
+                if (divisor == 0) {
+                    double default_value = static_cast<const Div *>(node.op)->DefaultValue();
+                    std::cerr << "Divided by zero. Return default value "
+                              << default_value << "." << std::endl;
+                    return default_value;
+                }
+                return Evaluate(child[0], context) / divisor;
+            }
+        case Operator::OP_MUL:
+            {
+                double lhs = Evaluate(child[0], context);
+                return lhs * Evaluate(child[1], context);
+            }
+        case Operator::OP_MOD:
+            {
+                double lhs = Evaluate(child[0], context);
+                return (long long)lhs % (long long)Evaluate(child[1], context);
+            }
+        case Operator::OP_NOT:
+            return !Evaluate(child[0], context);
+        case Operator::OP_LOGISTIC:
+        case Operator::OP_ENSEMBLE:
+            return static_cast<const ModelOperator *>(node.op)->Evaluate(context);
+        case Operator::OP_CALL:
+            {
+                double args[Function::MAX_ARITY];
+                for (std::size_t i = 0; i < node.size; ++i) {
+                    args[i] = Evaluate(child[i], context);
+                }
+                return static_cast<const Call *>(node.op)->GetFunction()->scalar(args);
+            }
+        }
+        return 0;
+    }
+
+    bool Profiler::Find(const Operator * node, Statistics * statistics) const {
+        std::map<const Operator *, int>::const_iterator it = indices_.find(node);
+        if (it == indices_.end()) {
+            return false;
+        }
+        const Counter& counter = counters_[it->second];
+        statistics->runs = counter.count;
+        statistics->truths = counter.truths;
+        statistics->ticks = counter.ticks;
+        return true;
+    }
+
+    void Profiler::Merge(const Profiler& other) {
+        for (std::size_t i = 0; i < counters_.size() && i < other.counters_.size(); ++i) {
+            counters_[i].count += other.counters_[i].count;
+            counters_[i].truths += other.counters_[i].truths;
+            counters_[i].ticks += other.counters_[i].ticks;
+        }
+        evaluations_ += other.evaluations_;
+        ticks_ += other.ticks_;
+        nanoseconds_ += other.nanoseconds_;
+    }
+
+    // the code of 'range' on one line, at most 'width' characters.
+    static std::string Excerpt(const char * source, const SourceRange& range, std::size_t width) {
+        std::string text;
+        for (int i = 0; i < range.length; ++i) {
+            char c = source[range.offset + i];
+            if (c == '\n' || c == '\t' || c == ' ') {
+                if (text.empty() == false && text[text.size() - 1] != ' ') {
+                    text += ' ';
+                }
+            } else {
+                text += c;
+            }
+        }
+        if (text.size() > width) {
+            text.resize(width - 3);
+            text += "...";
+        }
+        return text;
+    }
+
+    void Profiler::Report(const char * source, std::size_t length, std::ostream& out) const {
+        std::vector<std::size_t> lines(1, 0); // the offsets of the lines
+        for (std::size_t i = 0; i < length; ++i) {
+            if (source[i] == '\n' && i + 1 < length) {
+                lines.push_back(i + 1);
+            }
+        }
+
+        // the time of a node without its timed children, on the line of
+        // its owner.
+        std::vector<bool> code(lines.size(), false); // with a node
+        std::vector<unsigned long long> runs(lines.size(), 0);
+        std::vector<unsigned long long> ticks(lines.size(), 0);
+        std::vector<int> line_of(nodes_.size(), -1);
+        for (std::size_t i = 0; i < nodes_.size(); ++i) {
+            const Node& node = nodes_[i];
+            if (node.owner == (int)i) {
+                line_of[i] = std::upper_bound(lines.begin(), lines.end(), (std::size_t)node.range.offset)
+                             - lines.begin() - 1;
+                runs[line_of[i]] = std::max(runs[line_of[i]], counters_[i].count);
+                code[line_of[i]] = true;
+            }
+
+            unsigned long long children = 0;
+            for (std::size_t c = 0; c < node.size; ++c) {
+                children += counters_[children_[node.first + c]].ticks;
+            }
+            unsigned long long self = counters_[i].ticks > children ? counters_[i].ticks - children : 0;
+            if (node.owner >= 0) {
+                ticks[line_of[node.owner]] += self;
+            }
+        }
+
+        double evaluations = evaluations_ > 0 ? evaluations_ : 1;
+        double ns_per_tick = ticks_ > 0 ? nanoseconds_ / ticks_ : 0;
+        double total = ticks_ > 0 ? ticks_ : 1;
+        char buffer[128];
+
+        snprintf(buffer, sizeof(buffer), "profile: %zu evaluations, %.1f ns/evaluation (profiled)",
+                 evaluations_, nanoseconds_ / evaluations);
+        out << buffer << std::endl;
+        snprintf(buffer, sizeof(buffer), "%6s %12s %7s %10s |", "line", "runs", "time", "ns/eval");
+        out << buffer << " code" << std::endl;
+        for (std::size_t i = 0; i < lines.size(); ++i) {
+            std::size_t end = i + 1 < lines.size() ? lines[i + 1] - 1 : length;
+            while (end > lines[i] && (source[end - 1] == '\n' || source[end - 1] == '\r')) {
+                --end;
+            }
+            std::string text(source + lines[i], end - lines[i]);
+            if (code[i] == false) {
+                snprintf(buffer, sizeof(buffer), "%6zu %12s %7s %10s |", i + 1, "", "", "");
+            } else {
+                snprintf(buffer, sizeof(buffer), "%6zu %12llu %6.1f%% %10.1f |", i + 1, runs[i],
+                         ticks[i] * 100 / total, ticks[i] * ns_per_tick / evaluations);
+            }
+            out << buffer << " " << text << std::endl;
+        }
+
+        // the nodes which take the most time, with their children.
+        std::vector<std::pair<unsigned long long, int> > hot;
+        for (std::size_t i = 0; i < nodes_.size(); ++i) {
+            if (nodes_[i].owner == (int)i && counters_[i].ticks > 0) {
+                hot.push_back(std::make_pair(counters_[i].ticks, (int)i));
+            }
+        }
+        std::sort(hot.rbegin(), hot.rend());
+        if (hot.size() > 10) {
+            hot.resize(10);
+        }
+        if (hot.empty()) {
+            return;
+        }
+
+        out << "hot nodes:" << std::endl;
+        snprintf(buffer, sizeof(buffer), "%10s %12s %7s %10s |", "line:col", "runs", "time", "ns/eval");
+        out << buffer << " code" << std::endl;
+        for (std::size_t i = 0; i < hot.size(); ++i) {
+            const Node& node = nodes_[hot[i].second];
+            int line = line_of[hot[i].second];
+            char position[32];
+            snprintf(position, sizeof(position), "%d:%d", line + 1, (int)(node.range.offset - lines[line] + 1));
+            snprintf(buffer, sizeof(buffer), "%10s %12llu %6.1f%% %10.1f |", position,
+                     counters_[hot[i].second].count, hot[i].first * 100 / total,
+                     hot[i].first * ns_per_tick / evaluations);
+            out << buffer << " " << Excerpt(source, node.range, 60) << std::endl;
+        }
+    }
+
+} // ttl
@@ -0,0 +1,105 @@
+/**
+ * profiler.hh - count and time every node of a program
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#ifndef TTL_PROFILER_H
+#define TTL_PROFILER_H
+
+#include <cstddef>
+#include <map>
+#include <ostream>
+#include <vector>
+#include "operator.hh"
+#include "program.hh"
+
+namespace ttl {
+
+    /**
+     * evaluate a program like the tree walker, counting how often every
+     * node runs and how long it takes.
+     *
+     * NOTE:
+     *     0. the profiler is an engine of its own, the other engines and
+     *        the nodes are not instrumented, so they cost nothing more when
+     *        no profiler is used;
+     *     1. the result, and the "Divided by zero" messages, are the same
+     *        as Program::Evaluate;
+     *     2. a node is timed with the cycle counter (the monotonic clock
+     *        out of x86), numbers and variables are counted only, their
+     *        time is a part of their parent. the timing adds some cycles to
+     *        every node, so compare the nodes, not the total, with the
+     *        time of the other engines;
+     *     3. Report() needs the positions of the nodes, parse with
+     *        Parser::SetTrackPositions(true). a node without position, like
+     *        the nodes of an included file, is reported as a part of its
+     *        nearest ancestor which has one;
+     *     4. one profiler per thread, Merge() adds up the counters.
+     */
+    class Profiler {
+    public:
+        explicit Profiler(const Program& program);
+
+        double Evaluate(Context& context);
+
+        // add the counters of 'other', a profiler of the same program.
+        void Merge(const Profiler& other);
+
+        std::size_t Evaluations() const { return evaluations_; }
+
+        struct Statistics {
+            unsigned long long runs;
+            unsigned long long truths; // runs with a result != 0
+            unsigned long long ticks;  // with the children, 0 if not timed
+        };
+
+        // the counters of 'node', false if it is not a node of the program.
+        bool Find(const Operator * node, Statistics * statistics) const;
+
+        // print 'source' (the code given to Parser::Create) annotated, per
+        // line, with the runs and the time of the nodes on it, followed by
+        // the nodes which take the most time.
+        void Report(const char * source, std::size_t length, std::ostream& out) const;
+
+    private:
+        Profiler(const Profiler&);
+        Profiler& operator=(const Profiler&);
+
+        struct Node {
+            const Operator * op;
+            int type;
+            std::size_t first; // of the children in 'children_'
+            std::size_t size;
+            int owner;         // the nearest node with a position, or -1
+            SourceRange range; // if owner is this node
+        };
+
+        struct Counter {
+            unsigned long long count;
+            unsigned long long truths;
+            unsigned long long ticks; // with the children
+        };
+
+        int Add(const Operator * op, int owner);
+        double Evaluate(int index, Context& context);
+        double Run(const Node& node, Context& context);
+
+    private:
+        const Program& program_;
+        std::vector<Node> nodes_;    // in pre-order, the root first
+        std::vector<int> children_;
+        std::vector<Counter> counters_;
+        std::map<const Operator *, int> indices_; // of 'nodes_'
+
+        std::size_t evaluations_;
+        unsigned long long ticks_;   // of the evaluations
+        double nanoseconds_;         // of the evaluations, to convert ticks
+    };
+
+} // ttl
+
+#endif
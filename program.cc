@@ -0,0 +1,202 @@
+/**
+ * program.cc - compiled program and evaluation context
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#include <string.h> // for memset
+#include "program.hh"
+#include "operator.hh"
+
+namespace ttl {
+
+    Program::Program()
+        : arena_(), root_(NULL), initial_values_(), zero_initialized_(true), inputs_(), externs_(), positions_(), models_() {}
+
+    Program::~Program() {
+        // the ast is released with arena_.
+    }
+
+    double Program::Evaluate(Context& context) const {
+        return root_->Evaluate(context);
+    }
+
+    static void DumpNode(const Operator * node, int depth, std::ostream& out) {
+        static const char * const ASSIGN_NAMES[] = { "=", "+=", "-=", "*=", "/=", "%=" };
+        static const char * const NAMES[] = {
+            "module", "num", "variable", "reference", "+", "-", "if", "||", "&&",
+            "<", "<=", ">", ">=", "==", "!=", "/", "*", "%", "!", "lr", "lambdamart", "call", "extern"
+        };
+
+        out << std::string(depth * 2, ' ');
+        switch (node->Type()) {
+        case Operator::OP_MODULE:
+            {
+                const Module * module = static_cast<const Module *>(node);
+                out << "module default=$" << module->DefaultSlot()
+                    << " return=$" << module->ReturnSlot();
+            }
+            break;
+        case Operator::OP_NUM:
+            out << static_cast<const Num *>(node)->Value();
+            break;
+        case Operator::OP_VARIABLE:
+            out << "$" << static_cast<const Variable *>(node)->Slot();
+            break;
+        case Operator::OP_REFERENCE:
+            {
+                const Reference * ref = static_cast<const Reference *>(node);
+                out << (ref->IsReturn() ? "return $" : "$") << ref->Slot()
+                    << " " << ASSIGN_NAMES[ref->AssignType()];
+            }
+            break;
+        case Operator::OP_DIV:
+            out << "/ default=" << static_cast<const Div *>(node)->DefaultValue();
+            break;
+        case Operator::OP_LOGISTIC:
+            {
+                const Logistic * lr = static_cast<const Logistic *>(node);
+                out << "lr " << lr->Path() << " (" << lr->Model()->Size() << " variables)";
+            }
+            break;
+        case Operator::OP_ENSEMBLE:
+            {
+                const Ensemble * lambdamart = static_cast<const Ensemble *>(node);
+                out << "lambdamart " << lambdamart->Path() << " (" << lambdamart->Model()->Trees() << " trees)";
+            }
+            break;
+        case Operator::OP_EXTERNAL:
+            out << "extern $" << static_cast<const External *>(node)->Slot();
+            break;
+        case Operator::OP_CALL:
+            out << "call " << static_cast<const Call *>(node)->GetFunction()->name;
+            break;
+        default:
+            out << NAMES[node->Type()];
+        }
+        out << std::endl;
+
+        const OperatorList& children = node->Children();
+        for (std::size_t i = 0; i < children.size(); ++i) {
+            DumpNode(children[i], depth + 1, out);
+        }
+    }
+
+    void Program::Dump(std::ostream& out) const {
+        if (root_ != NULL) {
+            DumpNode(root_, 0, out);
+        }
+    }
+
+    bool Program::Position(const Operator * node, SourceRange * range) const {
+        std::map<const Operator *, SourceRange>::const_iterator it = positions_.find(node);
+        if (it == positions_.end()) {
+            return false;
+        }
+        *range = it->second;
+        return true;
+    }
+
+    void Program::SetPosition(const Operator * node, int offset, int length) {
+        SourceRange range = { offset, length };
+        positions_[node] = range;
+    }
+
+    int Program::Input(const std::string& name) const {
+        std::map<std::string, int>::const_iterator it = inputs_.find(name);
+        if (it != inputs_.end()) {
+            return it->second;
+        }
+        int index = FindExtern(name);
+        return index < 0 ? -1 : externs_[index].slot;
+    }
+
+    int Program::FindExtern(const std::string& name) const {
+        // a few per program, a map is not worth it.
+        for (std::size_t i = 0; i < externs_.size(); ++i) {
+            if (externs_[i].name == name) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    int Program::AllocateSlot(double initial_value) {
+        unsigned long long bits;
+        memcpy(&bits, &initial_value, sizeof(bits));
+        zero_initialized_ = zero_initialized_ && bits == 0;
+
+        initial_values_.push_back(initial_value);
+        return initial_values_.size() - 1;
+    }
+
+    int Program::AddInput(const std::string& name, double initial_value) {
+        std::map<std::string, int>::iterator it = inputs_.find(name);
+        if (it != inputs_.end()) {
+            return it->second;
+        }
+
+        int slot = AllocateSlot(initial_value);
+        inputs_.insert(make_pair(name, slot));
+        return slot;
+    }
+
+    int Program::AddExtern(const std::string& name) {
+        int index = FindExtern(name);
+        if (index >= 0) {
+            return index;
+        }
+
+        Extern e;
+        e.name = name;
+        e.slot = AllocateSlot(Constants::DEFAULT_RETURN_VALUE);
+        e.resolved_slot = AllocateSlot(0);
+        externs_.push_back(e);
+        return externs_.size() - 1;
+    }
+
+    Context::Context(const Program& program)
+        : program_(program),
+          values_(program.InitialValues()),
+          resolver_(NULL),
+          row_(0) {}
+
+    void Context::Reset() {
+        // only the slots are reset, registers above them are scratch.
+        std::size_t size = program_.SlotCount() * sizeof(double);
+        if (program_.ZeroInitialized()) {
+            memset(&values_[0], 0, size);
+        } else {
+            memcpy(&values_[0], &program_.InitialValues()[0], size);
+        }
+    }
+
+    bool Context::Set(const std::string& name, double value) {
+        int slot = program_.Input(name);
+        if (slot < 0) {
+            return false;
+        }
+        values_[slot] = value;
+
+        int index = program_.FindExtern(name);
+        if (index >= 0) {
+            values_[program_.Externs()[index].resolved_slot] = 1;
+        }
+        return true;
+    }
+
+    void Context::Resolve(int index) {
+        const Extern& e = program_.Externs()[index];
+        if (values_[e.resolved_slot] != 0) {
+            return;
+        }
+        if (resolver_ != NULL) {
+            values_[e.slot] = resolver_->Resolve(index, row_);
+        }
+        values_[e.resolved_slot] = 1;
+    }
+
+} // ttl
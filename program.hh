@@ -0,0 +1,195 @@
+/**
+ * program.hh - compiled program and evaluation context
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#ifndef TTL_PROGRAM_H
+#define TTL_PROGRAM_H
+
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "arena.hh"
+
+namespace ttl {
+
+    class Module;
+    class Operator;
+    class Context;
+
+    // a piece of the code given to Parser::Create, in bytes.
+    struct SourceRange {
+        int offset;
+        int length;
+    };
+
+    // an input declared by "extern" in the script, the slot holds its
+    // value, 'resolved_slot' is 1 once it is filled in an evaluation.
+    struct Extern {
+        std::string name;
+        int slot;
+        int resolved_slot;
+    };
+
+    /**
+     * fills the externs of a program, on demand.
+     *
+     * NOTE:
+     *     0. Resolve() is called the first time an evaluation reads an
+     *        extern, at most once per extern per evaluation; an extern
+     *        which is never read (a branch not taken, an operand after
+     *        "&&" decided) is never resolved;
+     *     1. an extern the host sets itself, by Context::Set(name) or a
+     *        bound column, is not resolved;
+     *     2. a resolver is called by the thread evaluating, a resolver
+     *        shared by threads must be thread safe.
+     */
+    class Resolver {
+    public:
+        virtual ~Resolver() {}
+
+        // the value of extern #index of Program::Externs(), for document
+        // 'row' (the row given to Context::SetResolver, or of a batch).
+        virtual double Resolve(int index, std::size_t row) = 0;
+    };
+
+    /**
+     * the immutable result of Parser::Create.
+     *
+     * NOTE:
+     *     0. the program owns the ast, but no evaluation state: variables
+     *        and "return" flags live in a Context, so one program can be
+     *        evaluated by many threads at the same time, one context each;
+     *     1. every variable of every module is resolved to a slot index
+     *        while parsing; inputs are slots declared by the host, visible
+     *        (read only) in every module; externs are inputs declared
+     *        by the script, filled by a Resolver when they are read;
+     *     2. all slots of all modules, including their "returned" flags,
+     *        are one contiguous array of double;
+     *     3. the nodes of the ast, and their lists of children, are
+     *        allocated in the arena of the program, in the order they are
+     *        parsed, and released with it in one go.
+     */
+    class Program {
+    public:
+        Program();
+        ~Program();
+
+        double Evaluate(Context& context) const;
+
+        // return the slot of input (or extern) 'name', or -1 if not declared.
+        int Input(const std::string& name) const;
+        const std::map<std::string, int>& Inputs() const { return inputs_; }
+
+        // the externs, in the order they are declared.
+        const std::vector<Extern>& Externs() const { return externs_; }
+        // return the index of extern 'name', or -1 if not declared.
+        int FindExtern(const std::string& name) const;
+
+        std::size_t SlotCount() const { return initial_values_.size(); }
+        const std::vector<double>& InitialValues() const { return initial_values_; }
+        // true if all slots start from +0.0, so a reset is a memset.
+        bool ZeroInitialized() const { return zero_initialized_; }
+        const Module * Root() const { return root_; }
+
+        // print the ast, one node per line.
+        void Dump(std::ostream& out) const;
+
+        // the code 'node' is parsed from, if the parser tracked positions.
+        // return false for nodes made by the optimizer or included.
+        bool Position(const Operator * node, SourceRange * range) const;
+
+    private:
+        friend class Parser;
+        friend class Module;
+        friend class Optimizer;
+        friend class Reorderer;
+        friend class SubexpressionEliminator;
+        friend class SharedProgram;
+
+        int AllocateSlot(double initial_value);
+        int AddInput(const std::string& name, double initial_value);
+        // return the index of extern 'name', declared once.
+        int AddExtern(const std::string& name);
+        void SetRoot(Module * root) { root_ = root; }
+        void SetPosition(const Operator * node, int offset, int length);
+        Arena& GetArena() { return arena_; }
+        // keep 'model' as long as the nodes which use it.
+        void AddModel(const std::shared_ptr<const void>& model) { models_.push_back(model); }
+
+    private:
+        Program(const Program&);
+        Program& operator=(const Program&);
+
+        Arena arena_;
+        Module * root_;
+        std::vector<double> initial_values_;
+        bool zero_initialized_;
+        std::map<std::string, int> inputs_;
+        std::vector<Extern> externs_;
+        std::map<const Operator *, SourceRange> positions_; // empty if not tracked
+        std::vector<std::shared_ptr<const void> > models_; // of "lr" and "lambdamart"
+    };
+
+    /**
+     * per-evaluation state of a program: the slots.
+     *
+     * a context is cheap to reset, call Reset() before every evaluation
+     * and set the inputs after that.
+     */
+    class Context {
+    public:
+        explicit Context(const Program& program);
+
+        void Reset();
+
+        const Program& GetProgram() const { return program_; }
+
+        double Get(int slot) const { return values_[slot]; }
+        void Set(int slot, double value) { values_[slot] = value; }
+        // set input by name, return false if it is not an input of program.
+        // an extern set so is not resolved in this evaluation.
+        bool Set(const std::string& name, double value);
+
+        // the resolver of the externs, and the document evaluated, until
+        // changed. NULL keeps the values the host set (0 if not).
+        void SetResolver(Resolver * resolver, std::size_t row = 0) {
+            resolver_ = resolver;
+            row_ = row;
+        }
+
+        bool Resolved(int resolved_slot) const { return values_[resolved_slot] != 0; }
+        // fill extern #index of the program, if it is not Resolved().
+        void Resolve(int index);
+
+        // the first SlotCount() registers are the variable slots, engines
+        // which need more registers (temporaries, constants) grow them here.
+        double * Registers(std::size_t count) {
+            if (values_.size() < count) {
+                values_.resize(count);
+            }
+            return &values_[0];
+        }
+
+        bool Returned(int returned_slot) const { return values_[returned_slot] != 0; }
+        void Return(int returned_slot, int slot, double value) {
+            values_[slot] = value;
+            values_[returned_slot] = 1;
+        }
+
+    private:
+        const Program& program_;
+        std::vector<double> values_;
+        Resolver * resolver_;
+        std::size_t row_;
+    };
+
+} // ttl
+
+#endif
@@ -0,0 +1,387 @@
+/**
+ * registry.cc - scripts reloaded when their files change
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <algorithm>
+#include "common.hh"
+#include "parser.hh"
+#include "registry.hh"
+
+namespace ttl {
+
+    // a reader, on a cache line of its own.
+    struct Registry::Slot {
+        std::atomic<unsigned long long> epoch;
+        std::atomic<bool> used;
+        char padding[64 - sizeof(std::atomic<unsigned long long>) - sizeof(std::atomic<bool>)];
+
+        Slot() : epoch(0), used(false) {}
+    };
+
+    static std::string Directory(const std::string& path) {
+        std::size_t slash = path.rfind('/');
+        if (slash == std::string::npos) {
+            return ".";
+        }
+        return slash == 0 ? "/" : path.substr(0, slash);
+    }
+
+    static std::string Base(const std::string& path) {
+        std::size_t slash = path.rfind('/');
+        return slash == std::string::npos ? path : path.substr(slash + 1);
+    }
+
+    Registry::Version::Version(Program * program, std::size_t generation, const std::vector<FileStamp>& files)
+        : program_(program), jit_(*program), generation_(generation), files_(files) {}
+
+    Registry::Reader::Reader(Registry& registry) : registry_(registry), slot_(NULL), depth_(0) {
+        for (std::size_t i = 0; i < registry_.slots_.size(); ++i) {
+            bool used = false;
+            if (registry_.slots_[i]->used.compare_exchange_strong(used, true)) {
+                slot_ = registry_.slots_[i];
+                break;
+            }
+        }
+    }
+
+    Registry::Reader::~Reader() {
+        if (slot_ != NULL) {
+            slot_->epoch = 0;
+            slot_->used = false;
+        }
+    }
+
+    void Registry::Reader::Enter() {
+        if (slot_ != NULL && depth_++ == 0) {
+            // announced before any pointer is read: a version swapped out
+            // later is kept, one swapped out before is not seen.
+            slot_->epoch = registry_.epoch_.load();
+        }
+    }
+
+    void Registry::Reader::Leave() {
+        if (slot_ != NULL && --depth_ == 0) {
+            slot_->epoch = 0;
+        }
+    }
+
+    const Registry::Version * Registry::Reader::Get(int script) const {
+        if (slot_ == NULL || depth_ == 0) {
+            return NULL;
+        }
+        return registry_.scripts_[script]->current.load();
+    }
+
+    Registry::Registry()
+        : scripts_(),
+          names_(),
+          listener_(),
+          epoch_(1),
+          slots_(),
+          mutex_(),
+          retired_(),
+          retired_count_(0),
+          inotify_(-1),
+          watches_(),
+          pending_(),
+          thread_(),
+          started_(false) {
+        stop_[0] = stop_[1] = -1;
+        for (int i = 0; i < MAX_READERS; ++i) {
+            slots_.push_back(new Slot());
+        }
+    }
+
+    Registry::~Registry() {
+        Stop();
+        for (std::size_t i = 0; i < retired_.size(); ++i) {
+            delete retired_[i].version;
+        }
+        for (std::size_t i = 0; i < scripts_.size(); ++i) {
+            delete scripts_[i]->current.load();
+            delete scripts_[i];
+        }
+        for (std::size_t i = 0; i < slots_.size(); ++i) {
+            delete slots_[i];
+        }
+    }
+
+    int Registry::Add(const std::string& name, const std::string& path,
+                      const std::vector<std::string>& inputs, std::string * error) {
+        if (started_) {
+            *error = "registry started";
+            return -1;
+        }
+        if (names_.find(name) != names_.end()) {
+            *error = name + ": script exists";
+            return -1;
+        }
+
+        Parser::Init();
+        Script * script = new Script();
+        script->name = name;
+        script->path = path;
+        script->inputs = inputs;
+        Version * version = Compile(*script, 1, error);
+        if (version == NULL) {
+            delete script;
+            return -1;
+        }
+        script->current = version;
+
+        int id = static_cast<int>(scripts_.size());
+        scripts_.push_back(script);
+        names_[name] = id;
+        return id;
+    }
+
+    int Registry::Find(const std::string& name) const {
+        std::map<std::string, int>::const_iterator it = names_.find(name);
+        return it == names_.end() ? -1 : it->second;
+    }
+
+    Registry::Version * Registry::Compile(const Script& script, std::size_t generation, std::string * error) const {
+        // stat before reading, a change meanwhile is seen by the next check.
+        FileStamp stamp;
+        MappedFile content;
+        if (stamp.Stat(script.path) == false || content.Open(script.path) == false) {
+            *error = script.path + ": file not readable";
+            return NULL;
+        }
+
+        Parser p;
+        for (std::size_t i = 0; i < script.inputs.size(); ++i) {
+            p.AddInput(script.inputs[i]);
+        }
+        if (p.Create(content.Data(), content.Size()) == false) {
+            *error = script.path + ": " + p.ErrorMsg();
+            return NULL;
+        }
+
+        std::vector<FileStamp> files(1, stamp);
+        files.insert(files.end(), p.Dependencies().begin(), p.Dependencies().end());
+        return new Version(p.Release(), generation, files);
+    }
+
+    void Registry::Publish(Script * script, Version * version) {
+        Version * old = script->current.exchange(version);
+
+        // the readers in this epoch or before may still read 'old'.
+        Replaced retired = { old, epoch_.fetch_add(1) };
+        retired_.push_back(retired);
+        retired_count_ = retired_.size();
+        Reclaim();
+    }
+
+    void Registry::Reclaim() {
+        unsigned long long oldest = ULLONG_MAX;
+        for (std::size_t i = 0; i < slots_.size(); ++i) {
+            unsigned long long epoch = slots_[i]->epoch.load();
+            if (epoch != 0 && epoch < oldest) {
+                oldest = epoch;
+            }
+        }
+
+        std::size_t kept = 0;
+        for (std::size_t i = 0; i < retired_.size(); ++i) {
+            if (retired_[i].epoch < oldest) {
+                delete retired_[i].version;
+            } else {
+                retired_[kept++] = retired_[i];
+            }
+        }
+        retired_.resize(kept);
+        retired_count_ = kept;
+    }
+
+    bool Registry::Reload(int script, std::string * error) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Script * s = scripts_[script];
+        const Version * current = s->current.load();
+
+        bool changed = false;
+        const std::vector<FileStamp>& files = current->Files();
+        for (std::size_t i = 0; i < files.size() && changed == false; ++i) {
+            FileStamp stamp;
+            changed = stamp.Stat(files[i].path) == false || (stamp == files[i]) == false;
+        }
+        if (changed == false) {
+            return true;
+        }
+
+        Version * version = Compile(*s, current->Generation() + 1, error);
+        if (version == NULL) {
+            if (listener_) {
+                listener_(script, current->Generation(), *error);
+            }
+            return false;
+        }
+        if (started_) {
+            Watch(s, version->Files());
+        }
+        Publish(s, version);
+        if (listener_) {
+            listener_(script, version->Generation(), "");
+        }
+        return true;
+    }
+
+    bool Registry::Start(std::string * error) {
+        if (started_) {
+            return true;
+        }
+        inotify_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (inotify_ < 0) {
+            *error = "inotify not available";
+            return false;
+        }
+        if (pipe(stop_) != 0) {
+            close(inotify_);
+            inotify_ = -1;
+            *error = "pipe not available";
+            return false;
+        }
+
+        started_ = true;
+        pending_.assign(scripts_.size(), false);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (std::size_t i = 0; i < scripts_.size(); ++i) {
+                Watch(scripts_[i], scripts_[i]->current.load()->Files());
+            }
+        }
+        thread_ = std::thread(&Registry::Work, this);
+        return true;
+    }
+
+    void Registry::Stop() {
+        if (started_ == false) {
+            return;
+        }
+        char c = 0;
+        while (write(stop_[1], &c, 1) < 0 && errno == EINTR) {
+        }
+        thread_.join();
+        close(stop_[0]);
+        close(stop_[1]);
+        close(inotify_);
+        inotify_ = -1;
+        watches_.clear();
+        started_ = false;
+    }
+
+    void Registry::Watch(Script * script, const std::vector<FileStamp>& files) {
+        // the directories are watched, not the files: a file replaced by a
+        // rename is another inode. a directory already watched returns the
+        // same watch.
+        const uint32_t mask = IN_CLOSE_WRITE | IN_MODIFY | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+        for (std::size_t i = 0; i < files.size(); ++i) {
+            std::string directory = Directory(files[i].path);
+            std::vector<std::string>& watched = script->directories;
+            if (std::find(watched.begin(), watched.end(), directory) != watched.end()) {
+                continue;
+            }
+            int watch = inotify_add_watch(inotify_, directory.c_str(), mask);
+            if (watch < 0) {
+                continue; // tried again by the next reload
+            }
+            watched.push_back(directory);
+            std::vector<std::string>& directories = watches_[watch];
+            if (std::find(directories.begin(), directories.end(), directory) == directories.end()) {
+                directories.push_back(directory);
+            }
+        }
+    }
+
+    void Registry::Changed(int watch, const std::string& name) {
+        std::map<int, std::vector<std::string> >::const_iterator it = watches_.find(watch);
+        if (it == watches_.end()) {
+            return;
+        }
+        const std::vector<std::string>& directories = it->second;
+        for (std::size_t i = 0; i < scripts_.size(); ++i) {
+            const std::vector<FileStamp>& files = scripts_[i]->current.load()->Files();
+            for (std::size_t j = 0; j < files.size() && pending_[i] == false; ++j) {
+                if (Base(files[j].path) == name &&
+                    std::find(directories.begin(), directories.end(), Directory(files[j].path)) != directories.end()) {
+                    pending_[i] = true;
+                }
+            }
+        }
+    }
+
+    void Registry::Work() {
+        char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+        struct pollfd fds[2] = { { stop_[0], POLLIN, 0 }, { inotify_, POLLIN, 0 } };
+
+        while (true) {
+            bool pending = std::find(pending_.begin(), pending_.end(), true) != pending_.end();
+            int timeout = pending ? QUIET_MS : (retired_count_ > 0 ? 100 : -1);
+            int n = poll(fds, 2, timeout);
+            if (n < 0) {
+                continue; // EINTR
+            }
+            if (fds[0].revents != 0) {
+                break;
+            }
+
+            if (n > 0 && (fds[1].revents & POLLIN) != 0) {
+                // wait until the files are quiet for QUIET_MS.
+                std::lock_guard<std::mutex> lock(mutex_);
+                ssize_t length;
+                while ((length = read(inotify_, buffer, sizeof(buffer))) > 0) {
+                    for (char * p = buffer; p < buffer + length; ) {
+                        const struct inotify_event * event = reinterpret_cast<const struct inotify_event *>(p);
+                        if (event->mask & IN_Q_OVERFLOW) {
+                            pending_.assign(scripts_.size(), true);
+                        } else if (event->mask & IN_IGNORED) {
+                            // the directory is gone, watched again when
+                            // a reload finds it
+                            std::vector<std::string>& directories = watches_[event->wd];
+                            for (std::size_t i = 0; i < scripts_.size(); ++i) {
+                                std::vector<std::string>& watched = scripts_[i]->directories;
+                                std::size_t size = watched.size();
+                                for (std::size_t j = 0; j < directories.size(); ++j) {
+                                    watched.erase(std::remove(watched.begin(), watched.end(), directories[j]),
+                                                  watched.end());
+                                }
+                                if (watched.size() != size) {
+                                    pending_[i] = true;
+                                }
+                            }
+                            watches_.erase(event->wd);
+                        } else if (event->len > 0) {
+                            Changed(event->wd, event->name);
+                        }
+                        p += sizeof(struct inotify_event) + event->len;
+                    }
+                }
+                continue;
+            }
+
+            if (pending) {
+                for (std::size_t i = 0; i < scripts_.size(); ++i) {
+                    if (pending_[i]) {
+                        pending_[i] = false;
+                        std::string error;
+                        Reload(static_cast<int>(i), &error);
+                    }
+                }
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            Reclaim();
+        }
+    }
+
+} // ttl
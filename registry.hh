@@ -0,0 +1,191 @@
+/**
+ * registry.hh - scripts reloaded when their files change
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#ifndef TTL_REGISTRY_H
+#define TTL_REGISTRY_H
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cache.hh"
+#include "jit.hh"
+#include "program.hh"
+
+namespace ttl {
+
+    /**
+     * a set of named scripts, parsed and compiled again in the background
+     * when the script, or a file it includes, changes.
+     *
+     * NOTE:
+     *     0. the files are watched with inotify, by their directories, so a
+     *        file replaced by rename (as editors and deploys do) is seen. a
+     *        script is reloaded once its files are quiet for QUIET_MS, and
+     *        only if the stat of one of them differs;
+     *     1. a new version is published by swapping one pointer. readers
+     *        never lock: a reader announces the epoch it reads in, the old
+     *        version is deleted when no reader is still in an epoch before
+     *        the swap, so the evaluations in flight finish on it;
+     *     2. if a reload fails (bad syntax, a file missing) the old version
+     *        stays, the error is given to the listener;
+     *     3. the scripts are added before Start(), the set is fixed then, so
+     *        Find() needs no lock either;
+     *     4. a Context is made for one version (its slots), make a new one
+     *        when the generation of the version read changes.
+     */
+    class Registry {
+    public:
+        class Version {
+        public:
+            const Program& GetProgram() const { return *program_; }
+            double Evaluate(Context& context) const { return jit_.Evaluate(context); }
+
+            // 1 for the version parsed by Add(), increased by every reload.
+            std::size_t Generation() const { return generation_; }
+
+            // the script and the files it includes, as they were parsed.
+            const std::vector<FileStamp>& Files() const { return files_; }
+
+        private:
+            friend class Registry;
+            Version(Program * program, std::size_t generation, const std::vector<FileStamp>& files);
+            Version(const Version&);
+            Version& operator=(const Version&);
+
+            std::unique_ptr<Program> program_;
+            Jit jit_;
+            std::size_t generation_;
+            std::vector<FileStamp> files_;
+        };
+
+        struct Slot;
+
+        /**
+         * one per evaluating thread, see Registry::MAX_READERS.
+         *
+         *     reader.Enter();
+         *     const Registry::Version * version = reader.Get(script);
+         *     double score = version->Evaluate(context);
+         *     reader.Leave();
+         *
+         * a version got between Enter() and Leave() is not deleted until
+         * Leave(), Enter() may be nested.
+         */
+        class Reader {
+        public:
+            explicit Reader(Registry& registry);
+            ~Reader();
+
+            // false if all the slots are taken, Get() returns NULL then.
+            bool Valid() const { return slot_ != NULL; }
+
+            void Enter();
+            void Leave();
+            const Version * Get(int script) const;
+
+        private:
+            Reader(const Reader&);
+            Reader& operator=(const Reader&);
+
+            Registry& registry_;
+            Slot * slot_;
+            int depth_;
+        };
+
+        // called on the thread which reloads, 'error' is "" on success. it
+        // must not call Reload().
+        typedef std::function<void (int script, std::size_t generation, const std::string& error)> Listener;
+
+        const static int MAX_READERS = 256;
+        const static int QUIET_MS = 50;
+
+        Registry();
+        // the readers must be destroyed first.
+        ~Registry();
+
+        // parse 'path' as script 'name' with 'inputs', return its id, or -1
+        // and set 'error'. not after Start().
+        int Add(const std::string& name, const std::string& path,
+                const std::vector<std::string>& inputs, std::string * error);
+
+        // the id of script 'name', or -1.
+        int Find(const std::string& name) const;
+        std::size_t Scripts() const { return scripts_.size(); }
+
+        // not after Start().
+        void SetListener(const Listener& listener) { listener_ = listener; }
+
+        // watch the files in a thread of the registry. return false and set
+        // 'error' if inotify can not be used, Reload() still works then.
+        bool Start(std::string * error);
+        void Stop();
+
+        // reload 'script' now if one of its files changed. return false and
+        // set 'error' if it does not parse, the old version stays then.
+        bool Reload(int script, std::string * error);
+
+        // the versions replaced but still read by some reader.
+        std::size_t Retired() const { return retired_count_; }
+
+    private:
+        Registry(const Registry&);
+        Registry& operator=(const Registry&);
+
+        struct Script {
+            std::string name;
+            std::string path;
+            std::vector<std::string> inputs;
+            std::atomic<Version *> current;
+            std::vector<std::string> directories; // watched for it
+        };
+
+        struct Replaced {
+            Version * version;
+            unsigned long long epoch; // the last epoch it could be read in
+        };
+
+        Version * Compile(const Script& script, std::size_t generation, std::string * error) const;
+        void Publish(Script * script, Version * version);
+        void Reclaim();
+
+        void Watch(Script * script, const std::vector<FileStamp>& files);
+        void Changed(int watch, const std::string& name);
+        void Work();
+
+    private:
+        std::vector<Script *> scripts_;
+        std::map<std::string, int> names_;
+        Listener listener_;
+
+        // epoch 0 is a reader not reading.
+        std::atomic<unsigned long long> epoch_;
+        std::vector<Slot *> slots_;
+
+        // taken by the reloads, never by the readers.
+        std::mutex mutex_;
+        std::vector<Replaced> retired_;
+        std::atomic<std::size_t> retired_count_;
+
+        int inotify_;
+        int stop_[2];  // a pipe, to wake up the thread
+        std::map<int, std::vector<std::string> > watches_; // directories by watch
+        std::vector<bool> pending_;                         // by script
+        std::thread thread_;
+        bool started_;
+    };
+
+} // ttl
+
+#endif
@@ -0,0 +1,314 @@
+/**
+ * reorder.cc - reorder conditions by their profiled cost and outcome
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#include <math.h>
+#include <algorithm>
+#include <limits>
+#include <vector>
+#include "reorder.hh"
+
+namespace ttl {
+
+    static const double INF = std::numeric_limits<double>::infinity();
+
+    Reorderer::Reorderer(Program * program, const Profiler& profile)
+        : program_(program), profile_(profile), changes_(0) {}
+
+    void Reorderer::Run() {
+        if (program_->root_ != NULL) {
+            Visit(program_->root_);
+        }
+    }
+
+    void Reorderer::Visit(Operator * node) {
+        const OperatorList& children = node->Children();
+        for (std::size_t i = 0; i < children.size(); ++i) {
+            Visit(children[i]);
+        }
+
+        switch (node->Type()) {
+        case Operator::OP_AND:
+            return ReorderLogical(node, true);
+        case Operator::OP_OR:
+            return ReorderLogical(node, false);
+        case Operator::OP_IF:
+            return ReorderIf(node);
+        default:
+            return;
+        }
+    }
+
+    double Reorderer::Rank(const Operator * node, unsigned long long decisive) const {
+        Profiler::Statistics statistics;
+        if (profile_.Find(node, &statistics) == false || decisive == 0) {
+            return INF;
+        }
+        return (double)statistics.ticks / decisive;
+    }
+
+    // an operand, or an arm of "if", and its place in the new order.
+    struct Ranked {
+        Operator * condition;
+        Operator * body;  // of an arm
+        bool ran;         // while profiling
+        double rank;
+        std::size_t place;
+
+        bool operator<(const Ranked& other) const {
+            if (ran != other.ran) {
+                return ran;
+            }
+            return rank < other.rank;
+        }
+    };
+
+    // sort 'items' and return true if the order changed.
+    static bool Sort(std::vector<Ranked> * items) {
+        std::stable_sort(items->begin(), items->end());
+        for (std::size_t i = 0; i < items->size(); ++i) {
+            if ((*items)[i].place != i) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Reorderer::ReorderLogical(Operator * node, bool is_and) {
+        OperatorList& children = node->children_;
+        bool changed = false;
+
+        // the pure operands between two impure ones are sorted.
+        std::size_t begin = 0;
+        for (std::size_t i = 0; i <= children.size(); ++i) {
+            if (i < children.size() && Pure(children[i])) {
+                continue;
+            }
+
+            std::vector<Ranked> items;
+            for (std::size_t k = begin; k < i; ++k) {
+                Profiler::Statistics statistics = { 0, 0, 0 };
+                profile_.Find(children[k], &statistics);
+                unsigned long long decisive = is_and ? statistics.runs - statistics.truths : statistics.truths;
+                Ranked item = { children[k], NULL, statistics.runs > 0, Rank(children[k], decisive), k - begin };
+                items.push_back(item);
+            }
+            if (items.size() > 1 && Sort(&items)) {
+                for (std::size_t k = 0; k < items.size(); ++k) {
+                    children[begin + k] = items[k].condition;
+                }
+                changed = true;
+            }
+            begin = i + 1;
+        }
+
+        if (changed) {
+            ++changes_;
+        }
+    }
+
+    void Reorderer::ReorderIf(Operator * node) {
+        OperatorList& children = node->children_;
+        const std::size_t arms = children.size() / 2; // the last "else" stays
+        bool changed = false;
+
+        // runs of arms whose conditions are disjoint intervals of one slot.
+        for (std::size_t i = 0; i < arms; ) {
+            std::vector<Interval> intervals(1);
+            if (ToInterval(children[2 * i], &intervals[0]) == false) {
+                ++i;
+                continue;
+            }
+
+            std::size_t j = i + 1;
+            for (; j < arms; ++j) {
+                Interval next;
+                if (ToInterval(children[2 * j], &next) == false || next.slot != intervals[0].slot) {
+                    break;
+                }
+                bool disjoint = true;
+                for (std::size_t k = 0; k < intervals.size() && disjoint; ++k) {
+                    disjoint = Disjoint(intervals[k], next);
+                }
+                if (disjoint == false) {
+                    break;
+                }
+                intervals.push_back(next);
+            }
+
+            if (j - i > 1) {
+                // the time of a condition per run, per time its arm is taken.
+                std::vector<Ranked> items;
+                for (std::size_t k = i; k < j; ++k) {
+                    Profiler::Statistics condition = { 0, 0, 0 };
+                    Profiler::Statistics body = { 0, 0, 0 };
+                    profile_.Find(children[2 * k], &condition);
+                    profile_.Find(children[2 * k + 1], &body);
+                    double rank = INF;
+                    if (condition.runs > 0 && body.runs > 0) {
+                        rank = (double)condition.ticks / condition.runs / body.runs;
+                    }
+                    Ranked item = { children[2 * k], children[2 * k + 1], condition.runs > 0, rank, k - i };
+                    items.push_back(item);
+                }
+                if (Sort(&items)) {
+                    for (std::size_t k = 0; k < items.size(); ++k) {
+                        children[2 * (i + k)] = items[k].condition;
+                        children[2 * (i + k) + 1] = items[k].body;
+                    }
+                    changed = true;
+                }
+            }
+            i = j;
+        }
+
+        if (changed) {
+            ++changes_;
+        }
+    }
+
+    bool Reorderer::ToInterval(const Operator * node, Interval * interval) const {
+        const OperatorList& children = node->Children();
+        if (node->Type() == Operator::OP_AND) {
+            // the intersection of the intervals of one slot
+            for (std::size_t i = 0; i < children.size(); ++i) {
+                Interval next;
+                if (ToInterval(children[i], &next) == false || (i > 0 && next.slot != interval->slot)) {
+                    return false;
+                }
+                if (i == 0) {
+                    *interval = next;
+                    continue;
+                }
+                if (next.low > interval->low || (next.low == interval->low && next.low_closed == false)) {
+                    interval->low = next.low;
+                    interval->low_closed = next.low_closed;
+                }
+                if (next.high < interval->high || (next.high == interval->high && next.high_closed == false)) {
+                    interval->high = next.high;
+                    interval->high_closed = next.high_closed;
+                }
+            }
+            return children.empty() == false;
+        }
+
+        int type = node->Type();
+        if (type != Operator::OP_LESS && type != Operator::OP_LESS_EQUAL &&
+            type != Operator::OP_GREATER && type != Operator::OP_GREATER_EQUAL &&
+            type != Operator::OP_EQUAL) {
+            return false;
+        }
+
+        // "variable op number", or "number op variable" turned around.
+        const Operator * variable = children[0];
+        const Operator * number = children[1];
+        if (variable->Type() == Operator::OP_NUM && number->Type() == Operator::OP_VARIABLE) {
+            std::swap(variable, number);
+            switch (type) {
+            case Operator::OP_LESS: type = Operator::OP_GREATER; break;
+            case Operator::OP_LESS_EQUAL: type = Operator::OP_GREATER_EQUAL; break;
+            case Operator::OP_GREATER: type = Operator::OP_LESS; break;
+            case Operator::OP_GREATER_EQUAL: type = Operator::OP_LESS_EQUAL; break;
+            }
+        }
+        if (variable->Type() != Operator::OP_VARIABLE || number->Type() != Operator::OP_NUM) {
+            return false;
+        }
+        double value = static_cast<const Num *>(number)->Value();
+        if (isnan(value)) {
+            return false;
+        }
+
+        // the infinities are in the interval, "x < 1" is true for -inf.
+        interval->slot = static_cast<const Variable *>(variable)->Slot();
+        interval->low = -INF;
+        interval->high = INF;
+        interval->low_closed = true;
+        interval->high_closed = true;
+        switch (type) {
+        case Operator::OP_LESS:
+            interval->high = value;
+            interval->high_closed = false;
+            break;
+        case Operator::OP_LESS_EQUAL:
+            interval->high = value;
+            break;
+        case Operator::OP_GREATER:
+            interval->low = value;
+            interval->low_closed = false;
+            break;
+        case Operator::OP_GREATER_EQUAL:
+            interval->low = value;
+            break;
+        default:
+            interval->low = interval->high = value;
+        }
+        return true;
+    }
+
+    bool Reorderer::Disjoint(const Interval& a, const Interval& b) {
+        // NaN is in no interval, so an empty interval, or one before the
+        // other, or touching it at an open end, has no value in common.
+        const Interval * intervals[] = { &a, &b };
+        for (int i = 0; i < 2; ++i) {
+            const Interval& x = *intervals[i];
+            if (x.low > x.high || (x.low == x.high && (x.low_closed == false || x.high_closed == false))) {
+                return true;
+            }
+        }
+        if (a.high < b.low || b.high < a.low) {
+            return true;
+        }
+        return (a.high == b.low && (a.high_closed == false || b.low_closed == false)) ||
+               (b.high == a.low && (b.high_closed == false || a.low_closed == false));
+    }
+
+    bool Reorderer::Pure(const Operator * node) {
+        const OperatorList& children = node->Children();
+        switch (node->Type()) {
+        case Operator::OP_MODULE:    // an included file, may assign
+        case Operator::OP_REFERENCE:
+            return false;
+        case Operator::OP_CALL:
+            if (static_cast<const Call *>(node)->GetFunction()->pure == false) {
+                return false;
+            }
+            break;
+        case Operator::OP_DIV:
+            // by 0 prints "Divided by zero"
+            if (children[1]->Type() != Operator::OP_NUM ||
+                static_cast<const Num *>(children[1])->Value() == 0) {
+                return false;
+            }
+            break;
+        case Operator::OP_MOD:
+            // the divisor is cast to long long, by 0 or (of LLONG_MIN) by
+            // -1 traps
+            {
+                if (children[1]->Type() != Operator::OP_NUM) {
+                    return false;
+                }
+                double value = static_cast<const Num *>(children[1])->Value();
+                if (!(fabs(value) < 9e18) || (long long)value == 0 || (long long)value == -1) {
+                    return false;
+                }
+            }
+            break;
+        default:
+            break;
+        }
+
+        for (std::size_t i = 0; i < children.size(); ++i) {
+            if (Pure(children[i]) == false) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+} // ttl
@@ -0,0 +1,86 @@
+/**
+ * reorder.hh - reorder conditions by their profiled cost and outcome
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#ifndef TTL_REORDER_H
+#define TTL_REORDER_H
+
+#include "operator.hh"
+#include "profiler.hh"
+#include "program.hh"
+
+namespace ttl {
+
+    /**
+     * run the cheap and decisive conditions first, in place, with the
+     * counters of a Profiler of the program.
+     *
+     * NOTE:
+     *     0. the operands of "&&" ("||") are sorted by their time per run
+     *        which returns false (true): an operand which takes t cycles
+     *        and ends the evaluation with probability p goes before one of
+     *        t' and p' if t / p < t' / p';
+     *     1. only pure operands move: no module (an included file), no
+     *        assignment, no call of an impure Function, no "/" or "%" but
+     *        by a constant which can not print "Divided by zero" or trap.
+     *        an impure operand stays, the pure ones are sorted between
+     *        the impure ones;
+     *     2. the arms of "if ... else if" move when their conditions are
+     *        intervals of one variable, like "x == 1", "x > 2 && x <= 5",
+     *        which do not overlap, so at most one of them is true. they
+     *        are sorted by the time of the condition per time the arm is
+     *        taken;
+     *     3. an operand or an arm never run while profiling keeps its place
+     *        relative to the others never run, after the ones which ran;
+     *     4. the result of every evaluation is the same bit for bit, run
+     *        Optimizer before (the profile is of the optimized ast) and
+     *        compile the engines after; the profiler is stale afterwards.
+     */
+    class Reorderer {
+    public:
+        Reorderer(Program * program, const Profiler& profile);
+
+        void Run();
+
+        // the number of "&&", "||" and "if" nodes reordered by Run().
+        std::size_t Changes() const { return changes_; }
+
+    private:
+        void Visit(Operator * node);
+        void ReorderLogical(Operator * node, bool is_and);
+        void ReorderIf(Operator * node);
+
+        // a set of values of one slot: (low, high), '[' or ']' if closed.
+        struct Interval {
+            int slot;
+            double low;
+            double high;
+            bool low_closed;
+            bool high_closed;
+        };
+
+        // true if 'node' is true exactly for the values of 'interval'.
+        bool ToInterval(const Operator * node, Interval * interval) const;
+        static bool Disjoint(const Interval& a, const Interval& b);
+        static bool Pure(const Operator * node);
+
+        // cycles per time 'decisive' runs of 'node', +inf if never.
+        double Rank(const Operator * node, unsigned long long decisive) const;
+
+    private:
+        Reorderer(const Reorderer&);
+        Reorderer& operator=(const Reorderer&);
+
+        Program * program_;
+        const Profiler& profile_;
+        std::size_t changes_;
+    };
+
+} // ttl
+
+#endif
@@ -0,0 +1,158 @@
+/**
+ * scheduler.cc - a pool of threads with work stealing
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#include <algorithm>
+#include "scheduler.hh"
+
+namespace ttl {
+
+    Scheduler::Scheduler(int threads)
+        : workers_(),
+          mutex_(),
+          wake_(),
+          queued_(0),
+          next_(0),
+          stopping_(false),
+          executed_(0),
+          stolen_(0) {
+        if (threads < 1) {
+            threads = std::thread::hardware_concurrency();
+        }
+        if (threads < 1) {
+            threads = 1;
+        }
+
+        for (int i = 0; i < threads; ++i) {
+            workers_.push_back(new Worker());
+        }
+        for (int i = 0; i < threads; ++i) {
+            workers_[i]->thread = std::thread(&Scheduler::Work, this, i);
+        }
+    }
+
+    Scheduler::~Scheduler() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+            wake_.notify_all();
+        }
+        // a thread may still steal from the others until it is joined.
+        for (std::size_t i = 0; i < workers_.size(); ++i) {
+            workers_[i]->thread.join();
+        }
+        for (std::size_t i = 0; i < workers_.size(); ++i) {
+            delete workers_[i];
+        }
+    }
+
+    void Scheduler::Push(int worker, const Task& task) {
+        // counted first, so 'queued_' never underflows when it is popped.
+        ++queued_;
+        std::lock_guard<std::mutex> lock(workers_[worker]->mutex);
+        workers_[worker]->tasks.push_back(task);
+    }
+
+    bool Scheduler::Pop(int worker, Task * task) {
+        Worker * w = workers_[worker];
+        std::lock_guard<std::mutex> lock(w->mutex);
+        if (w->tasks.empty()) {
+            return false;
+        }
+        task->swap(w->tasks.back());
+        w->tasks.pop_back();
+        return true;
+    }
+
+    bool Scheduler::Steal(int worker, Task * task) {
+        const int threads = Threads();
+        for (int i = 1; i < threads; ++i) {
+            Worker * victim = workers_[(worker + i) % threads];
+            std::lock_guard<std::mutex> lock(victim->mutex);
+            if (victim->tasks.empty() == false) {
+                task->swap(victim->tasks.front());
+                victim->tasks.pop_front();
+                ++stolen_;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void Scheduler::Work(int worker) {
+        Task task;
+        while (true) {
+            if (Pop(worker, &task) || Steal(worker, &task)) {
+                --queued_;
+                task(worker);
+                task = Task();
+                ++executed_;
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (queued_ == 0 && stopping_ == false) {
+                wake_.wait(lock);
+            }
+            if (queued_ == 0 && stopping_) {
+                return;
+            }
+        }
+    }
+
+    void Scheduler::Submit(const Task& task) {
+        Push(next_++ % workers_.size(), task);
+        std::lock_guard<std::mutex> lock(mutex_);
+        wake_.notify_one();
+    }
+
+    void Scheduler::For(std::size_t n, std::size_t grain, const RangeTask& task) {
+        if (n == 0) {
+            return;
+        }
+        if (grain < 1) {
+            grain = 1;
+        }
+
+        std::mutex mutex;
+        std::condition_variable done;
+        std::size_t remaining = (n + grain - 1) / grain;
+
+        // the chunks of a thread are pushed last first, so it runs them in
+        // order from the back, and thieves take the last ones.
+        const std::size_t chunks = remaining;
+        const std::size_t threads = workers_.size();
+        const std::size_t per_thread = (chunks + threads - 1) / threads;
+        for (std::size_t w = 0; w < threads; ++w) {
+            std::size_t first = w * per_thread;
+            std::size_t last = std::min(chunks, first + per_thread);
+            for (std::size_t c = last; c > first; --c) {
+                std::size_t begin = (c - 1) * grain;
+                std::size_t end = std::min(n, begin + grain);
+                Push(w, [&, begin, end](int worker) {
+                    task(begin, end, worker);
+                    std::lock_guard<std::mutex> lock(mutex);
+                    if (--remaining == 0) {
+                        done.notify_one();
+                    }
+                });
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            wake_.notify_all();
+        }
+
+        std::unique_lock<std::mutex> lock(mutex);
+        while (remaining != 0) {
+            done.wait(lock);
+        }
+    }
+
+} // ttl
@@ -0,0 +1,91 @@
+/**
+ * scheduler.hh - a pool of threads with work stealing
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#ifndef TTL_SCHEDULER_H
+#define TTL_SCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace ttl {
+
+    /**
+     * run tasks on a fixed pool of threads, one deque of tasks per thread.
+     *
+     * NOTE:
+     *     0. a thread takes tasks from the back of its own deque; when it is
+     *        empty, it steals from the front of the others, starting from
+     *        its neighbour, so threads which finish early help the slow ones;
+     *     1. For() gives every thread a contiguous run of chunks, the chunks
+     *        are stolen one by one when the costs are uneven;
+     *     2. a task knows the thread it runs on, 0 <= worker < Threads(),
+     *        so per-thread state (a Context) needs no lock;
+     *     3. the deques are guarded by a mutex each, the tasks are chunks of
+     *        many documents, so the locks are rarely contended.
+     */
+    class Scheduler {
+    public:
+        typedef std::function<void (int worker)> Task;
+        typedef std::function<void (std::size_t begin, std::size_t end, int worker)> RangeTask;
+
+        // 'threads' < 1 for the number of cpus.
+        explicit Scheduler(int threads = 0);
+        ~Scheduler();
+
+        int Threads() const { return static_cast<int>(workers_.size()); }
+
+        // run 'task' on some thread, it may run before Submit() returns.
+        void Submit(const Task& task);
+
+        // run 'task' over [0, n) in chunks of 'grain' items, return when all
+        // chunks are done. do not call it from a task.
+        void For(std::size_t n, std::size_t grain, const RangeTask& task);
+
+        // tasks run, and tasks stolen from another deque, since created.
+        std::size_t Executed() const { return executed_; }
+        std::size_t Stolen() const { return stolen_; }
+
+    private:
+        Scheduler(const Scheduler&);
+        Scheduler& operator=(const Scheduler&);
+
+        struct Worker {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+            std::thread thread;
+        };
+
+        void Push(int worker, const Task& task);
+        bool Pop(int worker, Task * task);
+        bool Steal(int worker, Task * task);
+        void Work(int worker);
+
+    private:
+        std::vector<Worker *> workers_;
+
+        // idle threads wait for 'queued_' > 0.
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        std::atomic<std::size_t> queued_;
+        std::atomic<std::size_t> next_; // round robin of Submit()
+        bool stopping_;
+
+        std::atomic<std::size_t> executed_;
+        std::atomic<std::size_t> stolen_;
+    };
+
+} // ttl
+
+#endif
@@ -0,0 +1,334 @@
+/**
+ * scorer.cc - score files of records with a pool of threads
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <deque>
+#include <sstream>
+#include "batch.hh"
+#include "scorer.hh"
+
+namespace ttl {
+
+    RecordReader::RecordReader(int fd) : fd_(fd), buffer_(), eof_(false) {}
+
+    bool RecordReader::Fill() {
+        if (eof_) {
+            return false;
+        }
+
+        std::size_t size = buffer_.size();
+        buffer_.resize(size + CHUNK_SIZE);
+        ssize_t bytes;
+        do {
+            bytes = read(fd_, &buffer_[size], CHUNK_SIZE);
+        } while (bytes < 0 && errno == EINTR);
+
+        buffer_.resize(size + (bytes > 0 ? bytes : 0));
+        eof_ = bytes <= 0;
+        return bytes > 0;
+    }
+
+    bool RecordReader::ReadHeader(std::vector<std::string> * columns) {
+        std::size_t end;
+        while ((end = buffer_.find('\n')) == std::string::npos && Fill())
+            ;
+        if (buffer_.empty()) {
+            return false;
+        }
+
+        std::string line = buffer_.substr(0, end);
+        buffer_.erase(0, end == std::string::npos ? end : end + 1);
+        if (line.empty() == false && line[line.size() - 1] == '\r') {
+            line.erase(line.size() - 1);
+        }
+
+        columns->clear();
+        std::size_t begin = 0;
+        do {
+            end = line.find('\t', begin);
+            columns->push_back(line.substr(begin, end == std::string::npos ? end : end - begin));
+            begin = end + 1;
+        } while (end != std::string::npos);
+        return true;
+    }
+
+    bool RecordReader::ReadChunk(std::string * lines) {
+        if (buffer_.size() < CHUNK_SIZE) {
+            Fill();
+        }
+
+        std::size_t end;
+        while ((end = buffer_.rfind('\n')) == std::string::npos && Fill())
+            ;
+        if (buffer_.empty()) {
+            return false;
+        }
+
+        end = (end == std::string::npos) ? buffer_.size() : end + 1;
+        lines->assign(buffer_, 0, end);
+        buffer_.erase(0, end);
+        return true;
+    }
+
+    // the state of a thread
+    struct RecordScorer::Worker {
+        Context context;
+        BatchEvaluator * batch;
+        Profiler * profiler;
+        std::vector<double> values;  // row major, a row per record
+        std::vector<double> column;  // of batch, column major
+        std::vector<double> results;
+
+        explicit Worker(const Program& program)
+            : context(program), batch(NULL), profiler(NULL), values(), column(), results() {}
+        ~Worker() {
+            delete batch;
+            delete profiler;
+        }
+    };
+
+    RecordScorer::RecordScorer(const Program& program, const std::string& engine, int threads)
+        : program_(program),
+          bytecode_(NULL),
+          jit_(NULL),
+          scheduler_(threads < 1 ? 1 : threads),
+          workers_(),
+          slots_(),
+          records_(0),
+          mutex_(),
+          done_() {
+        if (engine == "bytecode") {
+            bytecode_ = new Bytecode(program_);
+        } else if (engine == "jit") {
+            jit_ = new Jit(program_);
+        }
+
+        for (int i = 0; i < scheduler_.Threads(); ++i) {
+            workers_.push_back(new Worker(program_));
+            if (engine == "batch") {
+                workers_.back()->batch = new BatchEvaluator(program_);
+            } else if (engine == "profile") {
+                workers_.back()->profiler = new Profiler(program_);
+            }
+        }
+    }
+
+    RecordScorer::~RecordScorer() {
+        for (std::size_t i = 0; i < workers_.size(); ++i) {
+            delete workers_[i];
+        }
+        delete bytecode_;
+        delete jit_;
+    }
+
+    bool RecordScorer::Run(RecordReader& reader, const std::vector<std::string>& columns,
+                           std::ostream& out, std::string * error) {
+        slots_.resize(columns.size());
+        for (std::size_t i = 0; i < columns.size(); ++i) {
+            slots_[i] = program_.Input(columns[i]);
+        }
+        records_ = 0;
+
+        std::deque<Chunk *> in_flight; // in the order of the input
+        std::size_t line = 2;          // after the header
+        bool reading = true;
+        bool ok = true;
+        while (true) {
+            while (reading && in_flight.size() < 2 * workers_.size()) {
+                Chunk * chunk = new Chunk();
+                if (reader.ReadChunk(&chunk->lines) == false) {
+                    delete chunk;
+                    reading = false;
+                    break;
+                }
+                chunk->first_line = line;
+                chunk->records = 0;
+                chunk->done = false;
+                line += std::count(chunk->lines.begin(), chunk->lines.end(), '\n');
+
+                in_flight.push_back(chunk);
+                scheduler_.Submit([this, chunk](int worker) {
+                    Score(workers_[worker], chunk);
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    chunk->done = true;
+                    done_.notify_all();
+                });
+            }
+
+            if (in_flight.empty()) {
+                break;
+            }
+
+            Chunk * chunk = in_flight.front();
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                while (chunk->done == false) {
+                    done_.wait(lock);
+                }
+            }
+
+            out.write(chunk->scores.data(), chunk->scores.size());
+            out.flush();
+            records_ += chunk->records;
+            if (chunk->error.empty() == false) {
+                *error = chunk->error;
+                ok = false;
+                break;
+            }
+
+            in_flight.pop_front();
+            delete chunk;
+        }
+
+        // the chunks after an error are still running.
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (std::size_t i = 0; i < in_flight.size(); ++i) {
+            while (in_flight[i]->done == false) {
+                done_.wait(lock);
+            }
+            delete in_flight[i];
+        }
+        return ok;
+    }
+
+    void RecordScorer::Score(Worker * worker, Chunk * chunk) {
+        Parse(worker, chunk); // the records before an error are scored
+
+        std::size_t rows = chunk->records;
+        worker->results.resize(rows);
+        if (bytecode_ != NULL) {
+            EvaluateRows(*bytecode_, worker, rows);
+        } else if (jit_ != NULL) {
+            EvaluateRows(*jit_, worker, rows);
+        } else if (worker->batch != NULL) {
+            EvaluateBatch(worker, rows);
+        } else if (worker->profiler != NULL) {
+            EvaluateRows(*worker->profiler, worker, rows);
+        } else {
+            EvaluateRows(program_, worker, rows);
+        }
+
+        char buffer[32];
+        chunk->scores.reserve(rows * 12);
+        for (std::size_t i = 0; i < rows; ++i) {
+            int length = snprintf(buffer, sizeof(buffer), "%.17g\n", worker->results[i]);
+            chunk->scores.append(buffer, length);
+        }
+    }
+
+    void RecordScorer::MergeProfiles(Profiler * profile) const {
+        for (std::size_t i = 0; i < workers_.size(); ++i) {
+            if (workers_[i]->profiler != NULL) {
+                profile->Merge(*workers_[i]->profiler);
+            }
+        }
+    }
+
+    bool RecordScorer::Parse(Worker * worker, Chunk * chunk) {
+        std::vector<double>& values = worker->values;
+        values.clear();
+
+        const std::size_t columns = slots_.size();
+        const char * p = chunk->lines.c_str();
+        const char * end = p + chunk->lines.size();
+        for (std::size_t line = chunk->first_line; p < end; ++line) {
+            const char * eol = static_cast<const char *>(memchr(p, '\n', end - p));
+            if (eol == NULL) {
+                eol = end;
+            }
+            const char * last = (eol > p && eol[-1] == '\r') ? eol - 1 : eol;
+            if (last == p) {
+                p = eol + 1;
+                continue; // empty line
+            }
+
+            std::size_t column = 0;
+            for (const char * field = p; true; ++column) {
+                const char * tab = static_cast<const char *>(memchr(field, '\t', last - field));
+                const char * field_end = tab == NULL ? last : tab;
+
+                double value = 0;
+                if (field_end != field) {
+                    char * stop = NULL;
+                    value = strtod(field, &stop);
+                    if (stop != field_end) {
+                        std::ostringstream os;
+                        os << "line " << line << ", column " << column + 1 << ": not a number";
+                        chunk->error = os.str();
+                        values.resize(chunk->records * columns);
+                        return false;
+                    }
+                }
+                if (column < columns) {
+                    values.push_back(value);
+                } else {
+                    break; // too many fields
+                }
+
+                if (tab == NULL) {
+                    break;
+                }
+                field = tab + 1;
+            }
+
+            if (column + 1 != columns) {
+                std::ostringstream os;
+                os << "line " << line << ": expect " << columns << " fields";
+                chunk->error = os.str();
+                values.resize(chunk->records * columns);
+                return false;
+            }
+
+            ++chunk->records;
+            p = eol + 1;
+        }
+        return true;
+    }
+
+    template <typename Engine>
+    void RecordScorer::EvaluateRows(Engine& engine, Worker * worker, std::size_t rows) {
+        Context& context = worker->context;
+        const std::size_t columns = slots_.size();
+        const double * row = worker->values.empty() ? NULL : &worker->values[0];
+        for (std::size_t i = 0; i < rows; ++i, row += columns) {
+            context.Reset();
+            for (std::size_t c = 0; c < columns; ++c) {
+                if (slots_[c] >= 0) {
+                    context.Set(slots_[c], row[c]);
+                }
+            }
+            worker->results[i] = engine.Evaluate(context);
+        }
+    }
+
+    void RecordScorer::EvaluateBatch(Worker * worker, std::size_t rows) {
+        if (rows == 0) {
+            return;
+        }
+
+        const std::size_t columns = slots_.size();
+        worker->column.resize(rows * columns);
+        for (std::size_t c = 0; c < columns; ++c) {
+            double * column = &worker->column[c * rows];
+            for (std::size_t i = 0; i < rows; ++i) {
+                column[i] = worker->values[i * columns + c];
+            }
+            if (slots_[c] >= 0) {
+                worker->batch->Bind(slots_[c], column);
+            }
+        }
+        worker->batch->Evaluate(rows, &worker->results[0]);
+    }
+
+} // ttl
@@ -0,0 +1,131 @@
+/**
+ * scorer.hh - score files of records with a pool of threads
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#ifndef TTL_SCORER_H
+#define TTL_SCORER_H
+
+#include <condition_variable>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "bytecode.hh"
+#include "jit.hh"
+#include "profiler.hh"
+#include "program.hh"
+#include "scheduler.hh"
+
+namespace ttl {
+
+    /**
+     * split a stream of tab separated values into chunks of whole lines.
+     *
+     * the stream is read with read(2), a chunk is what one read returns
+     * (up to CHUNK_SIZE bytes) rounded down to a line, so records from a
+     * pipe are scored as soon as they arrive.
+     */
+    class RecordReader {
+    public:
+        const static std::size_t CHUNK_SIZE = 1 << 20;
+
+        // 'fd' is not closed by the reader.
+        explicit RecordReader(int fd);
+
+        // read the first line, the names of the columns.
+        // return false if the input is empty.
+        bool ReadHeader(std::vector<std::string> * columns);
+
+        // read the next lines, the last line of the input may have no
+        // '\n'. return false at the end of the input.
+        bool ReadChunk(std::string * lines);
+
+    private:
+        // append one read to 'buffer_', return false at the end of input.
+        bool Fill();
+
+        int fd_;
+        std::string buffer_;
+        bool eof_;
+    };
+
+    /**
+     * evaluate one program for every record of a stream, on a pool of
+     * threads, and write the scores in the order of the records.
+     *
+     * NOTE:
+     *     0. a record is a line of tab separated numbers, one per column of
+     *        the header; a column named as an input of the program is bound
+     *        to it, other columns are ignored, other inputs keep their
+     *        initial values. an empty field is 0, empty lines are skipped;
+     *     1. the main thread reads chunks of lines and writes the scores of
+     *        finished chunks, the threads of a Scheduler parse the fields and
+     *        evaluate; at most 2 chunks per thread are in flight;
+     *     2. one Context (or BatchEvaluator) per thread, the compiled code is
+     *        shared;
+     *     3. a score is printed with 17 significant digits, so it reads back
+     *        as the same double.
+     */
+    class RecordScorer {
+    public:
+        // 'engine' is "tree", "bytecode", "jit", "batch" or "profile".
+        RecordScorer(const Program& program, const std::string& engine, int threads);
+        ~RecordScorer();
+
+        // score the records of 'reader' into 'out'. return false and set
+        // 'error' if a record is malformed, the scores of the records
+        // before it are written.
+        bool Run(RecordReader& reader, const std::vector<std::string>& columns,
+                 std::ostream& out, std::string * error);
+
+        // the records scored by Run()
+        std::size_t Records() const { return records_; }
+
+        // add the counters of the threads to 'profile', engine "profile".
+        void MergeProfiles(Profiler * profile) const;
+
+    private:
+        RecordScorer(const RecordScorer&);
+        RecordScorer& operator=(const RecordScorer&);
+
+        struct Chunk {
+            std::string lines;
+            std::size_t first_line; // line number of the first line
+            std::string scores;
+            std::size_t records;
+            std::string error;
+            bool done;
+        };
+
+        struct Worker;
+
+        void Score(Worker * worker, Chunk * chunk);
+        // split the lines of 'chunk' into worker->values, a row per record.
+        bool Parse(Worker * worker, Chunk * chunk);
+
+        template <typename Engine>
+        void EvaluateRows(Engine& engine, Worker * worker, std::size_t rows);
+        void EvaluateBatch(Worker * worker, std::size_t rows);
+
+    private:
+        const Program& program_;
+        Bytecode * bytecode_;
+        Jit * jit_;
+        Scheduler scheduler_;
+        std::vector<Worker *> workers_; // per thread of 'scheduler_'
+
+        std::vector<int> slots_; // of the columns, -1 if not an input
+        std::size_t records_;
+
+        std::mutex mutex_;
+        std::condition_variable done_; // a chunk is done
+    };
+
+} // ttl
+
+#endif
@@ -0,0 +1,77 @@
+/**
+ * symbols.cc - interned names
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#include <cstring>
+#include "symbols.hh"
+
+namespace ttl {
+
+    SymbolTable::SymbolTable() : arena_(), symbols_(), buckets_(64, -1) {}
+
+    std::size_t SymbolTable::Hash(const char * name, std::size_t length) {
+        // FNV-1a
+        std::size_t hash = 14695981039346656037ULL;
+        for (std::size_t i = 0; i < length; ++i) {
+            hash ^= (unsigned char)name[i];
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    std::size_t SymbolTable::Probe(const char * name, std::size_t length, std::size_t hash) const {
+        std::size_t mask = buckets_.size() - 1;
+        for (std::size_t i = hash & mask; true; i = (i + 1) & mask) {
+            int id = buckets_[i];
+            if (id < 0) {
+                return i;
+            }
+            const Symbol& symbol = symbols_[id];
+            if (symbol.hash == hash && symbol.length == length &&
+                memcmp(symbol.name, name, length) == 0) {
+                return i;
+            }
+        }
+    }
+
+    int SymbolTable::Find(const char * name, std::size_t length) const {
+        return buckets_[Probe(name, length, Hash(name, length))];
+    }
+
+    int SymbolTable::Intern(const char * name, std::size_t length) {
+        std::size_t hash = Hash(name, length);
+        std::size_t bucket = Probe(name, length, hash);
+        if (buckets_[bucket] >= 0) {
+            return buckets_[bucket];
+        }
+
+        char * copy = static_cast<char *>(arena_.Allocate(length));
+        memcpy(copy, name, length);
+        Symbol symbol = { copy, length, hash };
+        symbols_.push_back(symbol);
+        buckets_[bucket] = symbols_.size() - 1;
+
+        if (symbols_.size() * 2 > buckets_.size()) {
+            Grow();
+        }
+        return symbols_.size() - 1;
+    }
+
+    void SymbolTable::Grow() {
+        buckets_.assign(buckets_.size() * 2, -1);
+        std::size_t mask = buckets_.size() - 1;
+        for (std::size_t id = 0; id < symbols_.size(); ++id) {
+            std::size_t i = symbols_[id].hash & mask;
+            while (buckets_[i] >= 0) {
+                i = (i + 1) & mask;
+            }
+            buckets_[i] = id;
+        }
+    }
+
+} // ttl
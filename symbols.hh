@@ -0,0 +1,69 @@
+/**
+ * symbols.hh - interned names
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#ifndef TTL_SYMBOLS_H
+#define TTL_SYMBOLS_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "arena.hh"
+
+namespace ttl {
+
+    /**
+     * the names of a script, each interned once into a dense id.
+     *
+     * NOTE:
+     *     0. ids are 0, 1, 2, ... in the order the names are first seen, so
+     *        data per name can live in vectors indexed by id;
+     *     1. the text of a name is copied into an arena, the table does not
+     *        refer to the source;
+     *     2. open addressing with linear probing, the buckets are doubled
+     *        when they are half full.
+     */
+    class SymbolTable {
+    public:
+        SymbolTable();
+
+        // return the id of the name, add it if it is new.
+        int Intern(const char * name, std::size_t length);
+        int Intern(const std::string& name) { return Intern(name.data(), name.size()); }
+
+        // return the id of the name, or -1 if it is not interned.
+        int Find(const char * name, std::size_t length) const;
+
+        std::size_t Size() const { return symbols_.size(); }
+        std::string Name(int id) const {
+            return std::string(symbols_[id].name, symbols_[id].length);
+        }
+
+    private:
+        SymbolTable(const SymbolTable&);
+        SymbolTable& operator=(const SymbolTable&);
+
+        struct Symbol {
+            const char * name;
+            std::size_t length;
+            std::size_t hash;
+        };
+
+        static std::size_t Hash(const char * name, std::size_t length);
+        // the bucket of the name, or the empty bucket where it belongs.
+        std::size_t Probe(const char * name, std::size_t length, std::size_t hash) const;
+        void Grow();
+
+        Arena arena_;
+        std::vector<Symbol> symbols_;
+        std::vector<int> buckets_; // ids, -1 for empty
+    };
+
+} // ttl
+
+#endif
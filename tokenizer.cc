@@ -7,17 +7,204 @@
  * Copyright © 2017, Bao Hexing. All Rights Reserved.
  */
 
+#include <cstring>
 #include <iostream>
 #include "tokenizer.hh"
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define TTL_X86 1
+#endif
+
 namespace ttl {
 
+    // the classes of characters
+    enum {
+        NM, // name
+        DI, // digit, a number if it begins the token
+        SP, // space
+        EN, // end of code
+        PU, // punctuation, a token of its own
+        SY, // symbol, may be followed by '=', or doubled for "&&" "||"
+    };
+
+    static const unsigned char CHAR_CLASSES[256] = {
+        EN, NM, NM, NM, NM, NM, NM, NM, NM, SP, SP, NM, NM, NM, NM, NM, // 0x00
+        NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, // 0x10
+        SP, SY, NM, NM, NM, SY, SY, NM, PU, PU, SY, SY, PU, SY, NM, SY, // 0x20
+        DI, DI, DI, DI, DI, DI, DI, DI, DI, DI, NM, PU, SY, SY, SY, NM, // 0x30
+        NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, // 0x40
+        NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, // 0x50
+        NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, // 0x60
+        NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, PU, SY, PU, NM, NM, // 0x70
+        NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, // 0x80
+        NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, // 0x90
+        NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, // 0xA0
+        NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, // 0xB0
+        NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, // 0xC0
+        NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, // 0xD0
+        NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, // 0xE0
+        NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, NM, // 0xF0
+    };
+
+    static inline int ClassOf(char c) {
+        return CHAR_CLASSES[(unsigned char)c];
+    }
+
+    // following are the scalar scanners, also used for the tails of the
+    // vectorized ones.
+
+    static const char * skip_spaces_scalar(const char * pos, const char * end) {
+        while (pos < end && ClassOf(*pos) == SP) {
+            ++pos;
+        }
+        return pos;
+    }
+
+    static const char * skip_name_scalar(const char * pos, const char * end) {
+        while (pos < end && ClassOf(*pos) <= DI) {
+            ++pos;
+        }
+        return pos;
+    }
+
+    static const Scanner SCALAR_SCANNER = {
+        "scalar", skip_spaces_scalar, skip_name_scalar
+    };
+
+#if defined(TTL_X86)
+
+    // following are the scanners of 'isa' with 'width' characters a step,
+    // 'v' is the vector type, 'p' the prefix and 's' the suffix of the
+    // integer intrinsics.
+    //
+    // the vector loop recognizes the usual characters only: letters,
+    // digits, '_' and '.' of names, and all the spaces. a name may contain
+    // others, like '#' or utf-8, which are checked by the table one by one.
+    //
+    // the avx2 functions are compiled with the target attribute, so the
+    // whole program does not need -mavx2 and still runs on older cpus.
+
+#define TTL_SCANNER(isa, attr, v, p, s, width)                                  \
+    attr static const char * skip_spaces_##isa(const char * pos,                \
+                                               const char * end) {              \
+        const v space = p##_set1_epi8(' ');                                     \
+        const v tab = p##_set1_epi8('\t');                                      \
+        const v newline = p##_set1_epi8('\n');                                  \
+        if (pos < end && ClassOf(*pos) != SP) {                                 \
+            return pos; /* most tokens are followed by one space or none */     \
+        }                                                                       \
+        for (; end - pos >= width; pos += width) {                              \
+            v x = p##_loadu_##s((const v *)pos);                                \
+            v hit = p##_or_##s(p##_or_##s(p##_cmpeq_epi8(x, space),             \
+                                          p##_cmpeq_epi8(x, tab)),              \
+                               p##_cmpeq_epi8(x, newline));                     \
+            unsigned int miss = ~(unsigned int)p##_movemask_epi8(hit);          \
+            if (width < 32) {                                                   \
+                miss &= (1u << (width & 31)) - 1;                               \
+            }                                                                   \
+            if (miss != 0) {                                                    \
+                return pos + __builtin_ctz(miss);                               \
+            }                                                                   \
+        }                                                                       \
+        return skip_spaces_scalar(pos, end);                                    \
+    }                                                                           \
+                                                                                \
+    attr static const char * skip_name_##isa(const char * pos,                  \
+                                             const char * end) {                \
+        const v case_bit = p##_set1_epi8(0x20);                                 \
+        const v before_a = p##_set1_epi8('a' - 1);                              \
+        const v after_z = p##_set1_epi8('z' + 1);                               \
+        const v before_0 = p##_set1_epi8('0' - 1);                              \
+        const v after_9 = p##_set1_epi8('9' + 1);                               \
+        const v underscore = p##_set1_epi8('_');                                \
+        const v dot = p##_set1_epi8('.');                                       \
+        while (end - pos >= width) {                                            \
+            v x = p##_loadu_##s((const v *)pos);                                \
+            v lower = p##_or_##s(x, case_bit);                                  \
+            v letter = p##_and_##s(p##_cmpgt_epi8(lower, before_a),             \
+                                   p##_cmpgt_epi8(after_z, lower));             \
+            v digit = p##_and_##s(p##_cmpgt_epi8(x, before_0),                  \
+                                  p##_cmpgt_epi8(after_9, x));                  \
+            v other = p##_or_##s(p##_cmpeq_epi8(x, underscore),                 \
+                                 p##_cmpeq_epi8(x, dot));                       \
+            v hit = p##_or_##s(p##_or_##s(letter, digit), other);               \
+            unsigned int miss = ~(unsigned int)p##_movemask_epi8(hit);          \
+            if (width < 32) {                                                   \
+                miss &= (1u << (width & 31)) - 1;                               \
+            }                                                                   \
+            if (miss == 0) {                                                    \
+                pos += width;                                                   \
+                continue;                                                       \
+            }                                                                   \
+            pos += __builtin_ctz(miss);                                         \
+            if (ClassOf(*pos) > DI) {                                           \
+                return pos;                                                     \
+            }                                                                   \
+            ++pos; /* an unusual character of name */                           \
+        }                                                                       \
+        return skip_name_scalar(pos, end);                                      \
+    }                                                                           \
+                                                                                \
+    static const Scanner isa##_SCANNER = {                                      \
+        #isa, skip_spaces_##isa, skip_name_##isa                                \
+    };
+
+#define TTL_NO_ATTRIBUTE
+#define TTL_AVX2_ATTRIBUTE __attribute__((target("avx2")))
+
+    TTL_SCANNER(sse2, TTL_NO_ATTRIBUTE, __m128i, _mm, si128, 16)
+    TTL_SCANNER(avx2, TTL_AVX2_ATTRIBUTE, __m256i, _mm256, si256, 32)
+
+#endif
+
+    const Scanner * FindScanner(const std::string& name) {
+        if (name == "scalar") {
+            return &SCALAR_SCANNER;
+        }
+#if defined(TTL_X86)
+        if (name == "sse2" && __builtin_cpu_supports("sse2")) {
+            return &sse2_SCANNER;
+        }
+        if (name == "avx2" && __builtin_cpu_supports("avx2")) {
+            return &avx2_SCANNER;
+        }
+#endif
+        return NULL;
+    }
+
+    static const Scanner * ChooseScanner() {
+        // most runs are shorter than 32 characters, avx2 is slower than
+        // sse2 on them.
+        const char * const names[] = { "sse2", "avx2", "scalar" };
+        const Scanner * scanner = NULL;
+        for (int i = 0; scanner == NULL; ++i) {
+            scanner = FindScanner(names[i]);
+        }
+        return scanner;
+    }
+
+    const Scanner& BestScanner() {
+        static const Scanner * best = ChooseScanner();
+        return *best;
+    }
+
     Tokenizer::Tokenizer(const char * buffer)
-        : buffer_(buffer), pos_(buffer) {}
+        : buffer_(buffer), pos_(buffer), end_(buffer + strlen(buffer)),
+          scanner_(&BestScanner()) {}
+
+    Tokenizer::Tokenizer(const char * buffer, std::size_t length)
+        : buffer_(buffer), pos_(buffer), end_(buffer + length),
+          scanner_(&BestScanner()) {}
 
     void Tokenizer::Reset(const char * buffer) {
+        Reset(buffer, strlen(buffer));
+    }
+
+    void Tokenizer::Reset(const char * buffer, std::size_t length) {
         buffer_ = buffer;
         pos_ = buffer;
+        end_ = buffer + length;
     }
 
     unsigned int Tokenizer::ProcessedLength() const {
@@ -26,7 +213,7 @@ namespace ttl {
 
     int Tokenizer::Context(std::string& c) const {
         const char * end = pos_;
-        for (int i = 0; i < 40 && (*end) != '\0' && (*end) != '\n'; ++i, ++end)
+        for (int i = 0; i < 40 && end < end_ && (*end) != '\0' && (*end) != '\n'; ++i, ++end)
             ;
 
         const char * start = pos_;
@@ -49,21 +236,28 @@ namespace ttl {
         return pos_ >= buffer_;
     }
 
-    void Tokenizer::TwoCharSymbolToken(Token& token,
-                                       long type,
-                                       const char * beginning,
-                                       const char expected) {
-        if (beginning != pos_) {
-            return GetToken(token, type, beginning, pos_ - beginning);
-        } else {
-            GetToken(token, long(*pos_), pos_, 1);
+    void Tokenizer::SymbolToken(Token& token) {
+        const char expected = (*pos_ == '&' || *pos_ == '|') ? *pos_ : '=';
+        GetToken(token, long(*pos_), pos_, 1);
+        pos_++;
+        if (Current() == expected) {
+            token.token_type <<= 8;
+            token.token_type += expected;
             pos_++;
-            if (*pos_ == expected) {
-                token.token_type <<= 8;
-                token.token_type += expected;
-                pos_++;
-                token.token_length = 2;
-            }
+            token.token_length = 2;
+        }
+    }
+
+    static long KeywordType(const char * name, int length) {
+        switch (length) {
+        case 2:
+            return memcmp(name, "if", 2) == 0 ? Tokenizer::TOKEN_IF : Tokenizer::TOKEN_NAME;
+        case 4:
+            return memcmp(name, "else", 4) == 0 ? Tokenizer::TOKEN_ELSE : Tokenizer::TOKEN_NAME;
+        case 6:
+            return memcmp(name, "return", 6) == 0 ? Tokenizer::TOKEN_RETURN : Tokenizer::TOKEN_NAME;
+        default:
+            return Tokenizer::TOKEN_NAME;
         }
     }
 
@@ -73,76 +267,26 @@ namespace ttl {
      * NOTE:
      *     0. whitespace are skiped, so caller don't need to trim the token;
      *     1. new line "\n" is processed, so caller don't bother to process this;
+     *     2. the end of the buffer, or a '\0' in it, is TOKEN_EOL.
      */
     void Tokenizer::NextToken(Token& token) {
-        long type = TOKEN_NAME;
-        for (const char * beginning = pos_; true ; ++pos_) {
-            switch (*pos_) {
-            case ' ':
-            case '\t':
-                if (beginning == pos_) {
-                    beginning = pos_ + 1;
-                } else {
-                    return GetToken(token, type, beginning, pos_ - beginning);
-                }
-                break;
-            case '\0':
-                if (beginning != pos_) {
-                    return GetToken(token, type, beginning, pos_ - beginning);
-                } else {
-                    return GetToken(token, TOKEN_EOL, pos_, 1);
-                }
-            case '\n':
-                if (beginning != pos_) {
-                    return GetToken(token, type, beginning, pos_ - beginning);
-                } else {
-                    beginning = pos_ + 1;
-                }
-                break;
-            case ';':
-            case '(':
-            case ')':
-            case '{':
-            case '}':
-            case ',':
-                if (beginning != pos_) {
-                    return GetToken(token, type, beginning, pos_ - beginning);
-                } else {
-                    GetToken(token, long(*pos_), pos_, 1);
-                    pos_++;
-                    return;
-                }
-            case '!':
-            case '+':
-            case '-':
-            case '*':
-            case '/':
-            case '%':
-            case '<':
-            case '>':
-            case '=':
-                return TwoCharSymbolToken(token, type, beginning, '=');
-            case '&':
-                return TwoCharSymbolToken(token, type, beginning, '&');
-            case '|':
-                return TwoCharSymbolToken(token, type, beginning, '|');
-            case '0':
-            case '1':
-            case '2':
-            case '3':
-            case '4':
-            case '5':
-            case '6':
-            case '7':
-            case '8':
-            case '9':
-                if (beginning == pos_) {
-                    type = TOKEN_NUM;
-                }
-                break;
-            default:
-                break;
-            }
+        pos_ = scanner_->skip_spaces(pos_, end_);
+        const char * beginning = pos_;
+        switch (ClassOf(Current())) {
+        case EN:
+            return GetToken(token, TOKEN_EOL, pos_, 1);
+        case PU:
+            GetToken(token, long(*pos_), pos_, 1);
+            pos_++;
+            return;
+        case SY:
+            return SymbolToken(token);
+        case DI:
+            pos_ = scanner_->skip_name(pos_ + 1, end_);
+            return GetToken(token, TOKEN_NUM, beginning, pos_ - beginning);
+        default:
+            pos_ = scanner_->skip_name(pos_ + 1, end_);
+            return GetToken(token, KeywordType(beginning, pos_ - beginning), beginning, pos_ - beginning);
         }
     }
 
@@ -10,6 +10,9 @@
 #ifndef TTL_TOKENIZER_H
 #define TTL_TOKENIZER_H
 
+#include <cstddef>
+#include <string>
+
 namespace ttl {
 
     struct Token {
@@ -18,23 +21,64 @@ namespace ttl {
         int token_length;
     };
 
+    /**
+     * the loops skipping runs of characters, one table per instruction set.
+     *
+     * both return the first character of [pos, end) which does not belong
+     * to the run, or 'end'.
+     */
+    struct Scanner {
+        const char * name;
+
+        // ' ', '\t' and '\n'
+        const char * (*skip_spaces)(const char * pos, const char * end);
+        // the characters of names and numbers
+        const char * (*skip_name)(const char * pos, const char * end);
+    };
+
+    // the fastest scanner supported by this cpu, chosen once at runtime.
+    const Scanner& BestScanner();
+
+    // scanners by name: "scalar", "sse2" or "avx2", NULL if not supported.
+    const Scanner * FindScanner(const std::string& name);
+
+    /**
+     * split code into tokens.
+     *
+     * NOTE:
+     *     0. every character is classified by a table: spaces, the end,
+     *        punctuations, symbols (which may be followed by '=' or be
+     *        doubled, like "+=" and "&&"), digits and names. any other
+     *        character, like '.' and '_', is a part of a name;
+     *     1. a run of spaces or of name characters is skipped by the
+     *        scanner, 16 or 32 characters a step;
+     *     2. "if", "else" and "return" are keyword tokens, other names,
+     *        like "include", are resolved by the parser.
+     */
     class Tokenizer {
     public:
-        Tokenizer(const char * buffer);
+        // 'buffer' is terminated by '\0'
+        explicit Tokenizer(const char * buffer);
+        // 'buffer' is not terminated, the end of it is seen as a '\0'.
+        Tokenizer(const char * buffer, std::size_t length);
         void NextToken(Token & t);
         bool Expect(long type);
         // push back the token(after this, call NextToken will return 't')
         bool PushBack(const Token& t);
         void Reset(const char * buffer);
+        void Reset(const char * buffer, std::size_t length);
         unsigned int ProcessedLength() const;
         int Context(std::string& c) const;
+        // default BestScanner()
+        void SetScanner(const Scanner& scanner) { scanner_ = &scanner; }
+
+        // true for names and keywords
+        static bool IsName(long type) { return (type & TOKEN_NAME) != 0; }
 
     private:
-        void TwoCharSymbolToken(Token& token,
-                                long type,
-                                const char * beginning,
-                                const char expected);
+        void SymbolToken(Token& token);
         void GetToken(Token & t, long type, const char * pos, int length);
+        char Current() const { return pos_ < end_ ? *pos_ : '\0'; }
 
     public:
         const static long TOKEN_EOL = '\0';
@@ -44,6 +88,7 @@ namespace ttl {
         const static long TOKEN_RIGHT_BANANA = ')';
         const static long TOKEN_MUL = '*';
         const static long TOKEN_ADD = '+';
+        const static long TOKEN_COMMA = ',';
         const static long TOKEN_SUB = '-';
         const static long TOKEN_DIV = '/';
         const static long TOKEN_SEMICOLON = ';';
@@ -67,9 +112,15 @@ namespace ttl {
         const static long TOKEN_NAME = 1 << 16;
         const static long TOKEN_NUM = 1 << 17;
 
+        const static long TOKEN_IF = TOKEN_NAME + 1;
+        const static long TOKEN_ELSE = TOKEN_NAME + 2;
+        const static long TOKEN_RETURN = TOKEN_NAME + 3;
+
     private:
         const char * buffer_;
         const char * pos_;
+        const char * end_;
+        const Scanner * scanner_;
     };
 
 }
@@ -0,0 +1,392 @@
+/**
+ * types.cc - integer type inference
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#include <math.h>
+#include <algorithm>
+#include "types.hh"
+
+namespace ttl {
+
+    const long long TypeInference::MAX_INTEGER;
+
+    typedef TypeInference::Range Range;
+
+    static Range Any() {
+        Range range = { false, true, 0, 0 };
+        return range;
+    }
+
+    static Range Boolean() {
+        Range range = { true, false, 0, 1 };
+        return range;
+    }
+
+    // 'range' if it is bounded by MAX_INTEGER, else anything.
+    static Range Bound(Range range) {
+        double max = (double)TypeInference::MAX_INTEGER;
+        if (range.integral == false || range.lo < -max || range.hi > max) {
+            return Any();
+        }
+        return range;
+    }
+
+    static Range Exactly(double value) {
+        Range range = { value == floor(value), value == 0 && signbit(value), value, value };
+        return Bound(range);
+    }
+
+    static Range Join(const Range& x, const Range& y) {
+        if (x.integral == false || y.integral == false) {
+            return Any();
+        }
+        Range range = { true, x.negative_zero || y.negative_zero, std::min(x.lo, y.lo), std::max(x.hi, y.hi) };
+        return range;
+    }
+
+    // the sum starts from +0, it is never -0.
+    static Range Add(const Range& x, const Range& y) {
+        Range range = { x.integral && y.integral, false, x.lo + y.lo, x.hi + y.hi };
+        return Bound(range);
+    }
+
+    static Range Negative(const Range& x) {
+        Range range = { x.integral, x.lo <= 0 && x.hi >= 0, - x.hi, - x.lo };
+        return Bound(range);
+    }
+
+    static Range Mul(const Range& x, const Range& y) {
+        if (x.integral == false || y.integral == false) {
+            return Any();
+        }
+        double corners[] = { x.lo * y.lo, x.lo * y.hi, x.hi * y.lo, x.hi * y.hi };
+        // 0 * negative is -0, so is -0 * positive (or +0).
+        bool negative_zero = (x.lo <= 0 && x.hi >= 0 && y.lo < 0) || (y.lo <= 0 && y.hi >= 0 && x.lo < 0) ||
+            (x.negative_zero && y.hi >= 0) || (y.negative_zero && x.hi >= 0);
+        Range range = { true, negative_zero, *std::min_element(corners, corners + 4),
+                        *std::max_element(corners, corners + 4) };
+        return Bound(range);
+    }
+
+    // (long long)x % (long long)y: smaller than the divisor, not larger
+    // than the dividend, with the sign of the dividend.
+    static Range Mod(const Range& x, const Range& y) {
+        double max = HUGE_VAL;
+        if (y.integral) {
+            max = std::max(std::max(fabs(y.lo), fabs(y.hi)) - 1, 0.0);
+        }
+        if (x.integral) {
+            max = std::min(max, std::max(fabs(x.lo), fabs(x.hi)));
+        }
+        Range range = { true, false, - max, max };
+        if (x.integral && x.lo >= 0) {
+            range.lo = 0;
+        }
+        if (x.integral && x.hi <= 0) {
+            range.hi = 0;
+        }
+        return Bound(range);
+    }
+
+    TypeInference::TypeInference(const Program& program)
+        : program_(program), trail_(), ranges_(), regions_(), integers_() {
+        if (program_.Root() == NULL) {
+            return;
+        }
+
+        const std::vector<double>& initial = program_.InitialValues();
+        State state(initial.size());
+        for (std::size_t i = 0; i < initial.size(); ++i) {
+            state[i] = Exactly(initial[i]);
+        }
+        const std::map<std::string, int>& inputs = program_.Inputs();
+        for (std::map<std::string, int>::const_iterator it = inputs.begin(); it != inputs.end(); ++it) {
+            state[it->second] = Any();
+        }
+        const std::vector<Extern>& externs = program_.Externs();
+        for (std::size_t i = 0; i < externs.size(); ++i) {
+            state[externs[i].slot] = Any();
+        }
+        Visit(program_.Root(), &state);
+        trail_.clear();
+
+        // the regions worth computing on int64
+        std::set<const Operator *> visited;
+        Connect(program_.Root(), &visited);
+        std::map<const Operator *, std::pair<int, int> > counts; // (mods, arithmetic) by region
+        for (std::map<const Operator *, const Operator *>::iterator it = regions_.begin(); it != regions_.end(); ++it) {
+            std::pair<int, int>& count = counts[Region(it->first)];
+            count.first += it->first->Type() == Operator::OP_MOD;
+            count.second += IsComparison(it->first) == false;
+        }
+        for (std::map<const Operator *, const Operator *>::iterator it = regions_.begin(); it != regions_.end(); ++it) {
+            const std::pair<int, int>& count = counts[Region(it->first)];
+            if (count.first > 0 && count.second > 1) {
+                integers_.insert(it->first);
+            }
+        }
+    }
+
+    TypeInference::Range TypeInference::Find(const Operator * node) const {
+        std::map<const Operator *, Range>::const_iterator it = ranges_.find(node);
+        return it == ranges_.end() ? Any() : it->second;
+    }
+
+    bool TypeInference::IsInteger(const Operator * node) const {
+        Range range = Find(node);
+        return range.integral && range.negative_zero == false;
+    }
+
+    void TypeInference::Assign(State * state, int slot, const Range& range) {
+        trail_.push_back(std::make_pair(slot, (*state)[slot]));
+        (*state)[slot] = range;
+    }
+
+    // every range a slot had since 'mark' is a range it may have now.
+    void TypeInference::Widen(State * state, std::size_t mark) const {
+        for (std::size_t i = mark; i < trail_.size(); ++i) {
+            Range& slot = (*state)[trail_[i].first];
+            slot = ttl::Join(slot, trail_[i].second);
+        }
+    }
+
+    // restore the slots assigned since 'mark', the ranges they had are
+    // appended to 'taken'.
+    void TypeInference::Undo(State * state, std::size_t mark, std::vector<std::pair<int, Range> > * taken) {
+        while (trail_.size() > mark) {
+            int slot = trail_.back().first;
+            taken->push_back(std::make_pair(slot, (*state)[slot]));
+            (*state)[slot] = trail_.back().second;
+            trail_.pop_back();
+        }
+    }
+
+    TypeInference::Range TypeInference::Visit(const Operator * node, State * state) {
+        const OperatorList& children = node->Children();
+        Range range = Any();
+        switch (node->Type()) {
+        case Operator::OP_NUM:
+            range = Exactly(static_cast<const Num *>(node)->Value());
+            break;
+        case Operator::OP_VARIABLE:
+            range = (*state)[static_cast<const Variable *>(node)->Slot()];
+            break;
+        case Operator::OP_EXTERNAL:
+            range = (*state)[static_cast<const External *>(node)->Slot()];
+            break;
+        case Operator::OP_REFERENCE:
+            {
+                const Reference * ref = static_cast<const Reference *>(node);
+                Range value = Visit(children[0], state);
+                Range slot = (*state)[ref->Slot()];
+                if (ref->IsReturn()) {
+                    // the first "return" which runs gives the value
+                    slot = ttl::Join(slot, value);
+                } else {
+                    switch (ref->AssignType()) {
+                    case Reference::ASSIGN: slot = value; break;
+                    case Reference::ADD_ASSIGN: slot = Add(slot, value); break;
+                    case Reference::SUB_ASSIGN: slot = Add(slot, Negative(value)); break;
+                    case Reference::MUL_ASSIGN: slot = Mul(slot, value); break;
+                    case Reference::DIV_ASSIGN: slot = Any(); break;
+                    case Reference::MOD_ASSIGN:
+                        slot = ttl::Join(Mod(slot, value), (*state)[ref->DefaultSlot()]);
+                        break;
+                    }
+                }
+                Assign(state, ref->Slot(), slot);
+                range = slot;
+            }
+            break;
+        case Operator::OP_MODULE:
+            {
+                // after a "return" the sentences are skipped, the ranges of
+                // the path through them are larger.
+                const Module * module = static_cast<const Module *>(node);
+                range = (*state)[module->DefaultSlot()];
+                for (std::size_t i = 0; i < children.size(); ++i) {
+                    range = Visit(children[i], state);
+                }
+                range = ttl::Join(range, (*state)[module->ReturnSlot()]);
+            }
+            break;
+        case Operator::OP_IF:
+            {
+                // a branch is undone after it is visited, the next condition
+                // runs on the state without it.
+                std::size_t start = trail_.size();
+                std::vector<std::pair<int, Range> > taken;
+                std::size_t i = 0;
+                for (i = 0; i + 1 < children.size(); i += 2) {
+                    Visit(children[i], state);
+                    std::size_t mark = trail_.size();
+                    Range branch = Visit(children[i + 1], state);
+                    range = i == 0 ? branch : ttl::Join(range, branch);
+                    Undo(state, mark, &taken);
+                }
+                Range last = Exactly(0);
+                if (i + 1 == children.size()) {
+                    last = Visit(children[i], state); // the last "else"
+                }
+                range = i == 0 ? last : ttl::Join(range, last);
+                if (i != 0) {
+                    Widen(state, start);
+                }
+                for (std::size_t j = 0; j < taken.size(); ++j) {
+                    Assign(state, taken[j].first, ttl::Join((*state)[taken[j].first], taken[j].second));
+                }
+            }
+            break;
+        case Operator::OP_AND:
+        case Operator::OP_OR:
+            {
+                // every operand may be the last one evaluated
+                Visit(children[0], state);
+                std::size_t mark = trail_.size();
+                for (std::size_t i = 1; i < children.size(); ++i) {
+                    Visit(children[i], state);
+                }
+                Widen(state, mark);
+                range = Boolean();
+            }
+            break;
+        case Operator::OP_DIV:
+            {
+                Visit(children[1], state);
+                std::size_t mark = trail_.size();
+                Visit(children[0], state);
+                Widen(state, mark);
+            }
+            break;
+        case Operator::OP_ADD:
+            range = Exactly(0);
+            for (std::size_t i = 0; i < children.size(); ++i) {
+                range = Add(range, Visit(children[i], state));
+            }
+            break;
+        case Operator::OP_NEGATIVE:
+            range = Negative(Visit(children[0], state));
+            break;
+        case Operator::OP_MUL:
+            {
+                Range lhs = Visit(children[0], state);
+                range = Mul(lhs, Visit(children[1], state));
+            }
+            break;
+        case Operator::OP_MOD:
+            {
+                Range lhs = Visit(children[0], state);
+                range = Mod(lhs, Visit(children[1], state));
+            }
+            break;
+        case Operator::OP_NOT:
+        case Operator::OP_LESS:
+        case Operator::OP_LESS_EQUAL:
+        case Operator::OP_GREATER:
+        case Operator::OP_GREATER_EQUAL:
+        case Operator::OP_EQUAL:
+        case Operator::OP_NOT_EQUAL:
+            for (std::size_t i = 0; i < children.size(); ++i) {
+                Visit(children[i], state);
+            }
+            range = Boolean();
+            break;
+        default:
+            // models and functions
+            for (std::size_t i = 0; i < children.size(); ++i) {
+                Visit(children[i], state);
+            }
+            break;
+        }
+
+        // a node shared by CSE is visited more than once
+        std::map<const Operator *, Range>::iterator it = ranges_.find(node);
+        if (it == ranges_.end()) {
+            ranges_.insert(std::make_pair(node, range));
+        } else {
+            it->second = ttl::Join(it->second, range);
+        }
+        return range;
+    }
+
+    const Operator * TypeInference::Operand(const Operator * node, std::size_t i) {
+        const Operator * operand = node->Children()[i];
+        if (node->Type() == Operator::OP_ADD && operand->Type() == Operator::OP_NEGATIVE) {
+            return operand->Children()[0];
+        }
+        return operand;
+    }
+
+    bool TypeInference::Constant(const Operator * node, long long * value) {
+        if (node->Type() != Operator::OP_NUM) {
+            return false;
+        }
+        double number = static_cast<const Num *>(node)->Value();
+        if (fabs(number) > MAX_INTEGER) {
+            return false;
+        }
+        *value = (long long)number;
+        return true;
+    }
+
+    bool TypeInference::Candidate(const Operator * node) const {
+        const OperatorList& children = node->Children();
+        switch (node->Type()) {
+        case Operator::OP_ADD:
+            for (std::size_t i = 0; i < children.size(); ++i) {
+                if (Find(Operand(node, i)).integral == false) {
+                    return false;
+                }
+            }
+            return IsInteger(node);
+        case Operator::OP_MUL:
+            return IsInteger(node) && Find(children[0]).integral && Find(children[1]).integral;
+        case Operator::OP_MOD:
+            // the operands are truncated like (long long) does
+            return IsInteger(node);
+        default:
+            return IsComparison(node) && Find(children[0]).integral && Find(children[1]).integral;
+        }
+    }
+
+    // put the candidates connected by operands into one region.
+    void TypeInference::Connect(const Operator * node, std::set<const Operator *> * visited) {
+        if (visited->insert(node).second == false) {
+            return;
+        }
+        const OperatorList& children = node->Children();
+        bool candidate = Candidate(node);
+        if (candidate) {
+            regions_.insert(std::make_pair(node, node));
+        }
+        for (std::size_t i = 0; i < children.size(); ++i) {
+            const Operator * operand = Operand(node, i);
+            if (operand != children[i]) {
+                Connect(children[i], visited);
+            }
+            Connect(operand, visited);
+            if (candidate && IsComparison(operand) == false && regions_.count(operand) != 0) {
+                regions_[Region(operand)] = Region(node);
+            }
+        }
+    }
+
+    const Operator * TypeInference::Region(const Operator * node) {
+        const Operator * root = node;
+        while (regions_[root] != root) {
+            root = regions_[root];
+        }
+        while (regions_[node] != root) {
+            const Operator * next = regions_[node];
+            regions_[node] = root;
+            node = next;
+        }
+        return root;
+    }
+
+} // ttl
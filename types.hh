@@ -0,0 +1,113 @@
+/**
+ * types.hh - integer type inference
+ *
+ * Author: Bao Hexing <HexingB@qq.com>
+ * Created: 17 October 2026
+ *
+ * Copyright © 2026, Bao Hexing. All Rights Reserved.
+ */
+
+#ifndef TTL_TYPES_H
+#define TTL_TYPES_H
+
+#include <map>
+#include <set>
+#include <vector>
+#include "operator.hh"
+#include "program.hh"
+
+namespace ttl {
+
+    /**
+     * prove which nodes of a program are integers, so the engines may
+     * compute them on int64.
+     *
+     * NOTE:
+     *     0. a node is an integer if in every evaluation its value is a
+     *        whole number of [lo, hi], |lo| and |hi| <= MAX_INTEGER, and
+     *        never -0. on integers int64 arithmetic is exact, as double
+     *        arithmetic is, so the results are the same bit for bit;
+     *     1. the ranges of the variables follow the order of evaluation,
+     *        they are joined where the paths of "if", "&&", "||" and "/"
+     *        (the dividend may be skipped) meet. an input or an extern may
+     *        be anything;
+     *     2. "%" is an integer of (long long) operands, bounded by its
+     *        divisor, or by its dividend. comparisons, "!", "&&" and "||"
+     *        are 0 or 1;
+     *     3. OnIntegers() marks the nodes computed on int64: "+", "*", "%"
+     *        and the comparisons whose operands are whole numbers, in
+     *        regions of such nodes with a "%" and another "+", "*" or "%".
+     *        a smaller region converts more than it saves. a comparison
+     *        gives 1.0 or 0.0, it is the top of a region only;
+     *     4. run it on the ast the engine compiles, after the passes which
+     *        change it.
+     */
+    class TypeInference {
+    public:
+        const static long long MAX_INTEGER = 1LL << 52;
+
+        struct Range {
+            bool integral;      // a whole number of [lo, hi], every time
+            bool negative_zero; // may be -0
+            double lo;
+            double hi;
+        };
+
+        explicit TypeInference(const Program& program);
+
+        // the range of 'node', not integral if it is not in the program.
+        Range Find(const Operator * node) const;
+        bool IsInteger(const Operator * node) const;
+        bool OnIntegers(const Operator * node) const {
+            return integers_.count(node) != 0;
+        }
+
+        // a node of OnIntegers() whose value stays int64 in its region, a
+        // comparison gives double.
+        bool Interior(const Operator * node) const {
+            return OnIntegers(node) && IsComparison(node) == false;
+        }
+
+        // operand 'i' of a node of OnIntegers(): an addend "-x" of "+" is
+        // subtracted, so it is 'x'.
+        static const Operator * Operand(const Operator * node, std::size_t i);
+
+        // the int64 of a number operand, truncated like (long long) does
+        // (the operands of "+", "*" and comparisons are whole numbers).
+        // false if it is not a number, or out of MAX_INTEGER.
+        static bool Constant(const Operator * node, long long * value);
+
+        std::size_t IntegerNodes() const { return integers_.size(); }
+
+    private:
+        typedef std::vector<Range> State; // by slot
+
+        // the range of 'node', the ranges of the slots it assigns are
+        // updated in 'state'.
+        Range Visit(const Operator * node, State * state);
+
+        // the assignments are kept in 'trail_', so a path which may be
+        // skipped is joined, or undone, without a copy of the state.
+        void Assign(State * state, int slot, const Range& range);
+        void Widen(State * state, std::size_t mark) const;
+        void Undo(State * state, std::size_t mark, std::vector<std::pair<int, Range> > * taken);
+
+        // the nodes of OnIntegers(), with 'node' and its subtree
+        bool Candidate(const Operator * node) const;
+        void Connect(const Operator * node, std::set<const Operator *> * visited);
+        const Operator * Region(const Operator * node);
+
+    private:
+        TypeInference(const TypeInference&);
+        TypeInference& operator=(const TypeInference&);
+
+        const Program& program_;
+        std::vector<std::pair<int, Range> > trail_; // (slot, the range before)
+        std::map<const Operator *, Range> ranges_;
+        std::map<const Operator *, const Operator *> regions_; // union-find of candidates
+        std::set<const Operator *> integers_;
+    };
+
+} // ttl
+
+#endif